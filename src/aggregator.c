@@ -0,0 +1,326 @@
+/**
+ * @file aggregator.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Agregador de estadísticas de todas las instancias del
+ *        servidor que corren en el host para el TP #1 de
+ *        Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-05
+ */
+
+#include "include/headers/stats.h"
+
+#include <getopt.h>
+
+#define _MAX_INSTANCES_ 64
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Lectura de los contadores de una instancia en un instante dado.
+ */
+typedef struct struct_sample
+{
+    char instance[_INSTANCE_LEN_];
+    int pid;
+    long int bytes[_PROTOS_];
+    struct_proto_stats ps[_PROTOS_];
+} struct_sample;
+
+/* ---------- Prototipado de funciones ---------- */
+
+int collect(struct_sample *, char *);
+void print_counters(struct_sample *, int);
+void print_header(int, int);
+void print_row(int, char *, int, long int *, int);
+void usage(void);
+
+/**
+ * @brief Función principal del agregador.
+ *
+ * @details Sin intervalo, se muestran los bytes acumulados de cada
+ *          instancia y el total del host. Con intervalo, se muestran
+ *          las velocidades de cada instancia y del host en cada período.
+ *
+ * @param argc Cantidad de argumentos recibidos.
+ * @param argv Vector con los argumentos recibidos.
+ *
+ * @return 0 Si la ejecución del agregador fue exitosa.
+ *         1 Si la ejecución del agregador tuvo errores.
+ */
+int main(int argc, char *argv[])
+{
+    int interval = 0;
+    int count = -1;
+    int csv = 0;
+    int counters = 0;
+    int opt;
+
+    char *only = NULL;
+
+    while ((opt = getopt(argc, argv, "i:n:cxI:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            if ((interval = atoi(optarg)) <= 0)
+                show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Invalid interval. Run this program with '-h' for help");
+            break;
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'c':
+            csv = 1;
+            break;
+        case 'x':
+            counters = 1;
+            break;
+        case 'I':
+            if (!stats_valid_instance(optarg))
+                show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Invalid instance name. Run this program with '-h' for help");
+
+            only = optarg;
+            break;
+        case 'h':
+            usage();
+
+            exit(EXIT_SUCCESS);
+        default:
+            show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Invalid option received. Run this program with '-h' for help");
+        }
+    }
+
+    struct_sample prev[_MAX_INSTANCES_];
+    struct_sample curr[_MAX_INSTANCES_];
+
+    int n_prev = collect(prev, only);
+
+    if (counters)
+    {
+        print_counters(prev, n_prev);
+
+        return 0;
+    }
+
+    print_header(csv, interval);
+
+    if (interval == 0)
+    {
+        long int host[_PROTOS_] = {0};
+
+        for (int i = 0; i < n_prev; i++)
+        {
+            print_row(csv, prev[i].instance, prev[i].pid, prev[i].bytes, 0);
+
+            for (int p = 0; p < _PROTOS_; p++)
+                host[p] += prev[i].bytes[p];
+        }
+
+        print_row(csv, "HOST", n_prev, host, 0);
+
+        return 0;
+    }
+
+    while (count != 0)
+    {
+        sleep((unsigned int)interval);
+
+        int n_curr = collect(curr, only);
+
+        long int host[_PROTOS_] = {0};
+
+        for (int i = 0; i < n_curr; i++)
+        {
+            long int delta[_PROTOS_];
+
+            // Las instancias que no estaban en la lectura anterior se cuentan desde cero
+            struct_sample *before = NULL;
+
+            for (int j = 0; j < n_prev; j++)
+                if (strcmp(prev[j].instance, curr[i].instance) == 0)
+                    before = &prev[j];
+
+            for (int p = 0; p < _PROTOS_; p++)
+            {
+                delta[p] = curr[i].bytes[p] - (before ? before->bytes[p] : 0);
+                host[p] += delta[p];
+            }
+
+            print_row(csv, curr[i].instance, curr[i].pid, delta, interval);
+        }
+
+        print_row(csv, "HOST", n_curr, host, interval);
+
+        if (!csv)
+            fprintf(stdout, "\n");
+
+        fflush(stdout);
+
+        memcpy(prev, curr, sizeof(curr));
+        n_prev = n_curr;
+
+        if (count > 0)
+            count--;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Esta función recorre /dev/shm y toma una lectura de los
+ *        contadores de cada instancia del servidor en ejecución.
+ *
+ * @details Se descartan los segmentos huérfanos (cuyo proceso dueño
+ *          ya no existe) y los de versiones incompatibles.
+ *
+ * @param samples Vector donde se almacenarán las lecturas.
+ * @param only Nombre de la única instancia a leer (NULL para leer todas).
+ *
+ * @return La cantidad de instancias leídas.
+ */
+int collect(struct_sample *samples, char *only)
+{
+    DIR *dir = opendir(_SHM_DIR_);
+
+    if (!dir)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed trying to open shared memory directory");
+
+    int n = 0;
+
+    struct dirent *entry;
+
+    while (((entry = readdir(dir)) != NULL) && (n < _MAX_INSTANCES_))
+    {
+        if (strncmp(entry->d_name, _SHM_PREFIX_, strlen(_SHM_PREFIX_)) != 0)
+            continue;
+
+        char *instance = entry->d_name + strlen(_SHM_PREFIX_);
+
+        if (!stats_valid_instance(instance) || (only && (strcmp(instance, only) != 0)))
+            continue;
+
+        struct_data *sd = stats_attach(instance);
+
+        if (!sd)
+            continue;
+
+        if (stats_alive(sd))
+        {
+            strcpy(samples[n].instance, instance);
+
+            samples[n].pid = sd->pid;
+
+            stats_snapshot(sd, samples[n].ps);
+
+            for (int p = 0; p < _PROTOS_; p++)
+                samples[n].bytes[p] = samples[n].ps[p].bytes;
+
+            n++;
+        }
+
+        munmap(sd, sizeof(struct_data));
+    }
+
+    closedir(dir);
+
+    return n;
+}
+
+/**
+ * @brief Esta función muestra, en formato CSV, todos los contadores
+ *        acumulados de cada protocolo de cada instancia.
+ *
+ * @details Es la salida que consumen las herramientas externas (por
+ *          ejemplo, el benchmark), que calculan sus propias diferencias.
+ *
+ * @param samples Lecturas de las instancias.
+ * @param n Cantidad de lecturas.
+ */
+void print_counters(struct_sample *samples, int n)
+{
+    fprintf(stdout, "instance,pid,proto,bytes,reads,utime_ns,stime_ns,wait_ns,nvcsw,nivcsw,accepts,setup_ns,throttled_ns,channels,comp_bytes,raw_bytes,shed,deferred,tcp_samples,rcv_rtt_us,rcv_space,backlogged,ooo_pkts,threads,rss_bytes,rss_samples\n");
+
+    for (int i = 0; i < n; i++)
+    {
+        for (int p = 0; p < _PROTOS_; p++)
+        {
+            struct_proto_stats *ps = &samples[i].ps[p];
+
+            fprintf(stdout, "%s,%d,%s,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n", samples[i].instance, samples[i].pid, proto_name(p),
+                    ps->bytes, ps->reads, ps->utime_ns, ps->stime_ns, ps->wait_ns, ps->nvcsw, ps->nivcsw, ps->accepts, ps->setup_ns,
+                    ps->throttled_ns, ps->channels, ps->comp_bytes, ps->raw_bytes, ps->shed, ps->deferred,
+                    ps->tcp_samples, ps->rcv_rtt_us, ps->rcv_space, ps->backlogged, ps->ooo_pkts,
+                    ps->threads, ps->rss_bytes, ps->rss_samples);
+        }
+    }
+}
+
+/**
+ * @brief Esta función muestra el encabezado de la tabla de resultados.
+ *
+ * @param csv Indica si la salida es en formato CSV.
+ * @param interval Intervalo entre lecturas (0 si se muestran acumulados).
+ */
+void print_header(int csv, int interval)
+{
+    if (csv)
+        fprintf(stdout, "instance,pid,%s\n", interval ? "local_Bps,ipv4_Bps,ipv6_Bps,total_Bps" : "local_bytes,ipv4_bytes,ipv6_bytes,total_bytes");
+    else if (interval)
+        fprintf(stdout, "%-32s %8s %14s %14s %14s %14s\n", "INSTANCE", "PID", "LOCAL[Mb/s]", "IPv4[Mb/s]", "IPv6[Mb/s]", "TOTAL[Mb/s]");
+    else
+        fprintf(stdout, "%-32s %8s %16s %16s %16s %16s\n", "INSTANCE", "PID", "LOCAL[B]", "IPv4[B]", "IPv6[B]", "TOTAL[B]");
+}
+
+/**
+ * @brief Esta función muestra una fila de la tabla de resultados.
+ *
+ * @details Para la fila del total del host, en lugar del PID se
+ *          muestra la cantidad de instancias agregadas.
+ *
+ * @param csv Indica si la salida es en formato CSV.
+ * @param name Nombre de la instancia.
+ * @param pid PID de la instancia (o cantidad de instancias).
+ * @param bytes Bytes de cada protocolo.
+ * @param interval Segundos a los que corresponden los bytes (0 si son acumulados).
+ */
+void print_row(int csv, char *name, int pid, long int *bytes, int interval)
+{
+    double secs = interval ? (double)interval : 1;
+
+    long int total = 0;
+
+    for (int p = 0; p < _PROTOS_; p++)
+        total += bytes[p];
+
+    if (csv)
+        fprintf(stdout, "%s,%d,%.0f,%.0f,%.0f,%.0f\n", name, pid,
+                (double)bytes[_PROTO_LOCAL_] / secs, (double)bytes[_PROTO_IPV4_] / secs,
+                (double)bytes[_PROTO_IPV6_] / secs, (double)total / secs);
+    else if (interval)
+        fprintf(stdout, "%-32s %8d %14.1f %14.1f %14.1f %14.1f\n", name, pid,
+                ((double)bytes[_PROTO_LOCAL_] * 8) / 1e6 / secs, ((double)bytes[_PROTO_IPV4_] * 8) / 1e6 / secs,
+                ((double)bytes[_PROTO_IPV6_] * 8) / 1e6 / secs, ((double)total * 8) / 1e6 / secs);
+    else
+        fprintf(stdout, "%-32s %8d %16ld %16ld %16ld %16ld\n", name, pid,
+                bytes[_PROTO_LOCAL_], bytes[_PROTO_IPV4_], bytes[_PROTO_IPV6_], total);
+}
+
+/**
+ * @brief Esta función muestra un mensaje de ayuda del agregador.
+ */
+void usage()
+{
+    fprintf(stdout, "Usage: ./bin/agg [-i interval] [-n count] [-c] [-x] [-I instance]\n\n\
+Aggregates the stats of every server instance running on this host.\n\n\
+    Without options, the accumulated bytes received by each instance and the host-wide totals are shown.\n\
+    -i interval: show the speed of each instance and of the whole host every 'interval' seconds.\n\
+    -n count: stop after 'count' intervals.\n\
+    -c: CSV output (speeds in bytes per second).\n\
+    -x: CSV dump of every accumulated counter (bytes, reads, CPU time, context switches, accepts,\n\
+        connection setup time, time throttled by rate caps, multiplexed channels, bytes received\n\
+        compressed and after decompression, connections shed or deferred by admission control, and\n\
+        TCP_INFO samples with their receiver RTT, receive window, backlogged receive queues and\n\
+        out-of-order packets)\n\
+        of each protocol of each instance.\n\
+    -I instance: only read the given instance.\n");
+}
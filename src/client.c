@@ -9,6 +9,160 @@
 
 #include "include/headers/clients_setup.h"
 
+static int children[_MAX_CONNECTIONS_]; // Procesos del resto de las conexiones (sólo en el proceso original)
+static int n_children = 0;
+
+/**
+ * @brief Esta función interpreta las opciones del cliente y, si se
+ *        pidieron varias conexiones, crea un proceso por cada una.
+ *
+ * @details Cada proceso abre su propia conexión. Con canales lógicos,
+ *          los N canales se reparten entre las M conexiones. El
+ *          generador de datos y la compresión se aplican a todas.
+ *
+ * @param argc Cantidad de argumentos recibidos.
+ * @param argv Vector con los argumentos recibidos.
+ *
+ * @return El índice del primer argumento posicional.
+ */
+static int setup_connections(int argc, char *argv[])
+{
+    static struct option long_opts[] = {
+        {"channels", required_argument, NULL, 'C'},
+        {"connections", required_argument, NULL, 'M'},
+        {"payload", required_argument, NULL, 'P'},
+        {"compress", no_argument, NULL, 'Z'},
+        {"tcp-info", no_argument, NULL, 'I'},
+        {"report", required_argument, NULL, 'R'},
+        {"format", required_argument, NULL, 'F'},
+        {"tick", required_argument, NULL, 'T'},
+        {"coalesce", required_argument, NULL, 'W'},
+        {"deadline", required_argument, NULL, 'D'},
+        {"flush-tick", no_argument, NULL, 'E'},
+        {NULL, 0, NULL, 0}};
+
+    int channels = 0;
+    int connections = 1;
+    int opt;
+    int batching = 0;
+
+    while ((opt = getopt_long(argc, argv, "+C:M:P:ZIR:F:T:W:D:E", long_opts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'C':
+            channels = atoi(optarg);
+            break;
+
+        case 'M':
+            connections = atoi(optarg);
+            break;
+
+        case 'P':
+            if ((payload_gen = payload_parse(optarg)) == -1)
+                show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid payload generator. Run this program with '-h', '--help' or '?' for help");
+            break;
+
+        case 'Z':
+            compress = 1;
+            break;
+
+        case 'I':
+            tcp_info = 1;
+            break;
+
+        case 'R':
+            if ((report_interval = atoi(optarg)) < 1)
+                show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid report interval. Run this program with '-h', '--help' or '?' for help");
+            break;
+
+        case 'F':
+            if ((report_fmt = report_parse_format(optarg)) == -1)
+                show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid report format. Run this program with '-h', '--help' or '?' for help");
+            break;
+
+        case 'T':
+            if (coalesce_parse_tick(optarg, &tick_msgs, &tick_ns) == -1)
+                show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid tick. Run this program with '-h', '--help' or '?' for help");
+            break;
+
+        case 'W':
+            if ((atol(optarg) < 1) || (atol(optarg) > _COALESCE_MAX_BYTES_))
+                show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid coalescing threshold. Run this program with '-h', '--help' or '?' for help");
+            coalesce_bytes = (size_t)atol(optarg);
+            break;
+
+        case 'D':
+            if (atol(optarg) < 1)
+                show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid coalescing deadline. Run this program with '-h', '--help' or '?' for help");
+            deadline_ns = atol(optarg) * 1000L;
+            batching = 1;
+            break;
+
+        case 'E':
+            flush_tick = 1;
+            batching = 1;
+            break;
+
+        default:
+            show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid option received. Run this program with '-h', '--help' or '?' for help");
+        }
+    }
+
+    if ((connections < 1) || (connections > _MAX_CONNECTIONS_))
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid number of connections. Run this program with '-h', '--help' or '?' for help");
+
+    if ((channels < 0) || ((channels > 0) && (channels < connections)) || (channels > (connections * _MUX_MAX_CHANNELS_)))
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid number of channels. Run this program with '-h', '--help' or '?' for help");
+
+    if (compress && (channels > 0))
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Compression can not be combined with logical channels. Run this program with '-h', '--help' or '?' for help");
+
+    // Las opciones de agrupamiento implican el modo de mensajes chicos, con un mensaje por período si no se indicó otro
+    if ((coalesce_bytes > 0) || batching)
+        tick_msgs = (tick_msgs > 0) ? tick_msgs : 1;
+
+    // Sin umbral, la espera máxima o el fin del período son los únicos puntos de envío
+    if (batching && (coalesce_bytes == 0))
+        coalesce_bytes = _COALESCE_MAX_BYTES_;
+
+    if ((tick_msgs > 0) && ((channels > 0) || compress))
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Small-message mode can not be combined with logical channels or compression. Run this program with '-h', '--help' or '?' for help");
+
+    if ((argc - optind) < 3)
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Missing arguments. Run this program with '-h', '--help' or '?' for help");
+
+    // El encabezado de los informes se escribe una única vez, antes de crear los procesos
+    char header[_REPORT_LINE_LEN_];
+
+    if (report_header(header, sizeof(header), report_fmt) > 0)
+        try_write(STDOUT_FILENO, header);
+
+    int idx = 0;
+
+    for (int i = 1; i < connections; i++)
+    {
+        int pid = fork();
+
+        if (pid == -1)
+            show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed creating process for a new connection");
+
+        if (pid == 0)
+        {
+            idx = i;
+            n_children = 0;
+
+            break;
+        }
+
+        children[n_children++] = pid;
+    }
+
+    mux_channels = (channels / connections) + ((idx < (channels % connections)) ? 1 : 0);
+
+    return optind;
+}
+
 /**
  * @brief Función principal del cliente.
  *
@@ -39,8 +193,20 @@ int main(int argc, char *argv[])
             show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Invalid argument received. Run this program with '-h', '--help' or '?' for help");
     }
 
-    // Se asigna un handler particular a SIGINT para cerrar la comunicación correctamente
-    if (signal(SIGINT, handler) == SIG_ERR)
+    /*
+     * Se asigna un handler particular a SIGINT para cerrar la comunicación
+     * correctamente. Mientras se escribe el resumen, SIGALRM queda bloqueada.
+     */
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handler;
+    sa.sa_flags = SA_RESTART;
+
+    sigemptyset(&sa.sa_mask);
+    sigaddset(&sa.sa_mask, SIGALRM);
+
+    if (sigaction(SIGINT, &sa, NULL) == -1)
         show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to assign handler to signal SIGCHLD");
 
     // Sólo se permite matar al cliente mediante SIGINT o SIGKILL
@@ -48,6 +214,12 @@ int main(int argc, char *argv[])
         (signal(SIGQUIT, SIG_IGN) == SIG_ERR))
         show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to ignore signals SIGTSTP and SIGQUIT");
 
+    // Opciones, y un proceso por conexión si se pidieron varias
+    int first = setup_connections(argc, argv);
+
+    argc -= (first - 1);
+    argv += (first - 1);
+
     // Creación de cliente en base al protocolo especificado
     char *protocol = argv[1];
 
@@ -84,7 +256,15 @@ int main(int argc, char *argv[])
  * @details Se envía al server el mensaje "STOP"
  *          y automáticamente se cierra el socket
  *          para cerrar la comunicación del lado
- *          del cliente.
+ *          del cliente. En conexiones multiplexadas,
+ *          comprimidas o con datos generados, el fin
+ *          de transmisión se envía al completar la
+ *          trama o el bloque en curso, si lo hay. En
+ *          el modo de mensajes chicos, se envían
+ *          antes los mensajes del lote en curso.
+ *          Antes de terminar, se escribe el resumen
+ *          de envío de la conexión. La señal se reenvía
+ *          a los procesos del resto de las conexiones.
  *
  * @param signal Señal recibida.
  */
@@ -92,9 +272,33 @@ void handler(int signal)
 {
     fprintf(stdout, "\n[PID: %d] <CLIENT> [[ EXITING ]] : Signal %d received {SIGINT}\n", getpid(), signal);
 
+    for (int i = 0; i < n_children; i++)
+        kill(children[i], SIGINT);
+
+    if (tick_msgs > 0)
+    {
+        mux_stop = 1;
+
+        return;
+    }
+
+    if ((mux_channels > 0) || compress || (payload_gen != _PAYLOAD_CONST_))
+    {
+        if (mux_sending)
+        {
+            mux_stop = 1;
+
+            return;
+        }
+
+        mux_finish();
+    }
+
     send(socket_fd, _EOT_MSG_, strlen(_EOT_MSG_), 0);
 
     close(socket_fd);
 
+    report_summary();
+
     exit(EXIT_FAILURE);
 }
\ No newline at end of file
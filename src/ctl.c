@@ -0,0 +1,133 @@
+/**
+ * @file ctl.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Cliente del socket de control de las instancias del
+ *        servidor para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-12
+ */
+
+#include "include/headers/control.h"
+
+/* ---------- Prototipado de funciones ---------- */
+
+void usage(void);
+
+/**
+ * @brief Función principal del cliente de control.
+ *
+ * @details Se envía el comando (los argumentos a partir del segundo,
+ *          separados por espacios) al socket de control de la instancia
+ *          y se muestra la respuesta.
+ *
+ * @param argc Cantidad de argumentos recibidos.
+ * @param argv Vector con los argumentos recibidos.
+ *
+ * @return 0 Si la instancia aceptó el comando.
+ *         1 Si la instancia rechazó el comando o no pudo contactarse.
+ */
+int main(int argc, char *argv[])
+{
+    if ((argc == 2) && ((strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0)))
+    {
+        usage();
+
+        exit(EXIT_SUCCESS);
+    }
+
+    if (argc < 3)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Invalid arguments amount. Run this program with '-h' for help");
+
+    if (!stats_valid_instance(argv[1]))
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Invalid instance name. Run this program with '-h' for help");
+
+    char line[_CTL_LINE_LEN_];
+
+    size_t len = 0;
+
+    for (int i = 2; i < argc; i++)
+    {
+        int aux = snprintf(line + len, sizeof(line) - len, "%s%s", argv[i], (i == (argc - 1)) ? "\n" : " ");
+
+        if ((aux < 0) || ((size_t)aux >= (sizeof(line) - len)))
+            show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Command too long");
+
+        len += (size_t)aux;
+    }
+
+    struct sockaddr_un addr;
+
+    socklen_t addr_len = instance_addr(argv[1], "ctl", &addr);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd == -1)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in socket creation");
+
+    if (connect(fd, (struct sockaddr *)&addr, addr_len) == -1)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed connecting to the instance control socket (is the instance running?)");
+
+    if (write(fd, line, len) != (ssize_t)len)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed sending command");
+
+    shutdown(fd, SHUT_WR);
+
+    // La respuesta comienza con "OK" o con "ERR"
+    char reply[_MAX_BUFF_SIZE_];
+
+    ssize_t aux;
+
+    int first = 1;
+    int failed = 0;
+
+    while ((aux = read(fd, reply, sizeof(reply))) > 0)
+    {
+        if (first)
+            failed = (strncmp(reply, "ERR", 3) == 0);
+
+        first = 0;
+
+        fwrite(reply, 1, (size_t)aux, stdout);
+    }
+
+    close(fd);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Esta función muestra el uso del cliente de control.
+ */
+void usage(void)
+{
+    fprintf(stdout, "Usage: ctl INSTANCE COMMAND [ARGS]\n\n"
+                    "Commands:\n"
+                    "  interval SECONDS              Log interval\n"
+                    "  readsize BYTES                Bytes per read in every handler\n"
+                    "  rcvbuf BYTES                  SO_RCVBUF of every connection (0: kernel default)\n"
+                    "  rate PROTO|all BYTES_PER_SEC  Per-connection rate cap (0: no cap)\n"
+                    "  protorate PROTO|all BYTES_PER_SEC\n"
+                    "                                Per-protocol rate cap, shared by its connections (0: no cap)\n"
+                    "  global BYTES_PER_SEC          Instance budget, shared among protocols by weight (0: no cap)\n"
+                    "  weight PROTO WEIGHT           Weight of a protocol in the global budget (1 to 1000)\n"
+                    "  maxconns PROTO|all N          Concurrent connections per protocol (0: no limit)\n"
+                    "  maxtotal N                    Concurrent connections of the instance, i.e. handlers (0: no limit)\n"
+                    "  minfree BYTES                 Host available memory below which no connection is admitted (0: no limit)\n"
+                    "  overload reject|defer [MS]    Shed connections over the limits at once, or make them wait up to MS\n"
+                    "                                milliseconds for a free slot (default: 1000)\n"
+                    "  handlers process|thread [STACK_KB]\n"
+                    "                                Handle new connections with a process or with a thread of the listener\n"
+                    "                                with a STACK_KB stack (32 to 8192, default: 64)\n"
+                    "  trace on|off                  Enable/disable the event tracer (dump it with trc)\n"
+                    "  loglevel debug|info|warn|error\n"
+                    "                                Minimum level of the server messages (default: info)\n"
+                    "  pause | resume                Stop/restart accounting received bytes\n"
+                    "  listen PROTO PATH|[ADDR:]PORT Add a listening socket (IPv6 addresses go between brackets)\n"
+                    "  unlisten PROTO PATH|[ADDR:]PORT\n"
+                    "                                Remove a listening socket (accepted clients are kept)\n"
+                    "  listeners                     List listening sockets\n"
+                    "  endpoints                     Show the counters of every listening endpoint\n"
+                    "  config                        Show the current configuration\n"
+                    "  dump                          Show per-connection statistics\n\n"
+                    "PROTO is one of: local, ipv4, ipv6\n");
+}
@@ -0,0 +1,217 @@
+/**
+ * @file admission.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de control de admisión de conexiones
+ *        (límites de conexiones simultáneas y de memoria) para el TP #1
+ *        de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-23
+ */
+
+#include "../headers/admission.h"
+
+/**
+ * @brief Esta función actualiza la copia local de la configuración
+ *        de un listener, si cambió su generación.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param cfg Copia local de la configuración.
+ */
+static void admit_reload(struct_data *sd, struct_sv_config *cfg)
+{
+    unsigned int generation = __atomic_load_n(&sd->cfg.generation, __ATOMIC_ACQUIRE);
+
+    if (generation != cfg->generation)
+    {
+        memcpy(cfg, &sd->cfg, sizeof(*cfg));
+
+        cfg->generation = generation;
+    }
+}
+
+/**
+ * @brief Esta función intenta reservar un lugar para una nueva
+ *        conexión de un protocolo.
+ *
+ * @details El lugar se reserva incrementando el contador de conexiones
+ *          admitidas antes de verificar los límites, y se devuelve si
+ *          alguno se superó: dos listeners nunca admiten, entre ambos,
+ *          más conexiones que las permitidas (a lo sumo, ambos rechazan
+ *          una conexión que hubiera entrado).
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param cfg Configuración vigente.
+ * @param proto Protocolo de la conexión.
+ *
+ * @return 1 Si se reservó el lugar.
+ *         0 Si se superó algún límite.
+ */
+int admit_try(struct_data *sd, struct_sv_config *cfg, int proto)
+{
+    if ((cfg->min_free_mem > 0) && (mem_available() < cfg->min_free_mem))
+        return 0;
+
+    long int mine = __atomic_add_fetch(&sd->admitted[proto], 1, __ATOMIC_ACQ_REL);
+
+    int over = (cfg->max_conns[proto] > 0) && (mine > cfg->max_conns[proto]);
+
+    if (!over && (cfg->max_total > 0))
+    {
+        long int total = 0;
+
+        for (int i = 0; i < _PROTOS_; i++)
+            total += __atomic_load_n(&sd->admitted[i], __ATOMIC_ACQUIRE);
+
+        over = (total > cfg->max_total);
+    }
+
+    if (over)
+        admit_release(sd, proto);
+
+    return !over;
+}
+
+/**
+ * @brief Esta función devuelve el lugar de una conexión que terminó
+ *        (o que no llegó a atenderse).
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param proto Protocolo de la conexión.
+ */
+void admit_release(struct_data *sd, int proto)
+{
+    __atomic_sub_fetch(&sd->admitted[proto], 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Esta función decide si se atiende una conexión ya aceptada,
+ *        según la política de sobrecarga vigente.
+ *
+ * @details Con la política de rechazo, una conexión que supera los
+ *          límites se descarta de inmediato. Con la de espera, el
+ *          listener la retiene (sin leerla) hasta que se libere un lugar
+ *          o venza el tiempo máximo: mientras tanto, las conexiones
+ *          nuevas esperan en la cola del socket de escucha, que frena a
+ *          los clientes sin que el servidor cree procesos.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param cfg Copia local de la configuración del listener.
+ * @param proto Protocolo de la conexión.
+ *
+ * @return 1 Si la conexión fue admitida.
+ *         0 Si debe descartarse (ya contabilizada como descartada).
+ */
+int admit_wait(struct_data *sd, struct_sv_config *cfg, int proto)
+{
+    admit_reload(sd, cfg);
+
+    if (admit_try(sd, cfg, proto))
+        return 1;
+
+    if (cfg->overload == _OVERLOAD_DEFER_)
+    {
+        stats_add(&sd->proto[proto].deferred, 1);
+
+        long int deadline = now_ns() + ((long int)admit_defer_ms(cfg) * 1000000L);
+
+        struct timespec ts = {0, _ADMIT_POLL_NS_};
+
+        while (now_ns() < deadline)
+        {
+            nanosleep(&ts, NULL);
+
+            admit_reload(sd, cfg);
+
+            if (admit_try(sd, cfg, proto))
+                return 1;
+        }
+    }
+
+    stats_add(&sd->proto[proto].shed, 1);
+
+    return 0;
+}
+
+/**
+ * @brief Esta función devuelve la espera máxima vigente de una
+ *        conexión diferida.
+ *
+ * @param cfg Configuración vigente.
+ *
+ * @return La espera máxima, en milisegundos.
+ */
+int admit_defer_ms(struct_sv_config *cfg)
+{
+    return (cfg->defer_ms > 0) ? cfg->defer_ms : _ADMIT_DEFER_MS_;
+}
+
+/**
+ * @brief Esta función descarta una conexión aceptada.
+ *
+ * @details Se cierra con SO_LINGER en cero: el kernel responde con RST
+ *          y libera la conexión de inmediato, en lugar de conservarla
+ *          en TIME_WAIT.
+ *
+ * @param fd Descriptor de la conexión.
+ */
+void admit_shed(int fd)
+{
+    struct linger lg = {1, 0};
+
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+
+    close(fd);
+}
+
+/**
+ * @brief Esta función obtiene la memoria disponible del host.
+ *
+ * @details El valor (MemAvailable, de /proc/meminfo) se relee a lo sumo
+ *          cada _ADMIT_MEM_NS_: durante una ráfaga de conexiones, la
+ *          mayoría de las admisiones usan la última lectura.
+ *
+ * @return La memoria disponible, en bytes (o un valor máximo si no
+ *         pudo leerse, para no rechazar conexiones por un error).
+ */
+long int mem_available(void)
+{
+    static long int cached = -1;
+    static long int last = 0;
+
+    long int now = now_ns();
+
+    if ((cached != -1) && ((now - last) < _ADMIT_MEM_NS_))
+        return cached;
+
+    FILE *f = fopen("/proc/meminfo", "r");
+
+    long int kb = -1;
+
+    if (f)
+    {
+        char line[128];
+
+        while (fgets(line, sizeof(line), f))
+            if (sscanf(line, "MemAvailable: %ld kB", &kb) == 1)
+                break;
+
+        fclose(f);
+    }
+
+    cached = (kb == -1) ? __LONG_MAX__ : (kb * 1024);
+    last = now;
+
+    return cached;
+}
+
+/**
+ * @brief Esta función devuelve el nombre de una política de sobrecarga.
+ *
+ * @param policy Política de sobrecarga.
+ *
+ * @return El nombre de la política.
+ */
+char *overload_name(int policy)
+{
+    return (policy == _OVERLOAD_DEFER_) ? "defer" : "reject";
+}
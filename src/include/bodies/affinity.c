@@ -0,0 +1,200 @@
+/**
+ * @file affinity.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de afinidad de CPU y ubicación
+ *        de memoria en nodos NUMA locales para el TP #1 de
+ *        Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-02
+ */
+
+#include "../headers/affinity.h"
+
+/**
+ * @brief Esta función interpreta una lista de CPUs con el
+ *        formato de 'taskset -c' (por ejemplo "0-3,6,8-9").
+ *
+ * @param list Cadena con la lista de CPUs.
+ * @param set Conjunto de CPUs donde se almacenará el resultado.
+ *
+ * @return 0 Si la lista es válida.
+ *        -1 Si la lista tiene errores de formato o CPUs fuera de rango.
+ */
+int parse_cpu_list(char *list, cpu_set_t *set)
+{
+    char *p = list;
+
+    CPU_ZERO(set);
+
+    while (*p)
+    {
+        char *end;
+
+        long int first = strtol(p, &end, 10);
+        long int last = first;
+
+        if ((end == p) || (first < 0))
+            return -1;
+
+        if (*end == '-')
+        {
+            p = end + 1;
+
+            last = strtol(p, &end, 10);
+
+            if ((end == p) || (last < first))
+                return -1;
+        }
+
+        if (last >= CPU_SETSIZE)
+            return -1;
+
+        for (long int cpu = first; cpu <= last; cpu++)
+            CPU_SET((size_t)cpu, set);
+
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return -1;
+
+        p = end;
+    }
+
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Esta función inicializa la configuración de afinidad, sin
+ *        conjuntos de CPUs, y guarda la afinidad del servidor al
+ *        arrancar.
+ *
+ * @param aff Configuración de afinidad a inicializar.
+ */
+void affinity_init(struct_affinity *aff)
+{
+    memset(aff, 0, sizeof(*aff));
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &aff->startup_cpus) == -1)
+        CPU_ZERO(&aff->startup_cpus);
+}
+
+/**
+ * @brief Esta función fija el proceso (o hilo) actual al
+ *        conjunto de CPUs especificado.
+ *
+ * @details Si el conjunto está vacío se restaura la afinidad del
+ *          servidor al arrancar: los procesos e hilos heredan la de
+ *          quien los crea, por lo que sin restaurarla un handler
+ *          quedaría en las CPUs de su listener, o un listener creado
+ *          en ejecución, en las del logger.
+ *
+ * @param aff Configuración de afinidad del servidor.
+ * @param set Conjunto de CPUs permitidas.
+ *
+ * @return 0 Si la afinidad se aplicó (o no había nada que aplicar).
+ *        -1 Si el kernel rechazó la afinidad solicitada.
+ */
+int pin_to_cpus(struct_affinity *aff, cpu_set_t *set)
+{
+    if (CPU_COUNT(set) == 0)
+        set = &aff->startup_cpus;
+
+    if (CPU_COUNT(set) == 0)
+        return 0;
+
+    return sched_setaffinity(0, sizeof(cpu_set_t), set);
+}
+
+/**
+ * @brief Esta función fija el proceso (o hilo) actual a la CPU
+ *        que procesó por última vez los paquetes del socket.
+ *
+ * @details SO_INCOMING_CPU reporta la CPU que atendió la interrupción
+ *          (o el softirq de RPS) del flujo. Ejecutar el handler en esa
+ *          misma CPU mantiene calientes las caches con los datos recién
+ *          recibidos. Si se especificó un conjunto de CPUs para handlers,
+ *          sólo se respeta la CPU entrante si pertenece a dicho conjunto.
+ *
+ * @param fd Descriptor del socket del cliente.
+ * @param allowed Conjunto de CPUs permitidas (vacío si no hay restricción).
+ *
+ * @return El número de CPU elegida, o -1 si no pudo determinarse.
+ */
+int pin_to_incoming_cpu(int fd, cpu_set_t *allowed)
+{
+    int cpu = -1;
+
+    socklen_t len = sizeof(cpu);
+
+    if ((getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == -1) || (cpu < 0) || (cpu >= CPU_SETSIZE))
+        return -1;
+
+    if ((CPU_COUNT(allowed) > 0) && !CPU_ISSET((size_t)cpu, allowed))
+        return -1;
+
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET((size_t)cpu, &set);
+
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &set) == -1)
+        return -1;
+
+    return cpu;
+}
+
+/**
+ * @brief Esta función aplica la política de afinidad configurada
+ *        a un handler recién creado para atender a un cliente.
+ *
+ * @details En modo automático se intenta co-ubicar el handler con la
+ *          CPU entrante del socket; si no es posible (por ejemplo, en
+ *          sockets locales) se recurre al conjunto de CPUs de handlers.
+ *
+ * @param fd Descriptor del socket del cliente.
+ * @param aff Configuración de afinidad del servidor.
+ */
+void pin_handler(int fd, struct_affinity *aff)
+{
+    if (aff->auto_mode && (pin_to_incoming_cpu(fd, &aff->handler_cpus) != -1))
+        return;
+
+    if (pin_to_cpus(aff, &aff->handler_cpus) == -1)
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed trying to pin client handler to CPU set");
+}
+
+/**
+ * @brief Esta función reserva un buffer en el nodo NUMA local
+ *        a la CPU en la que se ejecuta el proceso.
+ *
+ * @details Linux ubica cada página en el nodo de la CPU que la toca por
+ *          primera vez (first-touch). Por eso el buffer se reserva con
+ *          mmap y se inicializa recién después de haber fijado la
+ *          afinidad del proceso, y no se hereda del padre vía fork.
+ *
+ * @param size Tamaño del buffer a reservar.
+ *
+ * @return Puntero al buffer reservado.
+ */
+void *alloc_local_buffer(size_t size)
+{
+    void *buffer = mmap(NULL, size, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS), -1, 0);
+
+    if (buffer == MAP_FAILED)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in memory allocation");
+
+    memset(buffer, 0, size);
+
+    return buffer;
+}
+
+/**
+ * @brief Esta función libera un buffer reservado con alloc_local_buffer.
+ *
+ * @param buffer Puntero al buffer a liberar.
+ * @param size Tamaño del buffer.
+ */
+void free_local_buffer(void *buffer, size_t size)
+{
+    munmap(buffer, size);
+}
@@ -9,6 +9,35 @@
 
 #include "../headers/clients_setup.h"
 
+int socket_fd;
+int mux_channels = 0;
+int payload_gen = _PAYLOAD_CONST_;
+int compress = 0;
+int tcp_info = 0;
+int report_interval = 0;
+int report_fmt = _REPORT_TEXT_;
+int tick_msgs = 0;
+long int tick_ns = 0;
+size_t coalesce_bytes = 0;
+long int deadline_ns = 0;
+int flush_tick = 0;
+volatile sig_atomic_t mux_sending = 0;
+volatile sig_atomic_t mux_stop = 0;
+
+// Última muestra de TCP_INFO informada
+static struct_tcp_sample tcp_prev;
+
+static int tcp_active = 0; // Se informa el estado TCP (se pidió y la conexión es TCP)
+
+// Contadores de envío de la conexión, y los del último informe
+static struct_cl_stats cl_stats;
+static struct_cl_stats report_prev;
+
+static long int start_ns = 0;       // Instante en que se estableció la conexión
+static long int report_prev_ns = 0; // Instante del último informe
+static volatile sig_atomic_t ticks = 0; // Períodos del temporizador transcurridos (sólo los cuenta el handler)
+static long int ticks_seen = 0;         // Períodos ya informados
+
 /**
  * @brief Creación y ejecución de cliente con conexión
  *        TCP/IPv4.
@@ -52,8 +81,21 @@ void run_ipv4_cl(char *address, uint16_t port, int buffer_size)
     if (connect(socket_fd, (struct sockaddr *)&struct_sv, sizeof(struct_sv)) == -1)
         show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed connecting to socket {IPv4}");
 
+    report_start();
+
+    if (mux_channels > 0)
+        run_mux(buffer, buffer_size - 1);
+
+    if (tick_msgs > 0)
+        run_small(buffer, buffer_size - 1);
+
+    if ((payload_gen != _PAYLOAD_CONST_) || compress)
+        run_payload(buffer_size - 1);
+
+    size_t len = strlen(buffer);
+
     while (1)
-        if (send(socket_fd, buffer, strlen(buffer), 0) == -1)
+        if (cl_send(buffer, len, (long int)len) == -1)
             show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed sending message {IPv4}");
 }
 
@@ -97,8 +139,21 @@ void run_ipv6_cl(char *address, char *interface, uint16_t port, int buffer_size)
     if (connect(socket_fd, (struct sockaddr *)&struct_sv, sizeof(struct_sv)) == -1)
         show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed connecting socket {IPv6}");
 
+    report_start();
+
+    if (mux_channels > 0)
+        run_mux(buffer, buffer_size - 1);
+
+    if (tick_msgs > 0)
+        run_small(buffer, buffer_size - 1);
+
+    if ((payload_gen != _PAYLOAD_CONST_) || compress)
+        run_payload(buffer_size - 1);
+
+    size_t len = strlen(buffer);
+
     while (1)
-        if (send(socket_fd, buffer, strlen(buffer), 0) == -1)
+        if (cl_send(buffer, len, (long int)len) == -1)
             show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed sending message {IPv6}");
 }
 
@@ -143,7 +198,735 @@ void run_local_cl(char *socket_filename, int buffer_size)
     if (connect(socket_fd, (struct sockaddr *)&struct_sv, sv_len) == -1)
         show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed connecting socket {LOCAL}");
 
+    report_start();
+
+    if (mux_channels > 0)
+        run_mux(buffer, buffer_size - 1);
+
+    if (tick_msgs > 0)
+        run_small(buffer, buffer_size - 1);
+
+    if ((payload_gen != _PAYLOAD_CONST_) || compress)
+        run_payload(buffer_size - 1);
+
+    size_t len = strlen(buffer);
+
     while (1)
-        if (send(socket_fd, buffer, strlen(buffer), 0) == -1)
+        if (cl_send(buffer, len, (long int)len) == -1)
             show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed sending message {LOCAL}");
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Esta función busca, a partir de un canal dado, el próximo
+ *        canal que todavía tiene créditos.
+ *
+ * @param credit Créditos disponibles de cada canal.
+ * @param ch Canal desde el cual comenzar la búsqueda.
+ *
+ * @return El canal encontrado, o -1 si ningún canal tiene créditos.
+ */
+static int next_channel(long int *credit, int ch)
+{
+    for (int i = 0; i < mux_channels; i++)
+        if (credit[(ch + i) % mux_channels] > 0)
+            return (ch + i) % mux_channels;
+
+    return -1;
+}
+
+/**
+ * @brief Esta función lee los créditos devueltos por el servidor.
+ *
+ * @details Sólo bloquea si ningún canal tiene créditos: en ese caso
+ *          espera a que llegue una devolución. Las tramas de créditos
+ *          pueden quedar partidas entre dos lecturas.
+ *
+ * @param credit Créditos disponibles de cada canal.
+ * @param rx Encabezado en recepción.
+ * @param rx_len Bytes recibidos del encabezado.
+ */
+static void read_credits(long int *credit, unsigned char *rx, int *rx_len)
+{
+    int block = 0;
+
+    while (1)
+    {
+        ssize_t n = recv(socket_fd, rx + *rx_len, (size_t)(_MUX_HDR_LEN_ - *rx_len), (block ? 0 : MSG_DONTWAIT));
+
+        if (n == 0)
+            show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Connection closed by the server {MUX}");
+
+        if (n == -1)
+        {
+            if (block || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+                show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed receiving credits {MUX}");
+
+            if (next_channel(credit, 0) != -1)
+                return;
+
+            block = 1;
+
+            continue;
+        }
+
+        *rx_len += (int)n;
+
+        if (*rx_len < _MUX_HDR_LEN_)
+            continue;
+
+        *rx_len = 0;
+
+        int ch;
+        int type;
+        uint32_t len;
+
+        mux_decode(rx, &ch, &type, &len);
+
+        if ((type == _MUX_CREDIT_) && (ch < mux_channels))
+            credit[ch] += len;
+
+        block = 0;
+    }
+}
+
+/**
+ * @brief Envío de datos por varios canales lógicos sobre la conexión
+ *        ya establecida.
+ *
+ * @details Los canales se recorren por turnos y cada trama lleva a lo
+ *          sumo tantos bytes como créditos le queden a su canal. Los
+ *          créditos devueltos sólo se leen cuando al canal de turno no
+ *          le alcanzan para un buffer completo.
+ *
+ * @param buffer Mensaje a enviar por cada canal.
+ * @param size Largo del mensaje.
+ */
+void run_mux(char *buffer, int size)
+{
+    int accepted = mux_hello(socket_fd, mux_channels);
+
+    if (accepted <= 0)
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Server rejected the multiplexed connection {MUX}");
+
+    if (accepted < mux_channels)
+        fprintf(stdout, "[PID: %d] <CLIENT> The server accepted %d of %d channels\n", getpid(), accepted, mux_channels);
+
+    mux_channels = accepted;
+
+    long int credit[_MUX_MAX_CHANNELS_];
+
+    for (int i = 0; i < mux_channels; i++)
+        credit[i] = _MUX_WINDOW_;
+
+    unsigned char rx[_MUX_HDR_LEN_];
+
+    int rx_len = 0;
+
+    // El mensaje se copia (o se genera) una única vez a continuación del lugar del encabezado
+    unsigned char frame[_MUX_HDR_LEN_ + _MAX_BUFF_SIZE_];
+
+    if (payload_gen != _PAYLOAD_CONST_)
+        payload_fill((char *)frame + _MUX_HDR_LEN_, (size_t)size, payload_gen, (unsigned int)getpid());
+    else
+        memcpy(frame + _MUX_HDR_LEN_, buffer, (size_t)size);
+
+    int ch = 0;
+
+    while (1)
+    {
+        if (credit[ch] < size)
+        {
+            read_credits(credit, rx, &rx_len);
+
+            ch = next_channel(credit, ch);
+        }
+
+        size_t len = (credit[ch] < size) ? (size_t)credit[ch] : (size_t)size;
+
+        mux_encode(frame, ch, _MUX_DATA_, (uint32_t)len);
+
+        // Un SIGINT a mitad de una trama sólo se atiende al completarla
+        mux_sending = 1;
+
+        if (cl_send(frame, (_MUX_HDR_LEN_ + len), (long int)len) == -1)
+            show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed sending message {MUX}");
+
+        mux_sending = 0;
+
+        if (mux_stop)
+            mux_finish();
+
+        credit[ch] -= (long int)len;
+
+        ch = (ch + 1) % mux_channels;
+    }
+}
+
+/**
+ * @brief Envío de datos generados (y, opcionalmente, comprimidos)
+ *        sobre la conexión ya establecida.
+ *
+ * @details Los datos se generan una única vez y se recorren en forma
+ *          circular, de a un mensaje por vez. Con compresión, cada
+ *          mensaje se comprime en un bloque propio (o viaja sin
+ *          comprimir, si no se reduce), de modo que el costo de
+ *          comprimir se paga en cada envío, como en un emisor real.
+ *
+ * @param size Largo de cada mensaje.
+ */
+void run_payload(int size)
+{
+    char *pool = malloc(_PAYLOAD_POOL_);
+
+    if (!pool)
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed allocating payload");
+
+    payload_fill(pool, _PAYLOAD_POOL_, payload_gen, (unsigned int)getpid());
+
+    if (compress && (lz_hello(socket_fd) == -1))
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Server rejected the compressed connection {LZ}");
+
+    unsigned char block[_LZ_HDR_LEN_ + _MAX_BUFF_SIZE_];
+
+    size_t offset = 0;
+
+    while (1)
+    {
+        if ((offset + (size_t)size) > _PAYLOAD_POOL_)
+            offset = 0;
+
+        unsigned char *src = (unsigned char *)pool + offset;
+        unsigned char *out = src;
+
+        size_t len = (size_t)size;
+
+        offset += len;
+
+        if (compress)
+        {
+            int n = lz_compress(src, size, block + _LZ_HDR_LEN_, size - 1);
+
+            if (n == -1)
+            {
+                memcpy(block + _LZ_HDR_LEN_, src, (size_t)size);
+
+                n = size;
+            }
+
+            lz_encode(block, size, n);
+
+            out = block;
+            len = (size_t)(_LZ_HDR_LEN_ + n);
+        }
+
+        // Un SIGINT a mitad de un bloque sólo se atiende al completarlo
+        mux_sending = 1;
+
+        if (cl_send(out, len, size) == -1)
+            show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed sending message");
+
+        mux_sending = 0;
+
+        if (mux_stop)
+            mux_finish();
+    }
+}
+
+/**
+ * @brief Esta función envía los mensajes pendientes de un lote y
+ *        contabiliza su espera.
+ *
+ * @param co Lote a enviar; queda vacío.
+ */
+static void small_flush(struct_coalesce *co)
+{
+    if (co->msgs == 0)
+        return;
+
+    cl_stats.queue_ns += coalesce_wait_ns(co, now_ns());
+    cl_stats.msgs += co->msgs;
+
+    // Un SIGINT a mitad de un lote sólo se atiende al completarlo
+    mux_sending = 1;
+
+    if (cl_sendv(co->iov, co->n_iov, (long int)co->bytes) == -1)
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed sending message batch");
+
+    mux_sending = 0;
+
+    coalesce_reset(co);
+}
+
+/**
+ * @brief Esta función espera el comienzo del próximo período del modo
+ *        de mensajes chicos.
+ *
+ * @details Mientras tanto, el lote sólo espera hasta que venza la espera
+ *          máxima de su mensaje más antiguo. Si el emisor se atrasó más
+ *          de un período (por ejemplo, bloqueado en un envío), no intenta
+ *          recuperar el atraso con una ráfaga de períodos.
+ *
+ * @param co Lote en curso.
+ * @param next_tick Comienzo del próximo período; se corrige si hubo atraso.
+ */
+static void small_wait(struct_coalesce *co, long int *next_tick)
+{
+    long int now;
+
+    while (!mux_stop && ((now = now_ns()) < *next_tick))
+    {
+        report_poll();
+
+        long int due = coalesce_due_ns(co);
+
+        if ((due != -1) && (due <= now))
+        {
+            small_flush(co);
+
+            continue;
+        }
+
+        long int wake = ((due != -1) && (due < *next_tick)) ? due : *next_tick;
+
+        struct timespec ts = {(wake - now) / 1000000000L, (wake - now) % 1000000000L};
+
+        nanosleep(&ts, NULL);
+    }
+
+    if ((now_ns() - *next_tick) > tick_ns)
+        *next_tick = now_ns();
+}
+
+/**
+ * @brief Envío de muchos mensajes chicos por período, agrupados en
+ *        lotes sobre la conexión ya establecida.
+ *
+ * @details En cada período se producen 'tick_msgs' mensajes lógicos del
+ *          tamaño indicado, que en lugar de enviarse de a uno se agregan
+ *          a un lote. El lote se envía, con una única llamada a sendmsg
+ *          (con varios segmentos, si hace falta), cuando alcanza el umbral
+ *          de tamaño, cuando su mensaje más antiguo supera la espera
+ *          máxima o, si se pidió, al final de cada período (un punto de
+ *          envío explícito, como el de una aplicación que termina de
+ *          procesar un lote de eventos). Sin umbral, cada mensaje se
+ *          envía solo: es la referencia contra la cual medir el
+ *          agrupamiento.
+ *
+ *          Los mensajes se toman en forma circular de un buffer generado
+ *          una única vez (con el generador de datos o, si no se eligió
+ *          uno, con el caracter del mensaje constante), por lo que los
+ *          consecutivos son contiguos y ocupan un mismo segmento.
+ *
+ * @param buffer Mensaje constante de la conexión.
+ * @param size Largo de cada mensaje.
+ */
+void run_small(char *buffer, int size)
+{
+    char *pool = malloc(_PAYLOAD_POOL_);
+
+    struct_coalesce *co = malloc(sizeof(*co));
+
+    if (!pool || !co)
+        show_err(getpid(), _CLIENT_SRC_, _FATAL_ERR_, "Failed allocating message batch");
+
+    if (payload_gen != _PAYLOAD_CONST_)
+        payload_fill(pool, _PAYLOAD_POOL_, payload_gen, (unsigned int)getpid());
+    else
+        memset(pool, buffer[0], _PAYLOAD_POOL_);
+
+    coalesce_init(co, coalesce_bytes, deadline_ns);
+
+    size_t offset = 0;
+
+    long int next_tick = now_ns();
+
+    while (1)
+    {
+        for (int i = 0; i < tick_msgs; i++)
+        {
+            if ((offset + (size_t)size) > _PAYLOAD_POOL_)
+                offset = 0;
+
+            if (coalesce_add(co, pool + offset, (size_t)size, now_ns()))
+                small_flush(co);
+
+            offset += (size_t)size;
+
+            // Los mensajes ya producidos se envían antes del fin de transmisión
+            if (mux_stop)
+            {
+                small_flush(co);
+
+                mux_finish();
+            }
+        }
+
+        if (flush_tick)
+            small_flush(co);
+
+        if (tick_ns > 0)
+        {
+            next_tick += tick_ns;
+
+            small_wait(co, &next_tick);
+        }
+    }
+}
+
+/**
+ * @brief Esta función termina una conexión multiplexada o comprimida,
+ *        enviando la trama (o el bloque) de fin de transmisión. En
+ *        conexiones sin compresión con datos generados, se envía el
+ *        mensaje de fin de transmisión.
+ */
+void mux_finish(void)
+{
+    unsigned char end[_LZ_HDR_LEN_];
+
+    if (mux_channels > 0)
+        mux_send_frame(socket_fd, 0, _MUX_CLOSE_, 0);
+    else if (compress)
+    {
+        lz_encode(end, 0, 0);
+
+        send(socket_fd, end, sizeof(end), MSG_NOSIGNAL);
+    }
+    else
+        send(socket_fd, _EOT_MSG_, strlen(_EOT_MSG_), MSG_NOSIGNAL);
+
+    close(socket_fd);
+
+    report_summary();
+
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Esta función espera a que haya lugar en el buffer de envío
+ *        de la conexión, y suma la espera al tiempo bloqueado.
+ */
+static void wait_writable(void)
+{
+    struct pollfd pfd = {.fd = socket_fd, .events = POLLOUT, .revents = 0};
+
+    long int start = now_ns();
+
+    // Los informes pendientes se escriben aunque el envío siga bloqueado
+    while ((poll(&pfd, 1, -1) == -1) && (errno == EINTR))
+        report_poll();
+
+    cl_stats.blocked_ns += now_ns() - start;
+}
+
+/**
+ * @brief Esta función envía un buffer completo por la conexión,
+ *        contabilizando cada llamada a send.
+ *
+ * @details Sin informes periódicos, los envíos son bloqueantes, como
+ *          siempre. Con informes periódicos, son no bloqueantes: cuando
+ *          el buffer de envío del kernel se llena, send falla con EAGAIN
+ *          y la espera se mide alrededor de poll, sin consultar el reloj
+ *          en cada envío.
+ *
+ * @param buf Datos a enviar.
+ * @param len Largo de los datos.
+ * @param payload Bytes de datos que representan (sin encabezados, y sin comprimir).
+ *
+ * @return 0 Si se envió el buffer completo.
+ *        -1 Si falló el envío.
+ */
+int cl_send(const void *buf, size_t len, long int payload)
+{
+    int flags = report_interval ? MSG_DONTWAIT : 0;
+
+    size_t sent = 0;
+
+    while (sent < len)
+    {
+        report_poll();
+
+        ssize_t n = send(socket_fd, (const char *)buf + sent, len - sent, flags);
+
+        cl_stats.sends++;
+
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (!flags || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+                return -1;
+
+            cl_stats.eagain++;
+
+            wait_writable();
+
+            continue;
+        }
+
+        if ((size_t)n < (len - sent))
+            cl_stats.partial++;
+
+        sent += (size_t)n;
+
+        cl_stats.bytes += n;
+    }
+
+    cl_stats.payload += payload;
+
+    return 0;
+}
+
+/**
+ * @brief Esta función envía un lote de segmentos por la conexión, con
+ *        una llamada a sendmsg por vez, contabilizando cada llamada.
+ *
+ * @details Igual que cl_send, pero si el kernel acepta sólo una parte
+ *          del lote, se avanza sobre los segmentos ya enviados y se
+ *          envía el resto. Los segmentos se modifican.
+ *
+ * @param iov Segmentos a enviar.
+ * @param n_iov Cantidad de segmentos.
+ * @param payload Bytes de datos que representan.
+ *
+ * @return 0 Si se envió el lote completo.
+ *        -1 Si falló el envío.
+ */
+int cl_sendv(struct iovec *iov, int n_iov, long int payload)
+{
+    int flags = MSG_NOSIGNAL | (report_interval ? MSG_DONTWAIT : 0);
+
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (size_t)n_iov;
+
+    while (msg.msg_iovlen > 0)
+    {
+        report_poll();
+
+        size_t left = 0;
+
+        for (size_t i = 0; i < msg.msg_iovlen; i++)
+            left += msg.msg_iov[i].iov_len;
+
+        ssize_t n = sendmsg(socket_fd, &msg, flags);
+
+        cl_stats.sends++;
+
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (!(flags & MSG_DONTWAIT) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+                return -1;
+
+            cl_stats.eagain++;
+
+            wait_writable();
+
+            continue;
+        }
+
+        if ((size_t)n < left)
+            cl_stats.partial++;
+
+        cl_stats.bytes += n;
+
+        // Se descartan los segmentos enviados por completo, y la parte enviada del siguiente
+        while ((msg.msg_iovlen > 0) && ((size_t)n >= msg.msg_iov->iov_len))
+        {
+            n -= (ssize_t)msg.msg_iov->iov_len;
+
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+
+        if (msg.msg_iovlen > 0)
+        {
+            msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+            msg.msg_iov->iov_len -= (size_t)n;
+        }
+    }
+
+    cl_stats.payload += payload;
+
+    return 0;
+}
+
+/**
+ * @brief Esta función informa el estado de emisión de la conexión
+ *        desde la muestra anterior.
+ *
+ * @details Se informan los datos que sólo conoce el emisor (ventana de
+ *          congestión, retransmisiones, delivery rate) y qué parte del
+ *          tiempo en que hubo datos para enviar estuvo limitada por el
+ *          servidor (la ventana del receptor), por el propio cliente (el
+ *          buffer de envío) o por la red (ver tcpinfo.h).
+ *
+ * @param signal Señal recibida.
+ */
+void tcp_report(int signal)
+{
+    (void)signal;
+
+    struct_tcp_sample curr;
+
+    if (tcpinfo_sample(socket_fd, &curr) == -1)
+        return;
+
+    char line[512];
+
+    int n = snprintf(line, sizeof(line), "[PID: %d] <CLIENT> TCP ", getpid());
+
+    tcpinfo_describe(&tcp_prev, &curr, line + n, sizeof(line) - (size_t)n - 1);
+
+    strcat(line, "\n");
+
+    try_write(STDOUT_FILENO, line);
+
+    tcp_prev = curr;
+}
+
+/**
+ * @brief Esta función escribe un informe de envío de la conexión,
+ *        desde el informe anterior.
+ *
+ * @param kind Tipo de informe ("report" o "summary").
+ * @param prev Contadores del informe anterior (o en cero, para el resumen).
+ * @param prev_ns Instante del informe anterior (o de la conexión, para el resumen).
+ */
+static void report_print(char *kind, struct_cl_stats *prev, long int prev_ns)
+{
+    long int now = now_ns();
+
+    char line[_REPORT_LINE_LEN_];
+
+    int measured = ((report_interval > 0) ? _REPORT_TIMED_ : 0) | ((tick_msgs > 0) ? _REPORT_MSGS_ : 0);
+
+    report_format(line, sizeof(line), report_fmt, kind, prev, &cl_stats, (double)(now - start_ns) / 1e9, (double)(now - prev_ns) / 1e9, measured);
+
+    try_write(STDOUT_FILENO, line);
+}
+
+/**
+ * @brief Handler para señales SIGALRM: cada segundo, cuenta un período
+ *        del temporizador.
+ *
+ * @details Los informes no se escriben desde el handler: formatearlos
+ *          no es seguro dentro de una señal, y los contadores de envío
+ *          podrían estar a mitad de actualizarse. Los escribe el bucle
+ *          de envío (ver report_poll).
+ *
+ * @param signal Señal recibida.
+ */
+void report_tick(int signal)
+{
+    (void)signal;
+
+    ticks++;
+}
+
+/**
+ * @brief Esta función escribe los informes pendientes desde el bucle
+ *        de envío: el estado TCP de la conexión (si se pidió con
+ *        --tcp-info) y, cada 'report_interval' segundos, el informe de
+ *        envío.
+ *
+ * @details Se la invoca antes de cada envío y en cada espera, por lo
+ *          que sólo compara el contador de períodos con el último
+ *          informado. Si transcurrió más de un período (por ejemplo, con
+ *          un envío bloqueante), se escribe un único informe.
+ */
+void report_poll(void)
+{
+    long int curr_ticks = ticks;
+
+    if (curr_ticks == ticks_seen)
+        return;
+
+    if (tcp_active)
+        tcp_report(SIGALRM);
+
+    if ((report_interval > 0) && ((curr_ticks / report_interval) != (ticks_seen / report_interval)))
+    {
+        struct_cl_stats curr = cl_stats;
+
+        report_print("report", &report_prev, report_prev_ns);
+
+        report_prev = curr;
+        report_prev_ns = now_ns();
+    }
+
+    ticks_seen = curr_ticks;
+}
+
+/**
+ * @brief Esta función escribe el resumen de envío de toda la conexión,
+ *        y el último informe del estado TCP, si se pidió.
+ *
+ * @details Antes de armarlo, se detiene el temporizador y se bloquea
+ *          SIGALRM, de modo que ninguna señal pendiente interrumpa el
+ *          resumen.
+ */
+void report_summary(void)
+{
+    struct_cl_stats zero;
+
+    struct itimerval off;
+
+    sigset_t alrm;
+
+    memset(&zero, 0, sizeof(zero));
+    memset(&off, 0, sizeof(off));
+
+    sigemptyset(&alrm);
+    sigaddset(&alrm, SIGALRM);
+
+    sigprocmask(SIG_BLOCK, &alrm, NULL);
+
+    setitimer(ITIMER_REAL, &off, NULL);
+
+    if (tcp_active)
+        tcp_report(SIGALRM);
+
+    if (start_ns != 0)
+        report_print("summary", &zero, start_ns);
+}
+
+/**
+ * @brief Esta función comienza a contabilizar los envíos de la
+ *        conexión recién establecida y, si se pidieron informes
+ *        periódicos (--report o --tcp-info), inicia el temporizador.
+ *
+ * @details Los períodos los marca una señal periódica, sin consultar
+ *          el reloj en el bucle de envío, que escribe los informes
+ *          pendientes; con SA_RESTART, un envío interrumpido se reanuda.
+ */
+void report_start(void)
+{
+    start_ns = report_prev_ns = now_ns();
+
+    tcp_active = tcp_info && (tcpinfo_sample(socket_fd, &tcp_prev) != -1);
+
+    if (!tcp_active && (report_interval == 0))
+        return;
+
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = report_tick;
+    sa.sa_flags = SA_RESTART;
+
+    struct itimerval it;
+
+    it.it_interval.tv_sec = _TCPINFO_NS_ / 1000000000L;
+    it.it_interval.tv_usec = (_TCPINFO_NS_ % 1000000000L) / 1000;
+    it.it_value = it.it_interval;
+
+    if ((sigaction(SIGALRM, &sa, NULL) == -1) || (setitimer(ITIMER_REAL, &it, NULL) == -1))
+        show_err(getpid(), _CLIENT_SRC_, _NORM_ERR_, "Failed starting periodic reports");
+}
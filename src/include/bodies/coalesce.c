@@ -0,0 +1,156 @@
+/**
+ * @file coalesce.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de agrupamiento de mensajes chicos en
+ *        envíos vectoriales de los clientes para el TP #1 de Sistemas
+ *        Operativos II.
+ * @version 0.1
+ * @since 2022-04-27
+ */
+
+#include "../headers/coalesce.h"
+
+/**
+ * @brief Esta función inicializa un lote vacío con sus políticas de
+ *        envío.
+ *
+ * @param co Lote a inicializar.
+ * @param threshold Umbral de tamaño, en bytes (0: cada mensaje se envía solo).
+ * @param deadline_ns Espera máxima del mensaje más antiguo (0: sin límite).
+ */
+void coalesce_init(struct_coalesce *co, size_t threshold, long int deadline_ns)
+{
+    co->threshold = threshold;
+    co->deadline_ns = deadline_ns;
+
+    coalesce_reset(co);
+}
+
+/**
+ * @brief Esta función agrega un mensaje al lote.
+ *
+ * @details Si el mensaje comienza donde termina el anterior (por
+ *          ejemplo, mensajes consecutivos de un mismo buffer), se
+ *          extiende el último segmento en lugar de ocupar uno nuevo.
+ *
+ * @param co Lote.
+ * @param buf Datos del mensaje (no se copian).
+ * @param len Largo del mensaje.
+ * @param now Instante actual.
+ *
+ * @return 1 Si el lote debe enviarse: alcanzó el umbral de tamaño, se
+ *           quedó sin segmentos o su mensaje más antiguo superó la
+ *           espera máxima.
+ *         0 En caso contrario.
+ */
+int coalesce_add(struct_coalesce *co, const void *buf, size_t len, long int now)
+{
+    struct iovec *last = (co->n_iov > 0) ? &co->iov[co->n_iov - 1] : NULL;
+
+    if (last && (((char *)last->iov_base + last->iov_len) == (char *)buf))
+        last->iov_len += len;
+    else
+    {
+        co->iov[co->n_iov].iov_base = (void *)buf;
+        co->iov[co->n_iov].iov_len = len;
+
+        co->n_iov++;
+    }
+
+    if (co->msgs == 0)
+        co->first_ns = now;
+
+    co->msgs++;
+    co->bytes += len;
+    co->enqueued_ns += now - co->first_ns;
+
+    return (co->bytes >= co->threshold) || (co->n_iov == _COALESCE_MAX_IOV_) ||
+           ((co->deadline_ns > 0) && ((now - co->first_ns) >= co->deadline_ns));
+}
+
+/**
+ * @brief Esta función devuelve el instante en que vence la espera
+ *        máxima del mensaje más antiguo del lote.
+ *
+ * @param co Lote.
+ *
+ * @return El instante de vencimiento, o -1 si el lote está vacío o no
+ *         tiene espera máxima.
+ */
+long int coalesce_due_ns(struct_coalesce *co)
+{
+    if ((co->msgs == 0) || (co->deadline_ns == 0))
+        return -1;
+
+    return co->first_ns + co->deadline_ns;
+}
+
+/**
+ * @brief Esta función calcula la espera total de los mensajes del lote,
+ *        desde que se agregó cada uno hasta el instante indicado.
+ *
+ * @param co Lote.
+ * @param now Instante en que se envía el lote.
+ *
+ * @return La suma de las esperas, en nanosegundos.
+ */
+long int coalesce_wait_ns(struct_coalesce *co, long int now)
+{
+    return (co->msgs * (now - co->first_ns)) - co->enqueued_ns;
+}
+
+/**
+ * @brief Esta función vacía el lote, luego de enviarlo.
+ *
+ * @param co Lote.
+ */
+void coalesce_reset(struct_coalesce *co)
+{
+    co->n_iov = 0;
+    co->msgs = 0;
+    co->bytes = 0;
+    co->first_ns = 0;
+    co->enqueued_ns = 0;
+}
+
+/**
+ * @brief Esta función interpreta el período del modo de mensajes chicos.
+ *
+ * @param spec Período con el formato 'N[:USEC]': N mensajes por período
+ *             y, opcionalmente, un período de USEC microsegundos (sin él,
+ *             los períodos se suceden sin pausa).
+ * @param msgs Mensajes por período.
+ * @param period_ns Duración del período, en nanosegundos (0: sin pausa).
+ *
+ * @return 0 Si el período es válido.
+ *        -1 En caso contrario.
+ */
+int coalesce_parse_tick(char *spec, int *msgs, long int *period_ns)
+{
+    char *rest;
+
+    long int n = strtol(spec, &rest, 10);
+
+    if ((rest == spec) || (n < 1) || (n > _COALESCE_MAX_TICK_MSGS_))
+        return -1;
+
+    long int us = 0;
+
+    if (*rest == ':')
+    {
+        char *num = rest + 1;
+
+        us = strtol(num, &rest, 10);
+
+        if ((rest == num) || (us < 1))
+            return -1;
+    }
+
+    if (*rest != '\0')
+        return -1;
+
+    *msgs = (int)n;
+    *period_ns = us * 1000;
+
+    return 0;
+}
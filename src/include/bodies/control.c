@@ -0,0 +1,478 @@
+/**
+ * @file control.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones del socket de control, que permite
+ *        reconfigurar una instancia del servidor en ejecución para
+ *        el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-12
+ */
+
+#include "../headers/servers_setup.h"
+
+/**
+ * @brief Esta función crea el socket por el que una instancia
+ *        atiende comandos de control.
+ *
+ * @param instance Nombre de la instancia.
+ *
+ * @return El descriptor del socket, o -1 si no pudo crearse.
+ */
+int control_open(char *instance)
+{
+    struct sockaddr_un addr;
+
+    socklen_t len = instance_addr(instance, "ctl", &addr);
+
+    int fd = socket(AF_UNIX, (SOCK_STREAM | SOCK_CLOEXEC), 0);
+
+    if (fd == -1)
+        return -1;
+
+    // Al igual que el de reinicio en caliente, la dirección queda libre cuando la instancia saliente la cierra
+    for (int retries = 0; bind(fd, (struct sockaddr *)&addr, len) == -1; retries++)
+    {
+        if ((errno != EADDRINUSE) || (retries == 200))
+        {
+            close(fd);
+
+            return -1;
+        }
+
+        usleep(10000);
+    }
+
+    if (listen(fd, 5) == -1)
+    {
+        close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Esta función cuenta las conexiones en curso atendidas por
+ *        hilos handler.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ *
+ * @return La cantidad de conexiones.
+ */
+static int ctl_threaded(struct_data *sd)
+{
+    int n = 0;
+
+    for (int i = 0; i < _MAX_CONNS_; i++)
+        if ((__atomic_load_n(&sd->conns[i].pid, __ATOMIC_ACQUIRE) != 0) && sd->conns[i].threaded)
+            n++;
+
+    return n;
+}
+
+/**
+ * @brief Esta función interpreta un número positivo (o cero, si se
+ *        admite) recibido como argumento de un comando.
+ *
+ * @param arg Argumento a interpretar.
+ * @param min Valor mínimo admitido.
+ *
+ * @return El número, o -1 si el argumento es inválido.
+ */
+static long int ctl_number(char *arg, long int min)
+{
+    if (!arg || (*arg == '\0'))
+        return -1;
+
+    char *end;
+
+    errno = 0;
+
+    long int value = strtol(arg, &end, 10);
+
+    if ((errno != 0) || (*end != '\0') || (value < min))
+        return -1;
+
+    return value;
+}
+
+/**
+ * @brief Esta función ejecuta un comando de control y escribe la respuesta.
+ *
+ * @details Los cambios de configuración se publican con stats_cfg_commit:
+ *          los handlers los toman en su siguiente lectura, sin reiniciar
+ *          ni cortar ninguna conexión.
+ *
+ * @param sv Estado del proceso principal del servidor.
+ * @param argc Cantidad de palabras del comando.
+ * @param argv Palabras del comando.
+ * @param out Flujo de la respuesta.
+ */
+static void ctl_exec(struct_server *sv, int argc, char *argv[], FILE *out)
+{
+    struct_data *sd = sv->sd;
+
+    char *cmd = argv[0];
+
+    long int value;
+
+    if (strcmp(cmd, "help") == 0)
+        fprintf(out, "OK commands: interval SECONDS | readsize BYTES | rcvbuf BYTES | rate local|ipv4|ipv6|all BYTES_PER_SEC |"
+                     " protorate local|ipv4|ipv6|all BYTES_PER_SEC | global BYTES_PER_SEC | weight local|ipv4|ipv6 WEIGHT |"
+                     " maxconns local|ipv4|ipv6|all N | maxtotal N | minfree BYTES | overload reject|defer [MS] |"
+                     " handlers process|thread [STACK_KB] | trace on|off | loglevel debug|info|warn|error | pause | resume | listen PROTO PATH|[ADDR:]PORT | unlisten PROTO PATH|[ADDR:]PORT | listeners | endpoints | config | dump\n");
+    else if ((strcmp(cmd, "interval") == 0) && (argc == 2) && ((value = ctl_number(argv[1], 1)) != -1))
+    {
+        sd->cfg.log_interval = (unsigned int)value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK interval %ld\n", value);
+    }
+    else if ((strcmp(cmd, "readsize") == 0) && (argc == 2) && ((value = ctl_number(argv[1], 1)) != -1) && (value < _MAX_BUFF_SIZE_))
+    {
+        sd->cfg.read_size = (int)value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK readsize %ld\n", value);
+    }
+    else if ((strcmp(cmd, "rcvbuf") == 0) && (argc == 2) && ((value = ctl_number(argv[1], 0)) != -1) && (value <= INT_MAX))
+    {
+        sd->cfg.rcvbuf = (int)value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK rcvbuf %ld (applies to the next read of each connection)\n", value);
+    }
+    else if ((strcmp(cmd, "rate") == 0) && (argc == 3) && ((value = ctl_number(argv[2], 0)) != -1) &&
+             ((strcmp(argv[1], "all") == 0) || (proto_parse(argv[1]) != -1)))
+    {
+        for (int i = 0; i < _PROTOS_; i++)
+            if ((strcmp(argv[1], "all") == 0) || (i == proto_parse(argv[1])))
+                sd->cfg.rate_cap[i] = value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK rate %s %ld\n", argv[1], value);
+    }
+    else if ((strcmp(cmd, "protorate") == 0) && (argc == 3) && ((value = ctl_number(argv[2], 0)) != -1) &&
+             ((strcmp(argv[1], "all") == 0) || (proto_parse(argv[1]) != -1)))
+    {
+        for (int i = 0; i < _PROTOS_; i++)
+            if ((strcmp(argv[1], "all") == 0) || (i == proto_parse(argv[1])))
+                sd->cfg.proto_cap[i] = value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK protorate %s %ld\n", argv[1], value);
+    }
+    else if ((strcmp(cmd, "global") == 0) && (argc == 2) && ((value = ctl_number(argv[1], 0)) != -1))
+    {
+        sd->cfg.global_cap = value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK global %ld\n", value);
+    }
+    else if ((strcmp(cmd, "weight") == 0) && (argc == 3) && (proto_parse(argv[1]) != -1) &&
+             ((value = ctl_number(argv[2], 1)) != -1) && (value <= 1000))
+    {
+        sd->cfg.weight[proto_parse(argv[1])] = (int)value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK weight %s %ld\n", argv[1], value);
+    }
+    else if ((strcmp(cmd, "maxconns") == 0) && (argc == 3) && ((value = ctl_number(argv[2], 0)) != -1) && (value <= INT_MAX) &&
+             ((strcmp(argv[1], "all") == 0) || (proto_parse(argv[1]) != -1)))
+    {
+        for (int i = 0; i < _PROTOS_; i++)
+            if ((strcmp(argv[1], "all") == 0) || (i == proto_parse(argv[1])))
+                sd->cfg.max_conns[i] = (int)value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK maxconns %s %ld\n", argv[1], value);
+    }
+    else if ((strcmp(cmd, "maxtotal") == 0) && (argc == 2) && ((value = ctl_number(argv[1], 0)) != -1) && (value <= INT_MAX))
+    {
+        sd->cfg.max_total = (int)value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK maxtotal %ld\n", value);
+    }
+    else if ((strcmp(cmd, "minfree") == 0) && (argc == 2) && ((value = ctl_number(argv[1], 0)) != -1))
+    {
+        sd->cfg.min_free_mem = value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK minfree %ld (available now: %ld)\n", value, mem_available());
+    }
+    else if ((strcmp(cmd, "overload") == 0) && ((argc == 2) || (argc == 3)) &&
+             ((strcmp(argv[1], "reject") == 0) || (strcmp(argv[1], "defer") == 0)) &&
+             ((argc == 2) || (((value = ctl_number(argv[2], 1)) != -1) && (value <= 60000))))
+    {
+        sd->cfg.overload = (strcmp(argv[1], "defer") == 0) ? _OVERLOAD_DEFER_ : _OVERLOAD_REJECT_;
+
+        if (argc == 3)
+            sd->cfg.defer_ms = (int)value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK overload %s (defer up to %dms)\n", argv[1], admit_defer_ms(&sd->cfg));
+    }
+    else if ((strcmp(cmd, "handlers") == 0) && ((argc == 2) || (argc == 3)) && (handler_mode_parse(argv[1]) != -1) &&
+             ((argc == 2) || (((value = ctl_number(argv[2], _THREAD_STACK_MIN_KB_)) != -1) && (value <= _THREAD_STACK_MAX_KB_))))
+    {
+        int mode = handler_mode_parse(argv[1]);
+
+        int threaded = (mode == _HANDLER_PROCESS_) ? ctl_threaded(sd) : 0;
+
+        // Un listener no puede crear procesos mientras tenga otros hilos: el hijo heredaría sus locks tomados
+        if (threaded > 0)
+        {
+            fprintf(out, "ERR %d connections are still served by handler threads, retry once they finish\n", threaded);
+
+            return;
+        }
+
+        // Sólo afecta a las conexiones nuevas: las que están en curso conservan su handler
+        sd->cfg.handler_mode = mode;
+
+        if (argc == 3)
+            sd->cfg.thread_stack = (int)value;
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK handlers %s (thread stack %dKB)\n", argv[1], thread_stack_kb(&sd->cfg));
+    }
+    else if ((strcmp(cmd, "trace") == 0) && (argc == 2) && ((strcmp(argv[1], "on") == 0) || (strcmp(argv[1], "off") == 0)))
+    {
+        sd->cfg.trace = (strcmp(argv[1], "on") == 0);
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK trace %s\n", argv[1]);
+    }
+    else if ((strcmp(cmd, "loglevel") == 0) && (argc == 2) && (evlog_parse_level(argv[1]) != -1))
+    {
+        sd->cfg.log_level = evlog_parse_level(argv[1]);
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK loglevel %s\n", argv[1]);
+    }
+    else if (((strcmp(cmd, "pause") == 0) || (strcmp(cmd, "resume") == 0)) && (argc == 1))
+    {
+        sd->cfg.paused = (strcmp(cmd, "pause") == 0);
+
+        stats_cfg_commit(sd);
+
+        fprintf(out, "OK %s\n", sd->cfg.paused ? "paused" : "resumed");
+    }
+    else if ((strcmp(cmd, "listen") == 0) && (argc == 3) && (proto_parse(argv[1]) != -1))
+    {
+        if (add_listener(sv, proto_parse(argv[1]), argv[2]) == -1)
+            fprintf(out, "ERR could not listen on %s %s\n", argv[1], argv[2]);
+        else
+            fprintf(out, "OK listening on %s %s\n", argv[1], argv[2]);
+    }
+    else if ((strcmp(cmd, "unlisten") == 0) && (argc == 3) && (proto_parse(argv[1]) != -1))
+    {
+        if (remove_listener(sv, proto_parse(argv[1]), argv[2]) == -1)
+            fprintf(out, "ERR no listener on %s %s\n", argv[1], argv[2]);
+        else
+            fprintf(out, "OK stopped listening on %s %s\n", argv[1], argv[2]);
+    }
+    else if ((strcmp(cmd, "listeners") == 0) && (argc == 1))
+    {
+        fprintf(out, "OK %d listeners\n", sv->n_ls);
+
+        for (int i = 0; i < sv->n_ls; i++)
+            fprintf(out, "%s %s pid=%d%s\n", proto_name(sv->ls[i].proto), listener_desc(sv->ls[i].fd), sv->ls[i].pid,
+                    sv->ls[i].primary ? "" : " (runtime)");
+    }
+    else if ((strcmp(cmd, "endpoints") == 0) && (argc == 1))
+    {
+        int n = 0;
+
+        for (int i = 0; i < _MAX_ENDPOINTS_; i++)
+            n += (sd->endpoints[i].name[0] != '\0');
+
+        fprintf(out, "OK %d endpoints\n", n);
+
+        // También los quitados: conservan sus contadores, y sus handlers pueden seguir atendiendo clientes
+        for (int i = 0; i < _MAX_ENDPOINTS_; i++)
+        {
+            struct_endpoint *ep = &sd->endpoints[i];
+
+            if (ep->name[0] == '\0')
+                continue;
+
+            fprintf(out, "%s %s bytes=%ld accepts=%ld shed=%ld connections=%d%s\n", proto_name(ep->proto), ep->name, stats_read(&ep->bytes),
+                    stats_read(&ep->accepts), stats_read(&ep->shed), stats_endpoint_conns(sd, i),
+                    __atomic_load_n(&ep->active, __ATOMIC_ACQUIRE) ? "" : " (removed)");
+        }
+    }
+    else if ((strcmp(cmd, "config") == 0) && (argc == 1))
+    {
+        fprintf(out, "OK generation=%u interval=%u paused=%d readsize=%d rcvbuf=%d global=%ld trace=%d loglevel=%s maxtotal=%d minfree=%ld overload=%s defer=%dms handlers=%s stack=%dKB\n",
+                sd->cfg.generation, sd->cfg.log_interval, sd->cfg.paused, sd->cfg.read_size, sd->cfg.rcvbuf, sd->cfg.global_cap, sd->cfg.trace,
+                evlog_level_name(evlog_level(&sd->cfg)), sd->cfg.max_total, sd->cfg.min_free_mem, overload_name(sd->cfg.overload), admit_defer_ms(&sd->cfg),
+                handler_mode_name(sd->cfg.handler_mode), thread_stack_kb(&sd->cfg));
+
+        for (int i = 0; i < _PROTOS_; i++)
+            fprintf(out, "%s rate=%ld protorate=%ld weight=%d maxconns=%d admitted=%ld\n", proto_name(i), sd->cfg.rate_cap[i], sd->cfg.proto_cap[i],
+                    sd->cfg.weight[i], sd->cfg.max_conns[i], stats_read(&sd->admitted[i]));
+    }
+    else if ((strcmp(cmd, "dump") == 0) && (argc == 1))
+    {
+        fprintf(out, "OK %d active connections\n", stats_conn_sweep(sd, NULL));
+
+        long int now = now_ns();
+
+        for (int i = 0; i < _MAX_CONNS_; i++)
+        {
+            struct_conn *conn = &sd->conns[i];
+
+            if (__atomic_load_n(&conn->pid, __ATOMIC_ACQUIRE) == 0)
+                continue;
+
+            fprintf(out, "pid=%d proto=%s peer=%s bytes=%ld age=%.1fs throttled=%.1fs channels=%d", conn->pid, proto_name(conn->proto),
+                    conn->peer, stats_read(&conn->bytes), (double)(now - conn->start_ns) / 1e9, (double)stats_read(&conn->throttled_ns) / 1e9,
+                    conn->channels);
+
+            if (conn->compressed)
+                fprintf(out, " decompressed=%ld", stats_read(&conn->raw_bytes));
+
+            fprintf(out, " handler=%s", conn->threaded ? "thread" : "process");
+
+            int ep = __atomic_load_n(&conn->endpoint, __ATOMIC_RELAXED);
+
+            if ((ep >= 0) && (ep < _MAX_ENDPOINTS_))
+                fprintf(out, " endpoint=%s", sd->endpoints[ep].name);
+
+            // Memoria residente propia del handler, si ya la midió
+            int rss_kb = __atomic_load_n(&conn->rss_kb, __ATOMIC_RELAXED);
+
+            if (rss_kb > 0)
+                fprintf(out, " rss=%dKB", rss_kb);
+
+            // Última muestra de TCP_INFO, si ya se tomó alguna
+            int rtt = __atomic_load_n(&conn->rcv_rtt_us, __ATOMIC_RELAXED);
+
+            if ((conn->proto != _PROTO_LOCAL_) && (rtt > 0))
+                fprintf(out, " rtt=%.3fms rcvwnd=%dKB inq=%dKB ooo=%ld", (double)rtt / 1e3, __atomic_load_n(&conn->rcv_space, __ATOMIC_RELAXED) / 1024,
+                        __atomic_load_n(&conn->inq, __ATOMIC_RELAXED) / 1024, stats_read(&conn->ooo_pkts));
+
+            fprintf(out, "\n");
+
+            for (int j = 0; (j < _MAX_CHANS_) && (conn->channels > 0); j++)
+                if (__atomic_load_n(&sd->chans[j].pid, __ATOMIC_ACQUIRE) == conn->pid)
+                    fprintf(out, "  channel=%d bytes=%ld\n", sd->chans[j].channel, stats_read(&sd->chans[j].bytes));
+        }
+    }
+    else
+        fprintf(out, "ERR invalid command, try 'help'\n");
+}
+
+/**
+ * @brief Esta función atiende una conexión pendiente en el socket de
+ *        control: lee un comando (una línea), lo ejecuta y responde.
+ *
+ * @details Se atiende desde el bucle del proceso principal, entre
+ *          escrituras del log. Las esperas tienen un límite breve,
+ *          para que un cliente lento no demore al logger. Los comandos
+ *          de otros usuarios (salvo root) se rechazan sin leerlos.
+ *
+ * @param sv Estado del proceso principal del servidor.
+ */
+void control_handle(struct_server *sv)
+{
+    int conn = accept(sv->cfd, NULL, NULL);
+
+    if (conn == -1)
+        return;
+
+    if (!instance_peer_ok(conn))
+    {
+        send(conn, "ERR permission denied\n", 22, (MSG_NOSIGNAL | MSG_DONTWAIT));
+
+        close(conn);
+
+        return;
+    }
+
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = _CTL_TIMEOUT_MS_ * 1000};
+
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char line[_CTL_LINE_LEN_];
+
+    size_t len = 0;
+
+    // Se lee hasta el fin de línea, el cierre de la escritura del cliente o el tiempo límite
+    while (len < (sizeof(line) - 1))
+    {
+        ssize_t aux = read(conn, line + len, sizeof(line) - 1 - len);
+
+        if (aux <= 0)
+            break;
+
+        len += (size_t)aux;
+
+        if (memchr(line, '\n', len))
+            break;
+    }
+
+    line[len] = '\0';
+
+    /*
+     * La respuesta se arma en memoria y se envía al final: si el comando crea
+     * un listener, el proceso hijo no debe heredar la conexión (ni datos
+     * pendientes de escritura), o el cliente no recibiría el fin de la respuesta.
+     */
+    char *reply = NULL;
+
+    size_t reply_len = 0;
+
+    FILE *out = open_memstream(&reply, &reply_len);
+
+    if (!out)
+    {
+        close(conn);
+
+        return;
+    }
+
+    char *argv[4];
+    char *save;
+
+    int argc = 0;
+
+    for (char *word = strtok_r(line, " \t\r\n", &save); word && (argc < 4); word = strtok_r(NULL, " \t\r\n", &save))
+        argv[argc++] = word;
+
+    sv->cconn = conn;
+
+    if (argc == 0)
+        fprintf(out, "ERR empty command, try 'help'\n");
+    else
+        ctl_exec(sv, argc, argv, out);
+
+    sv->cconn = -1;
+
+    fclose(out);
+
+    if (write(conn, reply, reply_len) != (ssize_t)reply_len)
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed sending control reply");
+
+    free(reply);
+
+    close(conn);
+}
@@ -0,0 +1,710 @@
+/**
+ * @file evlog.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones del registro asíncrono de eventos
+ *        (JSON lines) de los procesos del servidor para el TP #1 de
+ *        Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-24
+ */
+
+#include "../headers/servers_setup.h"
+
+// Segmento de la instancia y estadísticas (para el nivel vigente), heredados por los procesos hijos
+static struct_evlog *evlog_shm = NULL;
+static struct_data *evlog_sd = NULL;
+
+// Bandera que indica que el escritor debe vaciar la cola y terminar
+static volatile sig_atomic_t evlog_exit = 0;
+
+/**
+ * @brief Esta función arma el nombre del segmento de eventos de
+ *        una instancia.
+ *
+ * @param instance Nombre de la instancia.
+ * @param name Buffer donde se almacenará el nombre del segmento.
+ * @param len Tamaño del buffer.
+ */
+static void evlog_shm_name(char *instance, char *name, size_t len)
+{
+    if (snprintf(name, len, "/%s%s", _EVLOG_PREFIX_, instance) < 0)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed building event log shared memory name");
+}
+
+/**
+ * @brief Esta función calcula el grupo de mensajes repetidos al que
+ *        pertenece un evento (FNV-1a del nombre y de la clave).
+ *
+ * @param event Nombre del evento.
+ * @param key Clave del mensaje (su formato, o el texto de un error).
+ *
+ * @return El índice del grupo.
+ */
+static unsigned int evlog_key(const char *event, const char *key)
+{
+    unsigned int h = 2166136261u;
+
+    for (const char *p = event; *p; p++)
+        h = (h ^ (unsigned char)*p) * 16777619u;
+
+    for (const char *p = key; *p; p++)
+        h = (h ^ (unsigned char)*p) * 16777619u;
+
+    return h % _EVLOG_KEYS_;
+}
+
+/**
+ * @brief Esta función decide si un mensaje supera el límite de
+ *        mensajes repetidos de su grupo.
+ *
+ * @details El límite es compartido por todos los procesos de la
+ *          instancia: una ráfaga de conexiones genera un evento por
+ *          handler, cada uno en un proceso distinto. Los mensajes
+ *          descartados se informan en el siguiente que pase el límite.
+ *
+ * @param key Grupo del mensaje.
+ * @param suppressed Puntero donde se almacenará la cantidad de mensajes
+ *                   del grupo descartados desde el último publicado.
+ *
+ * @return 1 Si el mensaje debe publicarse.
+ *         0 Si se descartó.
+ */
+static int evlog_allow(unsigned int key, unsigned int *suppressed)
+{
+    struct_evlog_limit *lim = &evlog_shm->limits[key];
+
+    long int interval = 1000000000L / _EVLOG_RATE_;
+    long int tau = interval * (_EVLOG_BURST_ - 1);
+    long int now = now_ns();
+
+    long int tat = __atomic_load_n(&lim->tat, __ATOMIC_RELAXED);
+    long int next;
+
+    do
+    {
+        if ((tat - tau) > now)
+        {
+            __atomic_add_fetch(&lim->suppressed, 1, __ATOMIC_RELAXED);
+
+            return 0;
+        }
+
+        next = ((tat > now) ? tat : now) + interval;
+    } while (!__atomic_compare_exchange_n(&lim->tat, &tat, next, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    *suppressed = __atomic_exchange_n(&lim->suppressed, 0, __ATOMIC_RELAXED);
+
+    return 1;
+}
+
+/**
+ * @brief Esta función encola un evento.
+ *
+ * @details La posición se reserva con un CAS sobre 'head' y el evento se
+ *          publica actualizando el número de secuencia de la posición.
+ *          Si la cola está llena, el evento se descarta: el productor
+ *          nunca espera al escritor. Si un productor muere entre ambos
+ *          pasos, el escritor se detiene en esa posición y los eventos
+ *          siguientes se descartan por cola llena, pero ningún proceso
+ *          que acepta o atiende conexiones se bloquea.
+ *
+ * @param q Puntero al segmento de eventos.
+ * @param rec Evento a encolar.
+ *
+ * @return 0 Si el evento se encoló.
+ *        -1 Si la cola estaba llena.
+ */
+static int evlog_push(struct_evlog *q, struct_evlog_rec *rec)
+{
+    unsigned long int pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+
+    struct_evlog_slot *slot;
+
+    while (1)
+    {
+        slot = &q->slots[pos & (_EVLOG_SLOTS_ - 1)];
+
+        long int dif = (long int)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (dif == 0)
+        {
+            if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (dif < 0)
+        {
+            __atomic_add_fetch(&q->dropped, 1, __ATOMIC_RELAXED);
+
+            return -1;
+        }
+        else
+            pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    }
+
+    memcpy(&slot->rec, rec, sizeof(*rec));
+
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief Esta función desencola un evento (sólo la usa el escritor).
+ *
+ * @param q Puntero al segmento de eventos.
+ * @param rec Puntero donde se almacenará el evento.
+ *
+ * @return 1 Si se desencoló un evento.
+ *         0 Si la cola está vacía.
+ */
+static int evlog_pop(struct_evlog *q, struct_evlog_rec *rec)
+{
+    unsigned long int pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+
+    struct_evlog_slot *slot = &q->slots[pos & (_EVLOG_SLOTS_ - 1)];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != (pos + 1))
+        return 0;
+
+    memcpy(rec, &slot->rec, sizeof(*rec));
+
+    __atomic_store_n(&slot->seq, pos + _EVLOG_SLOTS_, __ATOMIC_RELEASE);
+    __atomic_store_n(&q->tail, pos + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+/**
+ * @brief Esta función escribe un evento como una línea JSON.
+ *
+ * @param rec Evento a escribir.
+ * @param line Buffer donde se almacenará la línea.
+ * @param len Tamaño del buffer (al menos 8 veces _EVLOG_MSG_LEN_).
+ *
+ * @return El largo de la línea.
+ */
+static size_t evlog_format(struct_evlog_rec *rec, char *line, size_t len)
+{
+    char ts[32];
+
+    time_t secs = (time_t)(rec->ts / 1000000000L);
+
+    struct tm tm;
+
+    gmtime_r(&secs, &tm);
+
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    // El mensaje se escapa: los textos de error pueden contener comillas o caracteres de control
+    char msg[_EVLOG_MSG_LEN_ * 6];
+
+    size_t m = 0;
+
+    for (const unsigned char *p = (const unsigned char *)rec->msg; *p && (m < (sizeof(msg) - 7)); p++)
+    {
+        if ((*p == '"') || (*p == '\\'))
+        {
+            msg[m++] = '\\';
+            msg[m++] = (char)*p;
+        }
+        else if (*p < 0x20)
+            m += (size_t)snprintf(msg + m, sizeof(msg) - m, "\\u%04x", *p);
+        else
+            msg[m++] = (char)*p;
+    }
+
+    msg[m] = '\0';
+
+    int n = snprintf(line, len, "{\"ts\":\"%s.%06ldZ\",\"level\":\"%s\",\"pid\":%d,\"event\":\"%s\"",
+                     ts, (rec->ts % 1000000000L) / 1000, evlog_level_name(rec->level), rec->pid, rec->event);
+
+    if (rec->proto >= 0)
+        n += snprintf(line + n, len - (size_t)n, ",\"proto\":\"%s\"", proto_name(rec->proto));
+
+    n += snprintf(line + n, len - (size_t)n, ",\"msg\":\"%s\"", msg);
+
+    if (rec->suppressed > 0)
+        n += snprintf(line + n, len - (size_t)n, ",\"suppressed\":%u", rec->suppressed);
+
+    n += snprintf(line + n, len - (size_t)n, "}\n");
+
+    return (size_t)n;
+}
+
+/**
+ * @brief Esta función completa los datos comunes de un evento.
+ *
+ * @param rec Evento, con el mensaje ya cargado.
+ * @param level Nivel del evento.
+ * @param pid ID del proceso que genera el evento.
+ * @param event Nombre del evento.
+ * @param proto Protocolo del evento (-1 si no corresponde).
+ */
+static void evlog_fill(struct_evlog_rec *rec, int level, int pid, char *event, int proto)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    rec->ts = (now.tv_sec * 1000000000L) + now.tv_nsec;
+    rec->pid = pid;
+    rec->level = level;
+    rec->proto = proto;
+
+    strncpy(rec->event, event, (_EVLOG_EVENT_LEN_ - 1));
+    rec->event[_EVLOG_EVENT_LEN_ - 1] = '\0';
+}
+
+/**
+ * @brief Esta función completa un evento y lo encola.
+ *
+ * @details Sin segmento de eventos (por ejemplo, si no pudo crearse),
+ *          el evento se escribe directamente en stdout.
+ *
+ * @param rec Evento, con el mensaje y los mensajes descartados ya cargados.
+ * @param level Nivel del evento.
+ * @param pid ID del proceso que genera el evento.
+ * @param event Nombre del evento.
+ * @param proto Protocolo del evento (-1 si no corresponde).
+ */
+static void evlog_submit(struct_evlog_rec *rec, int level, int pid, char *event, int proto)
+{
+    evlog_fill(rec, level, pid, event, proto);
+
+    if (evlog_shm)
+    {
+        evlog_push(evlog_shm, rec);
+
+        return;
+    }
+
+    char line[_EVLOG_MSG_LEN_ * 8];
+
+    evlog_format(rec, line, sizeof(line));
+
+    fputs(line, stdout);
+}
+
+/**
+ * @brief Esta función devuelve el nivel mínimo de los eventos que se
+ *        registran en este proceso.
+ *
+ * @return El nivel vigente.
+ */
+static inline int evlog_min_level(void)
+{
+    if (!evlog_sd)
+        return _EVLOG_INFO_;
+
+    int level = __atomic_load_n(&evlog_sd->cfg.log_level, __ATOMIC_RELAXED);
+
+    return (level > 0) ? level : _EVLOG_INFO_;
+}
+
+/**
+ * @brief Esta función registra un error no fatal informado mediante
+ *        show_err (ver utilities.h).
+ *
+ * @param pid ID del proceso que informa el error.
+ * @param source Fuente del error (no se usa: el registro es del servidor).
+ * @param msg Mensaje de error.
+ */
+static void evlog_err(int pid, int source, char *msg)
+{
+    (void)source;
+
+    struct_evlog_rec rec;
+
+    rec.suppressed = 0;
+
+    if (evlog_shm && !evlog_allow(evlog_key("error", msg), &rec.suppressed))
+        return;
+
+    strncpy(rec.msg, msg, (_EVLOG_MSG_LEN_ - 1));
+    rec.msg[_EVLOG_MSG_LEN_ - 1] = '\0';
+
+    evlog_submit(&rec, _EVLOG_ERROR_, pid, "error", -1);
+}
+
+/**
+ * @brief Esta función crea el segmento de eventos de una instancia y
+ *        redirige a él los errores no fatales de los procesos del
+ *        servidor.
+ *
+ * @details En un reinicio en caliente se reutiliza el segmento de la
+ *          instancia saliente, cuyos handlers siguen encolando eventos:
+ *          los escribe el escritor de la nueva instancia.
+ *
+ * @param instance Nombre de la instancia.
+ * @param sd Puntero a la estructura de estadísticas (nivel vigente).
+ * @param reuse Si es distinto de cero, se conserva la cola existente.
+ *
+ * @return Puntero al segmento, o NULL si no pudo crearse (los eventos
+ *         se escriben entonces directamente en stdout).
+ */
+struct_evlog *evlog_open(char *instance, struct_data *sd, int reuse)
+{
+    char name[_INSTANCE_LEN_ + sizeof(_EVLOG_PREFIX_) + 1];
+
+    evlog_shm_name(instance, name, sizeof(name));
+
+    evlog_sd = sd;
+
+    int fd = shm_open(name, (O_CREAT | O_RDWR), 0644);
+
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+
+    reuse = reuse && (fstat(fd, &st) == 0) && ((size_t)st.st_size == sizeof(struct_evlog));
+
+    if (!reuse && ((ftruncate(fd, 0) == -1) || (ftruncate(fd, sizeof(struct_evlog)) == -1)))
+    {
+        close(fd);
+
+        return NULL;
+    }
+
+    struct_evlog *q = mmap(NULL, sizeof(struct_evlog), (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (q == MAP_FAILED)
+        return NULL;
+
+    if (!reuse || (q->magic != _EVLOG_MAGIC_) || (q->version != _EVLOG_VERSION_))
+    {
+        memset(q, 0, offsetof(struct_evlog, slots));
+
+        for (unsigned long int i = 0; i < _EVLOG_SLOTS_; i++)
+            q->slots[i].seq = i;
+
+        q->version = _EVLOG_VERSION_;
+
+        __atomic_store_n(&q->magic, _EVLOG_MAGIC_, __ATOMIC_RELEASE);
+    }
+
+    evlog_shm = q;
+
+    show_err_hook = evlog_err;
+
+    return q;
+}
+
+/**
+ * @brief Esta función elimina el segmento de eventos de una instancia.
+ *
+ * @param instance Nombre de la instancia.
+ */
+void evlog_destroy(char *instance)
+{
+    char name[_INSTANCE_LEN_ + sizeof(_EVLOG_PREFIX_) + 1];
+
+    evlog_shm_name(instance, name, sizeof(name));
+
+    shm_unlink(name);
+}
+
+/**
+ * @brief Esta función registra un evento.
+ *
+ * @details El costo para el proceso que lo genera es el de formatear
+ *          el mensaje y copiarlo a la cola: la escritura la hace el
+ *          escritor, de modo que una terminal lenta o un pipe lleno no
+ *          frenan la aceptación ni la atención de conexiones. Los
+ *          mensajes repetidos (mismo evento y formato) se limitan a
+ *          _EVLOG_RATE_ por segundo.
+ *
+ * @param level Nivel del evento.
+ * @param event Nombre del evento.
+ * @param proto Protocolo del evento (-1 si no corresponde).
+ * @param fmt Formato del mensaje (como printf).
+ */
+void evlog(int level, char *event, int proto, const char *fmt, ...)
+{
+    if (level < evlog_min_level())
+        return;
+
+    struct_evlog_rec rec;
+
+    rec.suppressed = 0;
+
+    if (evlog_shm && !evlog_allow(evlog_key(event, fmt), &rec.suppressed))
+        return;
+
+    va_list ap;
+
+    va_start(ap, fmt);
+
+    vsnprintf(rec.msg, sizeof(rec.msg), fmt, ap);
+
+    va_end(ap);
+
+    evlog_submit(&rec, level, (int)gettid(), event, proto);
+}
+
+/**
+ * @brief Handler para señales SIGINT y SIGTERM del escritor.
+ *
+ * @param signal Señal recibida.
+ */
+static void evlog_handler(int signal)
+{
+    (void)signal;
+
+    evlog_exit = 1;
+}
+
+/**
+ * @brief Esta función escribe un bloque de líneas en la salida del
+ *        escritor.
+ *
+ * @param fd Descriptor de la salida.
+ * @param buf Líneas a escribir.
+ * @param len Cantidad de bytes.
+ */
+static void evlog_flush(int fd, char *buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        ssize_t n = write(fd, buf + done, len - done);
+
+        if ((n == -1) && (errno == EINTR))
+            continue;
+
+        // Si la salida se cerró, los eventos se descartan pero la cola se sigue vaciando
+        if (n <= 0)
+            return;
+
+        done += (size_t)n;
+    }
+}
+
+/**
+ * @brief Esta función agrega un evento, como línea JSON, al bloque
+ *        pendiente de escritura (que se escribe antes si está lleno).
+ *
+ * @param fd Descriptor de la salida.
+ * @param buf Bloque pendiente.
+ * @param size Tamaño del bloque.
+ * @param used Puntero a la cantidad de bytes pendientes.
+ * @param rec Evento a agregar.
+ */
+static void evlog_append(int fd, char *buf, size_t size, size_t *used, struct_evlog_rec *rec)
+{
+    char line[_EVLOG_MSG_LEN_ * 8];
+
+    size_t len = evlog_format(rec, line, sizeof(line));
+
+    if ((*used + len) > size)
+    {
+        evlog_flush(fd, buf, *used);
+
+        *used = 0;
+    }
+
+    memcpy(buf + *used, line, len);
+
+    *used += len;
+}
+
+/**
+ * @brief Esta función vacía la cola de eventos en forma continua.
+ *
+ * @details Sólo un escritor puede vaciar la cola: durante un reinicio en
+ *          caliente, el de la nueva instancia espera a que termine el de
+ *          la saliente. Los eventos se escriben en bloques y, si hubo
+ *          eventos descartados por cola llena, se informa cuántos. Al
+ *          recibir SIGTERM, se termina de vaciar la cola antes de salir.
+ *
+ * @param q Puntero al segmento de eventos.
+ * @param fd Descriptor de la salida.
+ */
+static void run_evlog(struct_evlog *q, int fd)
+{
+    int me = getpid();
+
+    struct timespec idle = {0, _EVLOG_IDLE_NS_};
+
+    while (1)
+    {
+        int owner = 0;
+
+        if (__atomic_compare_exchange_n(&q->consumer, &owner, me, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            break;
+
+        // Si el dueño murió sin liberar la cola, se la toma
+        if ((kill(owner, 0) == -1) && (errno == ESRCH))
+            __atomic_compare_exchange_n(&q->consumer, &owner, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        else if (evlog_exit)
+            exit(EXIT_SUCCESS);
+        else
+            nanosleep(&idle, NULL);
+    }
+
+    unsigned long int reported = __atomic_load_n(&q->dropped, __ATOMIC_RELAXED);
+
+    char buf[65536];
+
+    size_t used = 0;
+
+    struct_evlog_rec rec;
+
+    while (1)
+    {
+        int n = 0;
+
+        while (evlog_pop(q, &rec))
+        {
+            evlog_append(fd, buf, sizeof(buf), &used, &rec);
+
+            n++;
+        }
+
+        unsigned long int dropped = __atomic_load_n(&q->dropped, __ATOMIC_RELAXED);
+
+        if (dropped != reported)
+        {
+            rec.suppressed = 0;
+
+            snprintf(rec.msg, sizeof(rec.msg), "%lu events dropped, event queue full", dropped - reported);
+
+            evlog_fill(&rec, _EVLOG_WARN_, me, "dropped", -1);
+
+            evlog_append(fd, buf, sizeof(buf), &used, &rec);
+
+            reported = dropped;
+        }
+
+        if (used > 0)
+        {
+            evlog_flush(fd, buf, used);
+
+            used = 0;
+        }
+
+        if (n > 0)
+            continue;
+
+        if (evlog_exit)
+            break;
+
+        nanosleep(&idle, NULL);
+    }
+
+    __atomic_store_n(&q->consumer, 0, __ATOMIC_RELEASE);
+
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * @brief Se crea el proceso escritor del registro de eventos.
+ *
+ * @param sv Estado del proceso principal del servidor.
+ * @param path Archivo donde se agregan los eventos (NULL: stdout).
+ *
+ * @return El PID del proceso creado.
+ */
+int spawn_evlog(struct_server *sv, char *path)
+{
+    fflush(stdout);
+
+    int pid = fork();
+
+    if (pid == -1)
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on process forking for event log writer");
+
+    if (pid == 0)
+    {
+        for (int i = 0; i < sv->n_ls; i++)
+            close(sv->ls[i].fd);
+
+        if (sv->hfd != -1)
+            close(sv->hfd);
+
+        if (sv->cfd != -1)
+            close(sv->cfd);
+
+        // Los errores del escritor no pueden pasar por su propia cola
+        show_err_hook = NULL;
+
+        struct sigaction sa;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = evlog_handler;
+
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        // El escritor comparte las CPUs del logger, lejos de los handlers
+        pin_to_cpus(&sv->aff, &sv->aff.logger_cpus);
+
+        int fd = STDOUT_FILENO;
+
+        if (path && ((fd = open(path, (O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC), 0644)) == -1))
+        {
+            show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed opening event log file, writing events to stdout");
+
+            fd = STDOUT_FILENO;
+        }
+
+        run_evlog(evlog_shm, fd);
+    }
+
+    return pid;
+}
+
+/**
+ * @brief Esta función devuelve el nivel mínimo vigente de los eventos.
+ *
+ * @param cfg Configuración vigente.
+ *
+ * @return El nivel mínimo.
+ */
+int evlog_level(struct_sv_config *cfg)
+{
+    return (cfg->log_level > 0) ? cfg->log_level : _EVLOG_INFO_;
+}
+
+/**
+ * @brief Esta función interpreta el nombre de un nivel.
+ *
+ * @param name Nombre del nivel.
+ *
+ * @return El nivel, o -1 si el nombre es inválido.
+ */
+int evlog_parse_level(char *name)
+{
+    for (int i = _EVLOG_DEBUG_; i <= _EVLOG_ERROR_; i++)
+        if (strcmp(name, evlog_level_name(i)) == 0)
+            return i;
+
+    return -1;
+}
+
+/**
+ * @brief Esta función devuelve el nombre de un nivel.
+ *
+ * @param level Nivel.
+ *
+ * @return El nombre del nivel.
+ */
+char *evlog_level_name(int level)
+{
+    switch (level)
+    {
+    case _EVLOG_DEBUG_:
+        return "debug";
+    case _EVLOG_INFO_:
+        return "info";
+    case _EVLOG_WARN_:
+        return "warn";
+    case _EVLOG_ERROR_:
+        return "error";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,198 @@
+/**
+ * @file handoff.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de reinicio en caliente (traspaso
+ *        de sockets de escucha entre instancias del servidor) para
+ *        el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-09
+ */
+
+#include "../headers/handoff.h"
+
+/**
+ * @brief Esta función crea el socket por el que una instancia
+ *        atiende pedidos de reinicio en caliente.
+ *
+ * @details Mientras la instancia saliente no cierre su socket, la
+ *          dirección está ocupada, así que se reintenta por un
+ *          intervalo breve antes de desistir.
+ *
+ * @param instance Nombre de la instancia.
+ *
+ * @return El descriptor del socket, o -1 si no pudo crearse.
+ */
+int handoff_open(char *instance)
+{
+    struct sockaddr_un addr;
+
+    socklen_t len = instance_addr(instance, "handoff", &addr);
+
+    int fd = socket(AF_UNIX, (SOCK_STREAM | SOCK_CLOEXEC), 0);
+
+    if (fd == -1)
+        return -1;
+
+    for (int retries = 0; bind(fd, (struct sockaddr *)&addr, len) == -1; retries++)
+    {
+        if ((errno != EADDRINUSE) || (retries == 200))
+        {
+            close(fd);
+
+            return -1;
+        }
+
+        usleep(10000);
+    }
+
+    if (listen(fd, 1) == -1)
+    {
+        close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Esta función atiende un pedido de reinicio en caliente:
+ *        le envía a la nueva instancia el estado y los descriptores
+ *        y espera su confirmación.
+ *
+ * @details Los descriptores viajan como mensaje de control SCM_RIGHTS,
+ *          de modo que la nueva instancia obtiene referencias a los
+ *          mismos sockets de escucha: las conexiones pendientes en sus
+ *          colas no se pierden. Sólo luego de la confirmación (la nueva
+ *          instancia ya está aceptando) la saliente deja de aceptar.
+ *
+ * @param hfd Descriptor del socket de traspaso.
+ * @param st Estado a entregar.
+ * @param fds Descriptores a entregar (listeners y, al final, estadísticas).
+ *
+ * @return 0 Si la nueva instancia confirmó el traspaso.
+ *        -1 Si el traspaso falló o el pedido vino de otro usuario (la
+ *           instancia actual sigue operando).
+ */
+int handoff_give(int hfd, struct_handoff *st, int *fds)
+{
+    int conn = accept(hfd, NULL, NULL);
+
+    if (conn == -1)
+        return -1;
+
+    // Los descriptores (y el segmento de estadísticas, con escritura) sólo se entregan a procesos de confianza
+    if (!instance_peer_ok(conn))
+    {
+        close(conn);
+
+        return -1;
+    }
+
+    int nfds = st->n_listeners + 1;
+
+    char control[CMSG_SPACE(sizeof(int) * _HANDOFF_MAX_FDS_)];
+
+    memset(control, 0, sizeof(control));
+
+    struct iovec iov = {.iov_base = st, .iov_len = sizeof(*st)};
+
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)nfds);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * (size_t)nfds);
+
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * (size_t)nfds);
+
+    struct timeval timeout = {.tv_sec = _HANDOFF_TIMEOUT_, .tv_usec = 0};
+
+    char ack = 0;
+
+    int ok = (sendmsg(conn, &msg, 0) == (ssize_t)sizeof(*st)) &&
+             (setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0) &&
+             (read(conn, &ack, 1) == 1) && (ack == 1);
+
+    close(conn);
+
+    return ok ? 0 : -1;
+}
+
+/**
+ * @brief Esta función pide el reinicio en caliente de una instancia
+ *        en ejecución y recibe su estado y sus descriptores.
+ *
+ * @param instance Nombre de la instancia a reemplazar.
+ * @param st Estructura donde se almacenará el estado recibido.
+ * @param fds Vector donde se almacenarán los descriptores recibidos.
+ *
+ * @return El descriptor de la conexión, que debe cerrarse con handoff_ack
+ *         una vez que la nueva instancia esté aceptando clientes.
+ */
+int handoff_take(char *instance, struct_handoff *st, int *fds)
+{
+    struct sockaddr_un addr;
+
+    socklen_t len = instance_addr(instance, "handoff", &addr);
+
+    int conn = socket(AF_UNIX, (SOCK_STREAM | SOCK_CLOEXEC), 0);
+
+    if (conn == -1)
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed in socket creation {HANDOFF}");
+
+    if (connect(conn, (struct sockaddr *)&addr, len) == -1)
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed connecting to the running instance {HANDOFF}");
+
+    // Cualquier proceso puede ocupar la dirección abstracta: sólo se acepta el estado de uno de confianza
+    if (!instance_peer_ok(conn))
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "The running instance belongs to another user {HANDOFF}");
+
+    char control[CMSG_SPACE(sizeof(int) * _HANDOFF_MAX_FDS_)];
+
+    struct iovec iov = {.iov_base = st, .iov_len = sizeof(*st)};
+
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if ((recvmsg(conn, &msg, MSG_WAITALL) != (ssize_t)sizeof(*st)) || (st->magic != _HANDOFF_MAGIC_))
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed receiving state from the running instance {HANDOFF}");
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+    if (!cmsg || (cmsg->cmsg_type != SCM_RIGHTS) || (st->n_listeners < 0) || (st->n_listeners >= _HANDOFF_MAX_FDS_) ||
+        (cmsg->cmsg_len != CMSG_LEN(sizeof(int) * (size_t)(st->n_listeners + 1))))
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed receiving sockets from the running instance {HANDOFF}");
+
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * (size_t)(st->n_listeners + 1));
+
+    return conn;
+}
+
+/**
+ * @brief Esta función confirma a la instancia saliente que la nueva
+ *        instancia ya está aceptando clientes.
+ *
+ * @param conn Descriptor de la conexión devuelto por handoff_take.
+ */
+void handoff_ack(int conn)
+{
+    if (write(conn, &(char){1}, 1) != 1)
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed confirming the takeover {HANDOFF}");
+
+    close(conn);
+}
@@ -0,0 +1,476 @@
+/**
+ * @file lz.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de compresión (de la familia LZ77) de
+ *        los datos enviados por los clientes para el TP #1 de Sistemas
+ *        Operativos II.
+ * @version 0.1
+ * @since 2022-04-22
+ */
+
+#include "../headers/lz.h"
+
+/**
+ * @brief Esta función lee cuatro bytes sin requerir alineación.
+ *
+ * @param p Dirección de los bytes.
+ *
+ * @return Los bytes leídos.
+ */
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+/**
+ * @brief Esta función calcula la posición en la tabla de
+ *        coincidencias de una secuencia de cuatro bytes.
+ *
+ * @param v Secuencia.
+ *
+ * @return La posición en la tabla.
+ */
+static inline uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - _LZ_HASH_BITS_);
+}
+
+/**
+ * @brief Esta función escribe la extensión de un largo que no
+ *        entra en los cuatro bits de la secuencia.
+ *
+ * @param op Posición de escritura.
+ * @param len Largo restante (ya descontados los 15 del token).
+ *
+ * @return La nueva posición de escritura.
+ */
+static unsigned char *put_len(unsigned char *op, int len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+
+    *op++ = (unsigned char)len;
+
+    return op;
+}
+
+/**
+ * @brief Esta función escribe una secuencia: literales seguidos
+ *        (salvo en la última) de una coincidencia.
+ *
+ * @param op Posición de escritura.
+ * @param end Fin del buffer de salida.
+ * @param lit Literales.
+ * @param lit_len Cantidad de literales.
+ * @param offset Distancia hacia atrás de la coincidencia (0 en la última secuencia).
+ * @param match_len Largo de la coincidencia.
+ *
+ * @return La nueva posición de escritura, o NULL si no hay espacio.
+ */
+static unsigned char *put_sequence(unsigned char *op, unsigned char *end, const unsigned char *lit, int lit_len, int offset, int match_len)
+{
+    int code = match_len - _LZ_MIN_MATCH_;
+
+    if ((end - op) < (1 + lit_len + (lit_len / 255) + 1 + 2 + (code / 255) + 1))
+        return NULL;
+
+    unsigned char *token = op++;
+
+    *token = (unsigned char)((lit_len >= 15) ? (15 << 4) : (lit_len << 4));
+
+    if (lit_len >= 15)
+        op = put_len(op, lit_len - 15);
+
+    memcpy(op, lit, (size_t)lit_len);
+
+    op += lit_len;
+
+    if (offset == 0)
+        return op;
+
+    *op++ = (unsigned char)(offset & 0xFF);
+    *op++ = (unsigned char)(offset >> 8);
+
+    *token |= (unsigned char)((code >= 15) ? 15 : code);
+
+    if (code >= 15)
+        op = put_len(op, code - 15);
+
+    return op;
+}
+
+/**
+ * @brief Esta función comprime un bloque.
+ *
+ * @details El formato es el de los bloques de LZ4: cada secuencia
+ *          comienza con un byte cuyos cuatro bits altos indican la
+ *          cantidad de literales y los cuatro bajos el largo de la
+ *          coincidencia (menos _LZ_MIN_MATCH_), ambos extendidos con
+ *          bytes adicionales cuando llegan a 15; la distancia de la
+ *          coincidencia viaja en dos bytes. Las coincidencias se
+ *          buscan con una tabla indexada por el hash de cada secuencia
+ *          de cuatro bytes, que sólo recuerda la última aparición: se
+ *          resigna compresión a cambio de velocidad. Cuanto más tiempo
+ *          pasa sin encontrar coincidencias, más bytes se saltean, por
+ *          lo que los datos incompresibles se recorren rápidamente.
+ *
+ * @param src Bytes a comprimir.
+ * @param len Cantidad de bytes.
+ * @param dst Buffer de salida.
+ * @param cap Tamaño del buffer de salida.
+ *
+ * @return El largo comprimido, o -1 si no entra en el buffer de salida.
+ */
+int lz_compress(const unsigned char *src, int len, unsigned char *dst, int cap)
+{
+    int table[1 << _LZ_HASH_BITS_];
+
+    memset(table, 0, sizeof(table));
+
+    unsigned char *op = dst;
+    unsigned char *end = dst + cap;
+
+    int anchor = 0;
+    int ip = 1;
+    int misses = 0;
+
+    int limit = len - _LZ_MF_LIMIT_;
+    int match_limit = len - _LZ_LAST_LITERALS_;
+
+    if (len > 0)
+        table[lz_hash(read32(src))] = 0;
+
+    while (ip < limit)
+    {
+        uint32_t seq = read32(src + ip);
+        uint32_t h = lz_hash(seq);
+
+        int ref = table[h];
+
+        table[h] = ip;
+
+        if (((ip - ref) > _LZ_MAX_OFFSET_) || (read32(src + ref) != seq))
+        {
+            ip += 1 + (misses++ >> 6);
+
+            continue;
+        }
+
+        misses = 0;
+
+        // Se extiende la coincidencia hacia atrás sobre los literales pendientes, y hacia adelante
+        while ((ip > anchor) && (ref > 0) && (src[ip - 1] == src[ref - 1]))
+        {
+            ip--;
+            ref--;
+        }
+
+        int match_len = _LZ_MIN_MATCH_;
+
+        while (((ip + match_len) < match_limit) && (src[ip + match_len] == src[ref + match_len]))
+            match_len++;
+
+        if (!(op = put_sequence(op, end, src + anchor, ip - anchor, ip - ref, match_len)))
+            return -1;
+
+        ip += match_len;
+        anchor = ip;
+
+        if (ip < limit)
+            table[lz_hash(read32(src + ip - 2))] = ip - 2;
+    }
+
+    // Última secuencia: sólo literales
+    if (!(op = put_sequence(op, end, src + anchor, len - anchor, 0, _LZ_MIN_MATCH_)))
+        return -1;
+
+    return (int)(op - dst);
+}
+
+/**
+ * @brief Esta función lee la extensión de un largo.
+ *
+ * @param src Bloque comprimido.
+ * @param len Largo del bloque.
+ * @param ip Posición de lectura.
+ * @param value Largo a extender.
+ *
+ * @return 0 Si la extensión está completa dentro del bloque.
+ *         -1 Si el bloque es inválido.
+ */
+static int get_len(const unsigned char *src, int len, int *ip, int *value)
+{
+    unsigned char b;
+
+    do
+    {
+        if ((*ip >= len) || (*value > _LZ_MAX_BLOCK_))
+            return -1;
+
+        b = src[(*ip)++];
+
+        *value += b;
+    } while (b == 255);
+
+    return 0;
+}
+
+/**
+ * @brief Esta función descomprime un bloque.
+ *
+ * @details Todas las posiciones se validan antes de usarse: un bloque
+ *          inválido nunca lee ni escribe fuera de los buffers.
+ *
+ * @param src Bloque comprimido.
+ * @param len Largo del bloque.
+ * @param dst Buffer de salida.
+ * @param cap Tamaño del buffer de salida.
+ *
+ * @return El largo descomprimido, o -1 si el bloque es inválido.
+ */
+int lz_decompress(const unsigned char *src, int len, unsigned char *dst, int cap)
+{
+    int ip = 0;
+    int op = 0;
+
+    while (ip < len)
+    {
+        int token = src[ip++];
+
+        int lit_len = token >> 4;
+
+        if ((lit_len == 15) && (get_len(src, len, &ip, &lit_len) == -1))
+            return -1;
+
+        if ((lit_len > (len - ip)) || (lit_len > (cap - op)))
+            return -1;
+
+        memcpy(dst + op, src + ip, (size_t)lit_len);
+
+        ip += lit_len;
+        op += lit_len;
+
+        // La última secuencia no tiene coincidencia
+        if (ip == len)
+            break;
+
+        if ((len - ip) < 2)
+            return -1;
+
+        int offset = src[ip] | (src[ip + 1] << 8);
+
+        ip += 2;
+
+        int match_len = token & 15;
+
+        if ((match_len == 15) && (get_len(src, len, &ip, &match_len) == -1))
+            return -1;
+
+        match_len += _LZ_MIN_MATCH_;
+
+        if ((offset == 0) || (offset > op) || (match_len > (cap - op)))
+            return -1;
+
+        // La coincidencia puede solaparse con lo que se está escribiendo
+        if (offset >= match_len)
+            memcpy(dst + op, dst + op - offset, (size_t)match_len);
+        else
+            for (int i = 0; i < match_len; i++)
+                dst[op + i] = dst[op - offset + i];
+
+        op += match_len;
+    }
+
+    return op;
+}
+
+/**
+ * @brief Esta función arma el encabezado de un bloque.
+ *
+ * @details Ambos largos viajan en 16 bits en orden de red. Si son
+ *          iguales, el bloque viaja sin comprimir; un largo original
+ *          nulo indica el fin de la transmisión.
+ *
+ * @param out Buffer de _LZ_HDR_LEN_ bytes.
+ * @param raw_len Largo original del bloque.
+ * @param block_len Largo codificado del bloque.
+ */
+void lz_encode(unsigned char *out, int raw_len, int block_len)
+{
+    uint16_t raw = htons((uint16_t)raw_len);
+    uint16_t block = htons((uint16_t)block_len);
+
+    memcpy(out, &raw, sizeof(raw));
+    memcpy(out + 2, &block, sizeof(block));
+}
+
+/**
+ * @brief Esta función negocia, del lado del cliente, una conexión
+ *        comprimida.
+ *
+ * @param fd Descriptor de la conexión.
+ *
+ * @return 0 Si el servidor aceptó la conexión comprimida.
+ *         -1 Si hubo un error.
+ */
+int lz_hello(int fd)
+{
+    unsigned char hello[_LZ_HELLO_LEN_] = {0};
+
+    uint16_t version = htons(_LZ_VERSION_);
+
+    memcpy(hello, _LZ_MAGIC_, 4);
+    memcpy(hello + 4, &version, sizeof(version));
+
+    if (send(fd, hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello))
+        return -1;
+
+    if (recv(fd, hello, sizeof(hello), MSG_WAITALL) != (ssize_t)sizeof(hello))
+        return -1;
+
+    memcpy(&version, hello + 4, sizeof(version));
+
+    return ((memcmp(hello, _LZ_MAGIC_, 4) == 0) && (ntohs(version) == _LZ_VERSION_)) ? 0 : -1;
+}
+
+/**
+ * @brief Esta función detecta, del lado del servidor, si una conexión
+ *        es comprimida, y en ese caso responde el saludo.
+ *
+ * @details Como en las conexiones multiplexadas, los primeros bytes se
+ *          leen con MSG_PEEK.
+ *
+ * @param fd Descriptor de la conexión.
+ *
+ * @return 1 Si la conexión es comprimida.
+ *         0 Si no lo es.
+ *         -1 Si el saludo es inválido.
+ */
+int lz_accept(int fd)
+{
+    unsigned char hello[_LZ_HELLO_LEN_];
+
+    if ((recv(fd, hello, sizeof(hello), (MSG_PEEK | MSG_WAITALL)) != (ssize_t)sizeof(hello)) ||
+        (memcmp(hello, _LZ_MAGIC_, 4) != 0))
+        return 0;
+
+    if (recv(fd, hello, sizeof(hello), MSG_WAITALL) != (ssize_t)sizeof(hello))
+        return -1;
+
+    uint16_t version;
+
+    memcpy(&version, hello + 4, sizeof(version));
+
+    if (ntohs(version) != _LZ_VERSION_)
+        return -1;
+
+    return (send(fd, hello, sizeof(hello), MSG_NOSIGNAL) == (ssize_t)sizeof(hello)) ? 1 : -1;
+}
+
+/**
+ * @brief Esta función inicializa el lado receptor de una conexión
+ *        comprimida.
+ *
+ * @param z Estado a inicializar.
+ */
+void lz_init(struct_lz_stream *z)
+{
+    z->closed = 0;
+    z->hdr_len = 0;
+    z->raw_len = 0;
+    z->block_len = 0;
+    z->have = 0;
+}
+
+/**
+ * @brief Esta función procesa los bytes leídos de una conexión
+ *        comprimida.
+ *
+ * @details Los bloques se acumulan hasta estar completos y se
+ *          descomprimen uno por vez; el resultado sólo se cuenta (el
+ *          servidor no usa los datos), pero se verifica que su largo
+ *          coincida con el anunciado en el encabezado.
+ *
+ * @param z Estado de la conexión.
+ * @param data Bytes leídos.
+ * @param len Cantidad de bytes leídos.
+ *
+ * @return La cantidad de bytes descomprimidos de los bloques que se
+ *         completaron, o -1 si se recibió un bloque inválido.
+ */
+long int lz_feed(struct_lz_stream *z, char *data, size_t len)
+{
+    long int raw = 0;
+
+    size_t pos = 0;
+
+    while ((pos < len) && !z->closed)
+    {
+        if (z->hdr_len < _LZ_HDR_LEN_)
+        {
+            size_t n = (size_t)(_LZ_HDR_LEN_ - z->hdr_len);
+
+            if (n > (len - pos))
+                n = len - pos;
+
+            memcpy(z->hdr + z->hdr_len, data + pos, n);
+
+            pos += n;
+            z->hdr_len += (int)n;
+
+            if (z->hdr_len < _LZ_HDR_LEN_)
+                continue;
+
+            uint16_t raw_len;
+            uint16_t block_len;
+
+            memcpy(&raw_len, z->hdr, sizeof(raw_len));
+            memcpy(&block_len, z->hdr + 2, sizeof(block_len));
+
+            z->raw_len = ntohs(raw_len);
+            z->block_len = ntohs(block_len);
+            z->have = 0;
+
+            if (z->raw_len == 0)
+            {
+                z->closed = 1;
+
+                continue;
+            }
+
+            if ((z->raw_len > _LZ_MAX_BLOCK_) || (z->block_len == 0) || (z->block_len > z->raw_len))
+                return -1;
+        }
+
+        size_t n = (size_t)(z->block_len - z->have);
+
+        if (n > (len - pos))
+            n = len - pos;
+
+        // Los bloques sin comprimir no necesitan copiarse
+        if (z->block_len < z->raw_len)
+            memcpy(z->block + z->have, data + pos, n);
+
+        pos += n;
+        z->have += (int)n;
+
+        if (z->have < z->block_len)
+            continue;
+
+        if ((z->block_len < z->raw_len) && (lz_decompress(z->block, z->block_len, z->out, _LZ_MAX_BLOCK_) != z->raw_len))
+            return -1;
+
+        raw += z->raw_len;
+
+        z->hdr_len = 0;
+    }
+
+    return raw;
+}
@@ -0,0 +1,524 @@
+/**
+ * @file metrics.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones del exportador de métricas en
+ *        formato OpenMetrics (Prometheus) para el TP #1 de Sistemas
+ *        Operativos II.
+ * @version 0.1
+ * @since 2022-04-16
+ */
+
+#include "../headers/servers_setup.h"
+
+/**
+ * @brief Esta función crea el socket en el que el exportador atiende
+ *        los pedidos de métricas.
+ *
+ * @details Si el destino es un número, se escucha en ese puerto TCP de
+ *          la interfaz de loopback; si no, se lo toma como ruta de un
+ *          socket Unix. Como en un reinicio en caliente la instancia
+ *          saliente libera el destino recién al confirmarse el traspaso,
+ *          se reintenta por un intervalo breve.
+ *
+ * @param target Puerto TCP o ruta del socket Unix.
+ *
+ * @return El descriptor del socket, o -1 si no pudo crearse.
+ */
+int metrics_open(char *target)
+{
+    struct sockaddr_storage addr;
+
+    socklen_t len;
+
+    memset(&addr, 0, sizeof(addr));
+
+    if (atoi(target) > 0)
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)&addr;
+
+        in->sin_family = AF_INET;
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        in->sin_port = htons((uint16_t)atoi(target));
+
+        len = sizeof(*in);
+    }
+    else
+    {
+        struct sockaddr_un *un = (struct sockaddr_un *)&addr;
+
+        un->sun_family = AF_UNIX;
+
+        strncpy(un->sun_path, target, (sizeof(un->sun_path) - 1));
+
+        len = sizeof(*un);
+    }
+
+    int fd = socket(addr.ss_family, (SOCK_STREAM | SOCK_CLOEXEC), 0);
+
+    if (fd == -1)
+        return -1;
+
+    if (addr.ss_family == AF_INET)
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int));
+
+    for (int retries = 0; bind(fd, (struct sockaddr *)&addr, len) == -1; retries++)
+    {
+        if ((errno != EADDRINUSE) || (retries == 200))
+        {
+            close(fd);
+
+            return -1;
+        }
+
+        // Un socket Unix que quedó de una ejecución anterior (o de la instancia saliente) se reemplaza
+        if (addr.ss_family == AF_UNIX)
+            unlink(target);
+        else
+            usleep(10000);
+    }
+
+    if (listen(fd, 5) == -1)
+    {
+        close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Esta función muestrea la velocidad de cada conexión activa
+ *        y la agrega al histograma de su protocolo.
+ *
+ * @details Sólo se leen los contadores de la tabla de conexiones: los
+ *          handlers no participan del muestreo. Una conexión se muestrea
+ *          recién a partir de la segunda lectura en la que aparece.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param hist Histogramas de cada protocolo.
+ * @param prev_pid Dueño de cada entrada en el muestreo anterior.
+ * @param prev_bytes Bytes de cada entrada en el muestreo anterior.
+ * @param dt Segundos transcurridos desde el muestreo anterior.
+ */
+static void sample_rates(struct_data *sd, struct_rate_hist *hist, int *prev_pid, long int *prev_bytes, double dt)
+{
+    for (int i = 0; i < _MAX_CONNS_; i++)
+    {
+        struct_conn *conn = &sd->conns[i];
+
+        int pid = __atomic_load_n(&conn->pid, __ATOMIC_ACQUIRE);
+
+        long int bytes = stats_read(&conn->bytes);
+
+        if ((pid != 0) && (pid == prev_pid[i]) && (dt > 0) && (conn->proto >= 0) && (conn->proto < _PROTOS_))
+        {
+            struct_rate_hist *h = &hist[conn->proto];
+
+            double rate = (double)(bytes - prev_bytes[i]) / dt;
+
+            double bound = 1e3;
+
+            int b = 0;
+
+            while ((b < _RATE_BUCKETS_) && (rate > bound))
+            {
+                bound *= 10;
+                b++;
+            }
+
+            h->buckets[b]++;
+            h->count++;
+            h->sum += rate;
+        }
+
+        prev_pid[i] = pid;
+        prev_bytes[i] = bytes;
+    }
+}
+
+/**
+ * @brief Esta función escribe una familia de métricas con un valor
+ *        por protocolo.
+ *
+ * @param out Flujo de salida.
+ * @param name Nombre de la familia (sin prefijo).
+ * @param type Tipo OpenMetrics ("counter" o "gauge").
+ * @param help Descripción.
+ * @param instance Nombre de la instancia.
+ * @param labels Etiquetas adicionales (cadena vacía si no hay).
+ * @param values Valor de cada protocolo.
+ * @param scale Factor por el que se multiplican los valores.
+ * @param header Si es distinto de cero, se escriben las líneas TYPE y HELP.
+ */
+static void write_family(FILE *out, char *name, char *type, char *help, char *instance, char *labels, long int *values, double scale, int header)
+{
+    int counter = (strcmp(type, "counter") == 0);
+
+    if (header)
+        fprintf(out, "# TYPE %s%s %s\n# HELP %s%s %s\n", _METRICS_PREFIX_, name, type, _METRICS_PREFIX_, name, help);
+
+    for (int p = 0; p < _PROTOS_; p++)
+    {
+        fprintf(out, "%s%s%s{instance=\"%s\",proto=\"%s\"%s} ", _METRICS_PREFIX_, name, counter ? "_total" : "", instance, proto_name(p), labels);
+
+        // Los contadores enteros se escriben completos, sin la pérdida de precisión de un double
+        if (scale == 1)
+            fprintf(out, "%ld\n", values[p]);
+        else
+            fprintf(out, "%.9f\n", (double)values[p] * scale);
+    }
+}
+
+/**
+ * @brief Esta función escribe las métricas de cada extremo de escucha,
+ *        con el protocolo y el nombre del extremo como etiquetas.
+ *
+ * @param out Flujo de salida.
+ * @param sd Puntero a la estructura de estadísticas.
+ */
+static void write_endpoint_metrics(FILE *out, struct_data *sd)
+{
+    char *names[] = {"endpoint_received_bytes", "endpoint_accepts", "endpoint_shed_connections", "endpoint_active_connections"};
+    char *helps[] = {"Bytes received from clients, per listening endpoint.", "Accepted connections, per listening endpoint.",
+                     "Connections shed by admission control, per listening endpoint.", "Connections currently being served, per listening endpoint."};
+
+    for (int m = 0; m < 4; m++)
+    {
+        int counter = (m < 3);
+
+        fprintf(out, "# TYPE %s%s %s\n# HELP %s%s %s\n", _METRICS_PREFIX_, names[m], counter ? "counter" : "gauge", _METRICS_PREFIX_, names[m], helps[m]);
+
+        for (int i = 0; i < _MAX_ENDPOINTS_; i++)
+        {
+            struct_endpoint *ep = &sd->endpoints[i];
+
+            if (ep->name[0] == '\0')
+                continue;
+
+            // Las comillas y las barras invertidas (posibles en la ruta de un socket local) se escapan
+            char label[(2 * _ENDPOINT_LEN_) + 1];
+
+            size_t len = 0;
+
+            for (char *c = ep->name; *c && (c < (ep->name + _ENDPOINT_LEN_)); c++)
+            {
+                if ((*c == '"') || (*c == '\\'))
+                    label[len++] = '\\';
+
+                label[len++] = *c;
+            }
+
+            label[len] = '\0';
+
+            long int values[] = {stats_read(&ep->bytes), stats_read(&ep->accepts), stats_read(&ep->shed), stats_endpoint_conns(sd, i)};
+
+            fprintf(out, "%s%s%s{instance=\"%s\",proto=\"%s\",endpoint=\"%s\"} %ld\n", _METRICS_PREFIX_, names[m], counter ? "_total" : "",
+                    sd->instance, proto_name(ep->proto), label, values[m]);
+        }
+    }
+}
+
+/**
+ * @brief Esta función arma el cuerpo de la respuesta con todas las
+ *        métricas de la instancia.
+ *
+ * @param out Flujo de salida.
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param hist Histogramas de velocidades de cada protocolo.
+ */
+static void write_metrics(FILE *out, struct_data *sd, struct_rate_hist *hist)
+{
+    struct_proto_stats ps[_PROTOS_];
+
+    stats_snapshot(sd, ps);
+
+    long int v[_PROTOS_];
+    long int w[_PROTOS_];
+
+    char *inst = sd->instance;
+
+#define _FILL_(dst, field)            \
+    for (int p = 0; p < _PROTOS_; p++) \
+        dst[p] = ps[p].field;
+
+    _FILL_(v, bytes);
+    write_family(out, "received_bytes", "counter", "Bytes received from clients.", inst, "", v, 1, 1);
+
+    _FILL_(v, comp_bytes);
+    write_family(out, "compressed_bytes", "counter", "Bytes received on compressed connections, as sent on the wire.", inst, "", v, 1, 1);
+
+    _FILL_(v, raw_bytes);
+    write_family(out, "decompressed_bytes", "counter", "Bytes received on compressed connections, after decompression.", inst, "", v, 1, 1);
+
+    _FILL_(v, reads);
+    write_family(out, "reads", "counter", "Read system calls made by the handlers.", inst, "", v, 1, 1);
+
+    _FILL_(v, accepts);
+    write_family(out, "accepts", "counter", "Accepted connections.", inst, "", v, 1, 1);
+
+    _FILL_(v, shed);
+    write_family(out, "shed_connections", "counter", "Connections shed by admission control.", inst, "", v, 1, 1);
+
+    _FILL_(v, deferred);
+    write_family(out, "deferred_connections", "counter", "Connections that waited for a free admission slot.", inst, "", v, 1, 1);
+
+    _FILL_(v, channels);
+    write_family(out, "channels", "counter", "Logical channels opened on multiplexed connections.", inst, "", v, 1, 1);
+
+    _FILL_(v, setup_ns);
+    write_family(out, "connection_setup_seconds", "counter", "Total time from accept until each handler was ready to read.", inst, "", v, 1e-9, 1);
+
+    _FILL_(v, threads);
+    write_family(out, "thread_handled_connections", "counter", "Accepted connections handled by a thread of the listener instead of a process.", inst, "", v, 1, 1);
+
+    _FILL_(v, rss_bytes);
+    write_family(out, "handler_rss_bytes", "counter", "Sum of the resident memory of its own that each handler used.", inst, "", v, 1, 1);
+
+    _FILL_(v, rss_samples);
+    write_family(out, "handler_rss_samples", "counter", "Handlers that measured their resident memory.", inst, "", v, 1, 1);
+
+    _FILL_(v, utime_ns);
+    _FILL_(w, stime_ns);
+    write_family(out, "handler_cpu_seconds", "counter", "CPU time used by the handlers.", inst, ",mode=\"user\"", v, 1e-9, 1);
+    write_family(out, "handler_cpu_seconds", "counter", "", inst, ",mode=\"system\"", w, 1e-9, 0);
+
+    _FILL_(v, nvcsw);
+    _FILL_(w, nivcsw);
+    write_family(out, "context_switches", "counter", "Context switches of the handlers.", inst, ",kind=\"voluntary\"", v, 1, 1);
+    write_family(out, "context_switches", "counter", "", inst, ",kind=\"involuntary\"", w, 1, 0);
+
+    _FILL_(v, wait_ns);
+    write_family(out, "runqueue_wait_seconds", "counter", "Time the handlers spent waiting for a CPU.", inst, "", v, 1e-9, 1);
+
+    _FILL_(v, throttled_ns);
+    write_family(out, "throttled_seconds", "counter", "Time the handlers stopped reading because of rate caps.", inst, "", v, 1e-9, 1);
+
+    _FILL_(v, tcp_samples);
+    write_family(out, "tcp_info_samples", "counter", "TCP_INFO samples taken on TCP connections (one per connection per second).", inst, "", v, 1, 1);
+
+    _FILL_(v, rcv_rtt_us);
+    write_family(out, "tcp_rcv_rtt_seconds", "counter", "Sum of the receiver RTT estimate of every TCP_INFO sample.", inst, "", v, 1e-6, 1);
+
+    _FILL_(v, rcv_space);
+    write_family(out, "tcp_rcv_space_bytes", "counter", "Sum of the receive window of every TCP_INFO sample.", inst, "", v, 1, 1);
+
+    _FILL_(v, backlogged);
+    write_family(out, "tcp_backlogged_samples", "counter", "TCP_INFO samples whose receive queue was building up (handler-limited).", inst, "", v, 1, 1);
+
+    _FILL_(v, ooo_pkts);
+    write_family(out, "tcp_out_of_order_packets", "counter", "Packets received out of order on TCP connections.", inst, "", v, 1, 1);
+
+#undef _FILL_
+
+    // Conexiones activas, según la tabla de conexiones
+    long int active[_PROTOS_] = {0};
+
+    for (int i = 0; i < _MAX_CONNS_; i++)
+        if ((__atomic_load_n(&sd->conns[i].pid, __ATOMIC_ACQUIRE) != 0) && (sd->conns[i].proto >= 0) && (sd->conns[i].proto < _PROTOS_))
+            active[sd->conns[i].proto]++;
+
+    write_family(out, "active_connections", "gauge", "Connections currently being served.", inst, "", active, 1, 1);
+
+    write_endpoint_metrics(out, sd);
+
+    fprintf(out, "# TYPE %sconnection_rate_bytes_per_second histogram\n"
+                 "# HELP %sconnection_rate_bytes_per_second Per-connection receive rate, sampled every second.\n",
+            _METRICS_PREFIX_, _METRICS_PREFIX_);
+
+    for (int p = 0; p < _PROTOS_; p++)
+    {
+        long int cumulative = 0;
+
+        double bound = 1e3;
+
+        for (int b = 0; b <= _RATE_BUCKETS_; b++, bound *= 10)
+        {
+            cumulative += hist[p].buckets[b];
+
+            char le[32];
+
+            if (b == _RATE_BUCKETS_)
+                snprintf(le, sizeof(le), "+Inf");
+            else
+                snprintf(le, sizeof(le), "%.1e", bound);
+
+            fprintf(out, "%sconnection_rate_bytes_per_second_bucket{instance=\"%s\",proto=\"%s\",le=\"%s\"} %ld\n",
+                    _METRICS_PREFIX_, inst, proto_name(p), le, cumulative);
+        }
+
+        fprintf(out, "%sconnection_rate_bytes_per_second_count{instance=\"%s\",proto=\"%s\"} %ld\n"
+                     "%sconnection_rate_bytes_per_second_sum{instance=\"%s\",proto=\"%s\"} %.9g\n",
+                _METRICS_PREFIX_, inst, proto_name(p), hist[p].count,
+                _METRICS_PREFIX_, inst, proto_name(p), hist[p].sum);
+    }
+
+    fprintf(out, "# TYPE %spaused gauge\n# HELP %spaused Whether byte accounting is paused.\n%spaused{instance=\"%s\"} %d\n",
+            _METRICS_PREFIX_, _METRICS_PREFIX_, _METRICS_PREFIX_, inst, sd->cfg.paused ? 1 : 0);
+
+    fprintf(out, "# EOF\n");
+}
+
+/**
+ * @brief Esta función atiende un pedido HTTP de métricas.
+ *
+ * @param fd Descriptor del socket del exportador.
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param hist Histogramas de velocidades de cada protocolo.
+ */
+static void serve_scrape(int fd, struct_data *sd, struct_rate_hist *hist)
+{
+    int conn = accept(fd, NULL, NULL);
+
+    if (conn == -1)
+        return;
+
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = _METRICS_TIMEOUT_MS_ * 1000};
+
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char req[_METRICS_REQ_LEN_];
+
+    size_t len = 0;
+
+    // Sólo interesa la línea del pedido, pero se lee hasta el fin de los encabezados
+    while (len < (sizeof(req) - 1))
+    {
+        ssize_t aux = read(conn, req + len, sizeof(req) - 1 - len);
+
+        if (aux <= 0)
+            break;
+
+        len += (size_t)aux;
+
+        req[len] = '\0';
+
+        if (strstr(req, "\r\n\r\n"))
+            break;
+    }
+
+    req[len] = '\0';
+
+    char *body = NULL;
+
+    size_t body_len = 0;
+
+    FILE *out = open_memstream(&body, &body_len);
+
+    if (!out)
+    {
+        close(conn);
+
+        return;
+    }
+
+    int ok = (strncmp(req, "GET /metrics ", 13) == 0) || (strncmp(req, "GET / ", 6) == 0);
+
+    if (ok)
+        write_metrics(out, sd, hist);
+    else
+        fprintf(out, "Not found. Metrics are served at /metrics\n");
+
+    fclose(out);
+
+    char header[256];
+
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                              ok ? "200 OK" : "404 Not Found",
+                              ok ? "application/openmetrics-text; version=1.0.0; charset=utf-8" : "text/plain",
+                              body_len);
+
+    if ((write(conn, header, (size_t)header_len) != header_len) || (write(conn, body, body_len) != (ssize_t)body_len))
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed sending metrics");
+
+    free(body);
+
+    close(conn);
+}
+
+/**
+ * @brief Se atienden los pedidos de métricas y se muestrean las
+ *        velocidades por conexión.
+ *
+ * @details Corre en un proceso propio: un pedido lento o un scraper
+ *          frecuente nunca demora a los handlers, que sólo incrementan
+ *          sus contadores atómicos, ni al logger.
+ *
+ * @param fd Descriptor del socket del exportador.
+ * @param sd Puntero a la estructura de estadísticas.
+ */
+static void run_metrics(int fd, struct_data *sd)
+{
+    static struct_rate_hist hist[_PROTOS_];
+    static int prev_pid[_MAX_CONNS_];
+    static long int prev_bytes[_MAX_CONNS_];
+
+    long int last_sample = now_ns();
+
+    sample_rates(sd, hist, prev_pid, prev_bytes, 0);
+
+    while (1)
+    {
+        long int wait_ms = ((last_sample + (_METRICS_SAMPLE_MS_ * 1000000L)) - now_ns()) / 1000000;
+
+        struct pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+
+        int ready = poll(&pfd, 1, (wait_ms > 0) ? (int)wait_ms : 0);
+
+        if ((ready > 0) && (pfd.revents & POLLIN))
+            serve_scrape(fd, sd, hist);
+
+        long int now = now_ns();
+
+        if ((now - last_sample) >= (_METRICS_SAMPLE_MS_ * 1000000L))
+        {
+            sample_rates(sd, hist, prev_pid, prev_bytes, (double)(now - last_sample) / 1e9);
+
+            last_sample = now;
+        }
+    }
+}
+
+/**
+ * @brief Se crea el proceso exportador de métricas.
+ *
+ * @param sv Estado del proceso principal del servidor.
+ * @param fd Descriptor del socket del exportador.
+ *
+ * @return El PID del proceso creado.
+ */
+int spawn_metrics(struct_server *sv, int fd)
+{
+    fflush(stdout);
+
+    int pid = fork();
+
+    if (pid == -1)
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on process forking for metrics exporter");
+
+    if (pid == 0)
+    {
+        for (int i = 0; i < sv->n_ls; i++)
+            close(sv->ls[i].fd);
+
+        if (sv->hfd != -1)
+            close(sv->hfd);
+
+        if (sv->cfd != -1)
+            close(sv->cfd);
+
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+
+        // El exportador comparte las CPUs del logger, lejos de los handlers
+        pin_to_cpus(&sv->aff, &sv->aff.logger_cpus);
+
+        run_metrics(fd, sv->sd);
+    }
+
+    close(fd);
+
+    return pid;
+}
@@ -0,0 +1,281 @@
+/**
+ * @file mux.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones del protocolo de canales lógicos
+ *        multiplexados sobre una misma conexión para el TP #1 de
+ *        Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-19
+ */
+
+#include "../headers/mux.h"
+
+/**
+ * @brief Esta función arma el encabezado de una trama.
+ *
+ * @details Todos los campos viajan en orden de red: el canal y el
+ *          tipo en 16 bits y el largo en 32 bits.
+ *
+ * @param out Buffer de _MUX_HDR_LEN_ bytes.
+ * @param channel Canal de la trama.
+ * @param type Tipo de la trama.
+ * @param len Largo de los datos (o créditos devueltos).
+ */
+void mux_encode(unsigned char *out, int channel, int type, uint32_t len)
+{
+    uint16_t ch = htons((uint16_t)channel);
+    uint16_t ty = htons((uint16_t)type);
+    uint32_t ln = htonl(len);
+
+    memcpy(out, &ch, sizeof(ch));
+    memcpy(out + 2, &ty, sizeof(ty));
+    memcpy(out + 4, &ln, sizeof(ln));
+}
+
+/**
+ * @brief Esta función interpreta el encabezado de una trama.
+ *
+ * @param in Buffer de _MUX_HDR_LEN_ bytes.
+ * @param channel Canal de la trama.
+ * @param type Tipo de la trama.
+ * @param len Largo de los datos (o créditos devueltos).
+ */
+void mux_decode(unsigned char *in, int *channel, int *type, uint32_t *len)
+{
+    uint16_t ch;
+    uint16_t ty;
+    uint32_t ln;
+
+    memcpy(&ch, in, sizeof(ch));
+    memcpy(&ty, in + 2, sizeof(ty));
+    memcpy(&ln, in + 4, sizeof(ln));
+
+    *channel = ntohs(ch);
+    *type = ntohs(ty);
+    *len = ntohl(ln);
+}
+
+/**
+ * @brief Esta función envía una trama sin datos (créditos o cierre).
+ *
+ * @param fd Descriptor de la conexión.
+ * @param channel Canal de la trama.
+ * @param type Tipo de la trama.
+ * @param len Valor del campo de largo.
+ *
+ * @return 0 Si la trama se envió completa.
+ *         -1 Si hubo un error.
+ */
+int mux_send_frame(int fd, int channel, int type, uint32_t len)
+{
+    unsigned char hdr[_MUX_HDR_LEN_];
+
+    mux_encode(hdr, channel, type, len);
+
+    return (send(fd, hdr, sizeof(hdr), MSG_NOSIGNAL) == (ssize_t)sizeof(hdr)) ? 0 : -1;
+}
+
+/**
+ * @brief Esta función arma el saludo de una conexión multiplexada.
+ *
+ * @param out Buffer de _MUX_HELLO_LEN_ bytes.
+ * @param channels Cantidad de canales.
+ */
+static void mux_mk_hello(unsigned char *out, int channels)
+{
+    uint16_t version = htons(_MUX_VERSION_);
+    uint16_t ch = htons((uint16_t)channels);
+
+    memcpy(out, _MUX_MAGIC_, 4);
+    memcpy(out + 4, &version, sizeof(version));
+    memcpy(out + 6, &ch, sizeof(ch));
+}
+
+/**
+ * @brief Esta función negocia, del lado del cliente, una conexión
+ *        multiplexada.
+ *
+ * @details El servidor responde con el mismo saludo, indicando la
+ *          cantidad de canales que acepta (que puede ser menor a la
+ *          pedida).
+ *
+ * @param fd Descriptor de la conexión.
+ * @param channels Cantidad de canales pedida.
+ *
+ * @return La cantidad de canales aceptada, o -1 si hubo un error.
+ */
+int mux_hello(int fd, int channels)
+{
+    unsigned char hello[_MUX_HELLO_LEN_];
+
+    mux_mk_hello(hello, channels);
+
+    if (send(fd, hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello))
+        return -1;
+
+    if (recv(fd, hello, sizeof(hello), MSG_WAITALL) != (ssize_t)sizeof(hello))
+        return -1;
+
+    uint16_t version;
+    uint16_t accepted;
+
+    memcpy(&version, hello + 4, sizeof(version));
+    memcpy(&accepted, hello + 6, sizeof(accepted));
+
+    if ((memcmp(hello, _MUX_MAGIC_, 4) != 0) || (ntohs(version) != _MUX_VERSION_))
+        return -1;
+
+    return ntohs(accepted);
+}
+
+/**
+ * @brief Esta función detecta, del lado del servidor, si una conexión
+ *        es multiplexada, y en ese caso responde el saludo.
+ *
+ * @details Los primeros bytes se leen con MSG_PEEK: si no corresponden
+ *          a un saludo, quedan en el socket para la lectura normal.
+ *
+ * @param fd Descriptor de la conexión.
+ *
+ * @return La cantidad de canales aceptada, 0 si la conexión no es
+ *         multiplexada, o -1 si el saludo es inválido.
+ */
+int mux_accept(int fd)
+{
+    unsigned char hello[_MUX_HELLO_LEN_];
+
+    if ((recv(fd, hello, sizeof(hello), (MSG_PEEK | MSG_WAITALL)) != (ssize_t)sizeof(hello)) ||
+        (memcmp(hello, _MUX_MAGIC_, 4) != 0))
+        return 0;
+
+    if (recv(fd, hello, sizeof(hello), MSG_WAITALL) != (ssize_t)sizeof(hello))
+        return -1;
+
+    uint16_t version;
+    uint16_t channels;
+
+    memcpy(&version, hello + 4, sizeof(version));
+    memcpy(&channels, hello + 6, sizeof(channels));
+
+    int accepted = ntohs(channels);
+
+    if ((ntohs(version) != _MUX_VERSION_) || (accepted == 0))
+        return -1;
+
+    if (accepted > _MUX_MAX_CHANNELS_)
+        accepted = _MUX_MAX_CHANNELS_;
+
+    mux_mk_hello(hello, accepted);
+
+    if (send(fd, hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello))
+        return -1;
+
+    return accepted;
+}
+
+/**
+ * @brief Esta función inicializa el lado receptor de una conexión
+ *        multiplexada.
+ *
+ * @param m Estado a inicializar.
+ * @param channels Cantidad de canales aceptada.
+ */
+void mux_init(struct_mux *m, int channels)
+{
+    memset(m, 0, sizeof(*m));
+
+    m->channels = channels;
+
+    for (int i = 0; i < channels; i++)
+        m->window[i] = _MUX_WINDOW_;
+}
+
+/**
+ * @brief Esta función procesa los bytes leídos de una conexión
+ *        multiplexada.
+ *
+ * @details Los datos de cada canal se suman a su contador y, cada vez
+ *          que se consume la mitad de la ventana de un canal, se le
+ *          devuelven esos créditos al emisor. Un emisor que envía más
+ *          de lo que sus créditos le permiten viola el protocolo.
+ *
+ * @param m Estado de la conexión.
+ * @param fd Descriptor de la conexión (para devolver créditos).
+ * @param data Bytes leídos.
+ * @param len Cantidad de bytes leídos.
+ * @param count Si es distinto de cero, se actualizan los contadores de los canales.
+ *
+ * @return La cantidad de bytes de datos (sin encabezados), o -1 si
+ *         la trama recibida es inválida.
+ */
+long int mux_feed(struct_mux *m, int fd, char *data, size_t len, int count)
+{
+    long int payload = 0;
+
+    size_t pos = 0;
+
+    while ((pos < len) && !m->closed)
+    {
+        if (m->remaining > 0)
+        {
+            long int chunk = (m->remaining < (long int)(len - pos)) ? m->remaining : (long int)(len - pos);
+
+            int ch = m->channel;
+
+            pos += (size_t)chunk;
+            payload += chunk;
+            m->remaining -= chunk;
+            m->consumed[ch] += chunk;
+
+            if (count && m->acc[ch])
+                __atomic_fetch_add(m->acc[ch], chunk, __ATOMIC_RELAXED);
+
+            if (m->consumed[ch] >= (_MUX_WINDOW_ / 2))
+            {
+                mux_send_frame(fd, ch, _MUX_CREDIT_, (uint32_t)m->consumed[ch]);
+
+                m->window[ch] += m->consumed[ch];
+                m->consumed[ch] = 0;
+            }
+
+            continue;
+        }
+
+        size_t n = (size_t)(_MUX_HDR_LEN_ - m->hdr_len);
+
+        if (n > (len - pos))
+            n = len - pos;
+
+        memcpy(m->hdr + m->hdr_len, data + pos, n);
+
+        pos += n;
+        m->hdr_len += (int)n;
+
+        if (m->hdr_len < _MUX_HDR_LEN_)
+            continue;
+
+        m->hdr_len = 0;
+
+        int ch;
+        int type;
+        uint32_t frame_len;
+
+        mux_decode(m->hdr, &ch, &type, &frame_len);
+
+        if (type == _MUX_CLOSE_)
+        {
+            m->closed = 1;
+
+            continue;
+        }
+
+        if ((type != _MUX_DATA_) || (ch >= m->channels) || ((long int)frame_len > m->window[ch]))
+            return -1;
+
+        m->window[ch] -= frame_len;
+        m->channel = ch;
+        m->remaining = frame_len;
+    }
+
+    return payload;
+}
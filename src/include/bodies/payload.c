@@ -0,0 +1,160 @@
+/**
+ * @file payload.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con generadores de los datos que envían los clientes
+ *        para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-22
+ */
+
+#include "../headers/payload.h"
+
+// Vocabulario del generador de texto, de las palabras más frecuentes a las menos frecuentes
+static char *words[] = {
+    "the", "of", "and", "to", "a", "in", "is", "that", "for", "it", "as", "was", "with", "be", "by", "on",
+    "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had", "they", "you", "were",
+    "their", "one", "all", "we", "can", "her", "has", "there", "been", "if", "more", "when", "will", "would", "who", "so",
+    "process", "socket", "server", "client", "kernel", "memory", "buffer", "network", "connection", "protocol", "signal", "thread", "message", "system"};
+
+// Componentes, niveles y mensajes del generador de logs
+static char *levels[] = {"INFO", "INFO", "INFO", "DEBUG", "DEBUG", "WARN", "ERROR"};
+static char *components[] = {"listener", "handler", "logger", "control", "metrics", "qos"};
+static char *events[] = {"accepted connection", "read completed", "flushed usage sample", "config reloaded", "rate cap reached", "connection closed"};
+
+/**
+ * @brief Esta función avanza el generador de números aleatorios
+ *        (xorshift de 32 bits).
+ *
+ * @param state Estado del generador (distinto de cero).
+ *
+ * @return El siguiente número.
+ */
+static inline unsigned int next_rand(unsigned int *state)
+{
+    unsigned int x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return (*state = x);
+}
+
+/**
+ * @brief Esta función interpreta el nombre de un generador.
+ *
+ * @param name Nombre del generador.
+ *
+ * @return El generador, o -1 si el nombre es inválido.
+ */
+int payload_parse(char *name)
+{
+    for (int i = _PAYLOAD_CONST_; i <= _PAYLOAD_LOG_; i++)
+        if (strcmp(name, payload_name(i)) == 0)
+            return i;
+
+    return -1;
+}
+
+/**
+ * @brief Esta función devuelve el nombre de un generador.
+ *
+ * @param gen Generador.
+ *
+ * @return El nombre del generador.
+ */
+char *payload_name(int gen)
+{
+    switch (gen)
+    {
+    case _PAYLOAD_CONST_:
+        return "const";
+    case _PAYLOAD_RANDOM_:
+        return "random";
+    case _PAYLOAD_TEXT_:
+        return "text";
+    case _PAYLOAD_LOG_:
+        return "log";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Esta función llena un buffer con los datos de un generador.
+ *
+ * @details Los generadores de texto y de logs nunca producen el
+ *          mensaje de fin de transmisión, que está en mayúsculas. Los
+ *          datos se generan una única vez por conexión: el costo de
+ *          generarlos no se mezcla con el de enviarlos o comprimirlos.
+ *
+ * @param buffer Buffer a llenar.
+ * @param len Cantidad de bytes.
+ * @param gen Generador.
+ * @param seed Semilla (por ejemplo, el PID del proceso).
+ */
+void payload_fill(char *buffer, size_t len, int gen, unsigned int seed)
+{
+    unsigned int state = seed ? seed : 1;
+
+    size_t pos = 0;
+
+    char line[256];
+
+    long int ts_ms = 45296000; // 12:34:56.000
+    long int n_words = (long int)(sizeof(words) / sizeof(words[0]));
+
+    while (pos < len)
+    {
+        size_t n;
+
+        switch (gen)
+        {
+        case _PAYLOAD_RANDOM_:
+        {
+            unsigned int r = next_rand(&state);
+
+            n = sizeof(r);
+
+            memcpy(line, &r, n);
+
+            break;
+        }
+        case _PAYLOAD_TEXT_:
+        {
+            // El menor de dos índices uniformes favorece a las palabras del principio de la lista
+            long int a = next_rand(&state) % n_words;
+            long int b = next_rand(&state) % n_words;
+
+            unsigned int r = next_rand(&state);
+
+            n = (size_t)snprintf(line, sizeof(line), "%s%s", words[(a < b) ? a : b], ((r % 16) == 0) ? ".\n" : (((r % 7) == 0) ? ", " : " "));
+
+            break;
+        }
+        case _PAYLOAD_LOG_:
+        {
+            unsigned int r = next_rand(&state);
+
+            ts_ms += r % 50;
+
+            n = (size_t)snprintf(line, sizeof(line), "2022-04-22 %02ld:%02ld:%02ld.%03ld %-5s [%s-%u] %s conn=%u bytes=%u latency_us=%u\n",
+                                 (ts_ms / 3600000) % 24, (ts_ms / 60000) % 60, (ts_ms / 1000) % 60, ts_ms % 1000,
+                                 levels[r % 7], components[(r >> 3) % 6], (r >> 6) % 16, events[(r >> 10) % 6],
+                                 1000 + ((r >> 12) % 200), next_rand(&state) % 10000, next_rand(&state) % 5000);
+
+            break;
+        }
+        default:
+            line[0] = 'a';
+            n = 1;
+        }
+
+        if (n > (len - pos))
+            n = len - pos;
+
+        memcpy(buffer + pos, line, n);
+
+        pos += n;
+    }
+}
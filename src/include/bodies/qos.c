@@ -0,0 +1,205 @@
+/**
+ * @file qos.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de calidad de servicio (límites de
+ *        velocidad y reparto del presupuesto global entre protocolos)
+ *        para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-18
+ */
+
+#include "../headers/qos.h"
+
+/**
+ * @brief Esta función inicializa el estado de calidad de servicio
+ *        de un handler.
+ *
+ * @param q Estado a inicializar.
+ */
+void qos_init(struct_qos *q)
+{
+    memset(q, 0, sizeof(*q));
+
+    q->last_refill = now_ns();
+}
+
+/**
+ * @brief Esta función recalcula la velocidad vigente del protocolo
+ *        de un handler.
+ *
+ * @details Con presupuesto global, cada protocolo con conexiones activas
+ *          recibe una porción proporcional a su peso: los pesos de los
+ *          protocolos sin conexiones se reparten entre los demás. El
+ *          resultado se acota por el límite propio del protocolo.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param cfg Copia local de la configuración.
+ * @param proto Protocolo del handler.
+ * @param q Estado del handler.
+ */
+void qos_refresh(struct_data *sd, struct_sv_config *cfg, int proto, struct_qos *q)
+{
+    long int rate = cfg->proto_cap[proto];
+
+    if (cfg->global_cap > 0)
+    {
+        int active[_PROTOS_] = {0};
+
+        for (int i = 0; i < _MAX_CONNS_; i++)
+            if ((__atomic_load_n(&sd->conns[i].pid, __ATOMIC_ACQUIRE) != 0) && (sd->conns[i].proto >= 0) && (sd->conns[i].proto < _PROTOS_))
+                active[sd->conns[i].proto] = 1;
+
+        // El protocolo propio siempre participa (su conexión podría no tener entrada en la tabla)
+        active[proto] = 1;
+
+        long int weights = 0;
+
+        for (int p = 0; p < _PROTOS_; p++)
+            if (active[p])
+                weights += cfg->weight[p];
+
+        long int share = (weights > 0) ? ((cfg->global_cap * cfg->weight[proto]) / weights) : cfg->global_cap;
+
+        if (share < 1)
+            share = 1;
+
+        if ((rate == 0) || (share < rate))
+            rate = share;
+    }
+
+    q->class_rate = rate;
+    q->last_refresh = now_ns();
+}
+
+/**
+ * @brief Esta función acota el tamaño de una lectura según los límites
+ *        vigentes, para no leer de una vez más de lo que corresponde a
+ *        la ráfaga admitida.
+ *
+ * @param cfg Copia local de la configuración.
+ * @param proto Protocolo del handler.
+ * @param q Estado del handler.
+ * @param size Tamaño de lectura configurado.
+ *
+ * @return El tamaño de lectura a utilizar.
+ */
+size_t qos_read_size(struct_sv_config *cfg, int proto, struct_qos *q, size_t size)
+{
+    // Con límite por conexión, nunca se lee más de lo permitido en un segundo
+    if ((cfg->rate_cap[proto] > 0) && ((long int)size > cfg->rate_cap[proto]))
+        size = (size_t)cfg->rate_cap[proto];
+
+    long int burst = (q->class_rate * _QOS_BURST_NS_) / 1000000000L;
+
+    if ((q->class_rate > 0) && ((long int)size > burst))
+        size = (size_t)((burst > 0) ? burst : 1);
+
+    return size;
+}
+
+/**
+ * @brief Esta función descuenta los bytes leídos de las cubetas de la
+ *        conexión y de su protocolo.
+ *
+ * @details La cubeta del protocolo es compartida por todos sus handlers
+ *          y se implementa como un algoritmo de tasa genérica de celdas
+ *          (GCRA): un único instante teórico de llegada por protocolo,
+ *          que cada handler avanza con una operación CAS, sin locks.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param cfg Copia local de la configuración.
+ * @param proto Protocolo del handler.
+ * @param q Estado del handler.
+ * @param bytes Bytes leídos.
+ *
+ * @return Nanosegundos que el handler debe esperar antes de volver a leer.
+ */
+long int qos_account(struct_data *sd, struct_sv_config *cfg, int proto, struct_qos *q, long int bytes)
+{
+    long int now = now_ns();
+    long int wait_ns = 0;
+
+    if ((now - q->last_refresh) >= _QOS_REFRESH_NS_)
+        qos_refresh(sd, cfg, proto, q);
+
+    // Cubeta local de la conexión
+    if (cfg->rate_cap[proto] > 0)
+    {
+        long int elapsed = now - q->last_refill;
+
+        /*
+         * La cubeta admite un segundo de tráfico: tras un segundo o más sin
+         * leer, se llena. Si no, la tasa se separa en segundos y resto para
+         * que ningún producto desborde un long, con cualquier tasa.
+         */
+        if (elapsed >= 1000000000L)
+            q->tokens = cfg->rate_cap[proto];
+        else
+            q->tokens += ((cfg->rate_cap[proto] / 1000000000L) * elapsed) + (((cfg->rate_cap[proto] % 1000000000L) * elapsed) / 1000000000L);
+
+        if (q->tokens > cfg->rate_cap[proto])
+            q->tokens = cfg->rate_cap[proto];
+
+        q->tokens -= bytes;
+
+        if (q->tokens < 0)
+            wait_ns = (-q->tokens * 1000000000L) / cfg->rate_cap[proto];
+    }
+
+    q->last_refill = now;
+
+    // Cubeta compartida del protocolo
+    if (q->class_rate > 0)
+    {
+        long int *tat = &sd->qos_tat[proto];
+
+        long int inc = (bytes * 1000000000L) / q->class_rate;
+
+        long int old = __atomic_load_n(tat, __ATOMIC_RELAXED);
+        long int next;
+
+        do
+            next = ((old > now) ? old : now) + inc;
+        while (!__atomic_compare_exchange_n(tat, &old, next, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+        if ((next - now - _QOS_BURST_NS_) > wait_ns)
+            wait_ns = next - now - _QOS_BURST_NS_;
+    }
+
+    return wait_ns;
+}
+
+/**
+ * @brief Esta función detiene al handler el tiempo indicado y lo
+ *        registra como tiempo de espera por límites de velocidad.
+ *
+ * @details Mientras el handler no lee, el buffer de recepción del kernel
+ *          se llena y la ventana TCP frena al emisor, sin descartar datos.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param proto Protocolo del handler.
+ * @param conn Entrada de la conexión en la tabla (puede ser NULL).
+ * @param wait_ns Nanosegundos a esperar.
+ *
+ * @return Los nanosegundos efectivamente esperados.
+ */
+long int qos_throttle(struct_data *sd, int proto, struct_conn *conn, long int wait_ns)
+{
+    if (wait_ns <= 0)
+        return 0;
+
+    struct timespec ts = {.tv_sec = wait_ns / 1000000000L, .tv_nsec = wait_ns % 1000000000L};
+
+    long int start = now_ns();
+
+    nanosleep(&ts, NULL);
+
+    long int slept = now_ns() - start;
+
+    stats_add(&sd->proto[proto].throttled_ns, slept);
+
+    if (conn)
+        stats_add(&conn->throttled_ns, slept);
+
+    return slept;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file report.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de los informes de envío de los
+ *        clientes para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-26
+ */
+
+#include "../headers/report.h"
+
+/**
+ * @brief Esta función interpreta el nombre de un formato de informes.
+ *
+ * @param name Nombre del formato ("text", "csv" o "json").
+ *
+ * @return El formato, o -1 si el nombre es inválido.
+ */
+int report_parse_format(char *name)
+{
+    if (strcmp(name, "text") == 0)
+        return _REPORT_TEXT_;
+
+    if (strcmp(name, "csv") == 0)
+        return _REPORT_CSV_;
+
+    if (strcmp(name, "json") == 0)
+        return _REPORT_JSON_;
+
+    return -1;
+}
+
+/**
+ * @brief Esta función escribe el encabezado de un formato de informes,
+ *        si lo tiene (sólo el CSV).
+ *
+ * @param buf Buffer donde se escribirá el encabezado.
+ * @param len Tamaño del buffer.
+ * @param fmt Formato de los informes.
+ *
+ * @return La cantidad de caracteres escritos (0 si el formato no tiene encabezado).
+ */
+int report_header(char *buf, size_t len, int fmt)
+{
+    if (fmt != _REPORT_CSV_)
+        return 0;
+
+    return snprintf(buf, len, "kind,pid,time_s,elapsed_s,bytes,payload,sends,partial,eagain,blocked_ns,mbps,msgs,msgs_per_s,syscalls_per_msg,queue_us\n");
+}
+
+/**
+ * @brief Esta función escribe un informe de envío de una conexión.
+ *
+ * @details Se informan los bytes enviados y los de datos, las llamadas
+ *          a send, los envíos parciales y, si se midieron, los envíos
+ *          rechazados por tener el buffer de envío lleno y el tiempo
+ *          bloqueado esperando lugar. La velocidad se calcula como en el
+ *          log del servidor (megabits por segundo de bytes enviados),
+ *          para poder comparar ambos extremos.
+ *
+ *          En el modo de mensajes chicos se agregan los mensajes lógicos
+ *          por segundo, las llamadas a send por mensaje (el costo que el
+ *          agrupamiento reduce) y la espera promedio de cada mensaje en
+ *          su lote (la latencia que el agrupamiento agrega).
+ *
+ * @param buf Buffer donde se escribirá el informe (terminado en '\n').
+ * @param len Tamaño del buffer.
+ * @param fmt Formato de los informes.
+ * @param kind Tipo de informe ("report" o "summary").
+ * @param prev Contadores al inicio del intervalo.
+ * @param curr Contadores al final del intervalo.
+ * @param t Segundos desde que se estableció la conexión.
+ * @param elapsed Duración del intervalo, en segundos.
+ * @param measured Datos medidos además de los básicos (_REPORT_TIMED_ y/o _REPORT_MSGS_).
+ *
+ * @return La cantidad de caracteres escritos.
+ */
+int report_format(char *buf, size_t len, int fmt, char *kind, struct_cl_stats *prev, struct_cl_stats *curr, double t, double elapsed, int measured)
+{
+    long int bytes = curr->bytes - prev->bytes;
+    long int payload = curr->payload - prev->payload;
+    long int sends = curr->sends - prev->sends;
+    long int partial = curr->partial - prev->partial;
+    long int eagain = curr->eagain - prev->eagain;
+    long int blocked_ns = curr->blocked_ns - prev->blocked_ns;
+    long int msgs = curr->msgs - prev->msgs;
+
+    double mbps = (elapsed > 0) ? (((double)bytes * 8) / 1e6) / elapsed : 0.0;
+    double msgs_per_s = (elapsed > 0) ? ((double)msgs / elapsed) : 0.0;
+    double per_msg = (msgs > 0) ? ((double)sends / (double)msgs) : 0.0;
+    double queue_us = (msgs > 0) ? (((double)(curr->queue_ns - prev->queue_ns) / (double)msgs) / 1e3) : 0.0;
+
+    int timed = (measured & _REPORT_TIMED_);
+    int msg_mode = (measured & _REPORT_MSGS_);
+
+    int pid = getpid();
+
+    // Los datos no medidos quedan vacíos (CSV) o en null (JSON)
+    char timed_txt[64] = "";
+    char msgs_txt[128] = "";
+
+    switch (fmt)
+    {
+    case _REPORT_CSV_:
+        if (timed)
+            snprintf(timed_txt, sizeof(timed_txt), "%ld,%ld", eagain, blocked_ns);
+        else
+            strcpy(timed_txt, ",");
+
+        if (msg_mode)
+            snprintf(msgs_txt, sizeof(msgs_txt), "%ld,%.1f,%.4f,%.1f", msgs, msgs_per_s, per_msg, queue_us);
+        else
+            strcpy(msgs_txt, ",,,");
+
+        return snprintf(buf, len, "%s,%d,%.3f,%.3f,%ld,%ld,%ld,%ld,%s,%.1f,%s\n", kind, pid, t, elapsed, bytes, payload, sends, partial, timed_txt, mbps, msgs_txt);
+
+    case _REPORT_JSON_:
+        if (timed)
+            snprintf(timed_txt, sizeof(timed_txt), "\"eagain\":%ld,\"blocked_ns\":%ld", eagain, blocked_ns);
+        else
+            strcpy(timed_txt, "\"eagain\":null,\"blocked_ns\":null");
+
+        if (msg_mode)
+            snprintf(msgs_txt, sizeof(msgs_txt), "\"msgs\":%ld,\"msgs_per_s\":%.1f,\"syscalls_per_msg\":%.4f,\"queue_us\":%.1f", msgs, msgs_per_s, per_msg, queue_us);
+        else
+            strcpy(msgs_txt, "\"msgs\":null,\"msgs_per_s\":null,\"syscalls_per_msg\":null,\"queue_us\":null");
+
+        return snprintf(buf, len, "{\"kind\":\"%s\",\"pid\":%d,\"time_s\":%.3f,\"elapsed_s\":%.3f,\"bytes\":%ld,\"payload\":%ld,\"sends\":%ld,\"partial\":%ld,"
+                                  "%s,\"mbps\":%.1f,%s}\n",
+                        kind, pid, t, elapsed, bytes, payload, sends, partial, timed_txt, mbps, msgs_txt);
+
+    default:
+    {
+        int n = snprintf(buf, len, "[PID: %d] <CLIENT> %s %.1fs: %.1f[Mbit/s], %ld bytes (%ld of data), %ld sends (%.0f[B/send]), %ld partial",
+                         pid, (strcmp(kind, "summary") == 0) ? "Summary after" : "Report at", t, mbps, bytes, payload, sends,
+                         (sends > 0) ? ((double)bytes / (double)sends) : 0.0, partial);
+
+        if ((n < 0) || ((size_t)n >= len))
+            return n;
+
+        if (timed && ((size_t)n < len))
+            n += snprintf(buf + n, len - (size_t)n, ", %ld EAGAIN, %.1f%% blocked", eagain,
+                          (elapsed > 0) ? ((100.0 * (double)blocked_ns) / (elapsed * 1e9)) : 0.0);
+
+        if (msg_mode && ((size_t)n < len))
+            n += snprintf(buf + n, len - (size_t)n, ", %.0f[msgs/s], %.4f[syscalls/msg], %.1f[us] queued per msg", msgs_per_s, per_msg, queue_us);
+
+        if ((size_t)n < (len - 1))
+        {
+            buf[n++] = '\n';
+            buf[n] = '\0';
+        }
+
+        return n;
+    }
+    }
+}
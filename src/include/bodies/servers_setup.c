@@ -10,313 +10,1598 @@
 #include "../headers/servers_setup.h"
 
 /**
- * @brief Este método se encarga de reiniciar las
- *        estadísticas de datos recibidos en
- *        cada uno de los protocolos del servidor.
+ * @brief Esta función toma una copia local de la configuración
+ *        compartida y aplica a la conexión los cambios necesarios.
  *
- * @param sd Puntero a estructura de velocidades de comunicación a reiniciar.
+ * @param sd Puntero a estructura de estadísticas compartida.
+ * @param cfg Estructura donde se almacenará la copia.
+ * @param cl_socket_fd Descriptor del socket del cliente.
+ *
+ * @return La generación de la configuración copiada.
+ */
+static unsigned int reload_config(struct_data *sd, struct_sv_config *cfg, int cl_socket_fd)
+{
+    unsigned int generation = __atomic_load_n(&sd->cfg.generation, __ATOMIC_ACQUIRE);
+
+    memcpy(cfg, &sd->cfg, sizeof(*cfg));
+
+    if ((cfg->read_size <= 0) || (cfg->read_size > (_MAX_BUFF_SIZE_ - 1)))
+        cfg->read_size = _MAX_BUFF_SIZE_ - 1;
+
+    if ((cfg->rcvbuf > 0) && (setsockopt(cl_socket_fd, SOL_SOCKET, SO_RCVBUF, &cfg->rcvbuf, sizeof(cfg->rcvbuf)) == -1))
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed trying to set receive buffer size");
+
+    return generation;
+}
+
+/**
+ * @brief Esta función toma una muestra de TCP_INFO de una conexión y
+ *        la suma a las estadísticas de su protocolo.
+ *
+ * @details Del lado del servidor sólo tienen sentido los campos de
+ *          recepción: el RTT estimado por el receptor (o, si todavía
+ *          no hay uno, el del establecimiento), la ventana de recepción,
+ *          si la cola de recepción está acumulando datos sin leer y los
+ *          paquetes recibidos fuera de orden desde la muestra anterior.
+ *
+ * @param fd Descriptor de la conexión.
+ * @param ps Contadores del protocolo de la conexión.
+ * @param conn Entrada de la conexión (NULL si no tiene).
+ * @param ooo Paquetes fuera de orden de la muestra anterior.
+ */
+static void tcp_publish(int fd, struct_proto_stats *ps, struct_conn *conn, unsigned int *ooo)
+{
+    struct_tcp_sample s;
+
+    if (tcpinfo_sample(fd, &s) == -1)
+        return;
+
+    unsigned int rtt = s.rcv_rtt_us ? s.rcv_rtt_us : s.rtt_us;
+
+    stats_add(&ps->tcp_samples, 1);
+    stats_add(&ps->rcv_rtt_us, rtt);
+    stats_add(&ps->rcv_space, s.rcv_space);
+    stats_add(&ps->backlogged, tcpinfo_backlogged(&s));
+    stats_add(&ps->ooo_pkts, s.ooo - *ooo);
+
+    *ooo = s.ooo;
+
+    if (conn)
+    {
+        __atomic_store_n(&conn->rcv_rtt_us, (int)rtt, __ATOMIC_RELAXED);
+        __atomic_store_n(&conn->rcv_space, (int)s.rcv_space, __ATOMIC_RELAXED);
+        __atomic_store_n(&conn->inq, s.inq, __ATOMIC_RELAXED);
+        __atomic_store_n(&conn->ooo_pkts, (long int)s.ooo, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Esta función mide la memoria residente propia del handler
+ *        que la invoca: la que el servidor no usaría sin él.
+ *
+ * @details Un proceso handler cuesta sus páginas privadas residentes
+ *          (las que no son de archivos ni de memoria compartida, según
+ *          /proc/self/statm): su pila, sus buffers y las páginas que
+ *          copió del listener al escribirlas. Un hilo handler cuesta
+ *          sólo las páginas residentes de su pila (según mincore) y sus
+ *          buffers. En ningún caso se cuentan las tablas de páginas ni
+ *          las estructuras del kernel.
+ *
+ * @param extra Bytes de los buffers propios del handler (sólo se suman si es un hilo).
+ *
+ * @return La memoria residente, en bytes, o -1 si no pudo medirse.
+ */
+static long int handler_rss(size_t extra)
+{
+    long int page = sysconf(_SC_PAGESIZE);
+
+    if (getpid() == (int)gettid())
+    {
+        char buf[128];
+
+        long int size, resident, shared;
+
+        int fd = open("/proc/self/statm", (O_RDONLY | O_CLOEXEC));
+
+        ssize_t len = (fd != -1) ? read(fd, buf, (sizeof(buf) - 1)) : -1;
+
+        if (fd != -1)
+            close(fd);
+
+        if (len <= 0)
+            return -1;
+
+        buf[len] = '\0';
+
+        return (sscanf(buf, "%ld %ld %ld", &size, &resident, &shared) == 3) ? ((resident - shared) * page) : -1;
+    }
+
+    pthread_attr_t attr;
+
+    void *stack;
+
+    size_t stack_size;
+
+    if (pthread_getattr_np(pthread_self(), &attr) != 0)
+        return -1;
+
+    int found = (pthread_attr_getstack(&attr, &stack, &stack_size) == 0);
+
+    pthread_attr_destroy(&attr);
+
+    if (!found)
+        return -1;
+
+    // Páginas residentes de la pila, consultadas en bloques para no agrandarla con el vector
+    unsigned char vec[256];
+
+    size_t pages = stack_size / (size_t)page;
+
+    long int resident = 0;
+
+    for (size_t i = 0; i < pages; i += sizeof(vec))
+    {
+        size_t n = ((pages - i) < sizeof(vec)) ? (pages - i) : sizeof(vec);
+
+        if (mincore((char *)stack + (i * (size_t)page), (n * (size_t)page), vec) == -1)
+            return -1;
+
+        for (size_t j = 0; j < n; j++)
+            resident += (vec[j] & 1);
+    }
+
+    return (resident * page) + (long int)extra;
+}
+
+/**
+ * @brief Esta función mide la memoria residente propia de un handler y
+ *        la suma a las estadísticas de su protocolo.
+ *
+ * @param ps Contadores del protocolo de la conexión.
+ * @param conn Entrada de la conexión (NULL si no tiene).
+ * @param extra Bytes de los buffers propios del handler.
+ */
+static void rss_publish(struct_proto_stats *ps, struct_conn *conn, size_t extra)
+{
+    long int rss = handler_rss(extra);
+
+    if (rss == -1)
+        return;
+
+    stats_add(&ps->rss_bytes, rss);
+    stats_add(&ps->rss_samples, 1);
+
+    if (conn)
+        __atomic_store_n(&conn->rss_kb, (int)(rss / 1024), __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Esta función suma a los contadores compartidos de un protocolo
+ *        los bytes que un handler acumuló localmente.
+ *
+ * @param ps Contadores del protocolo de la conexión.
+ * @param ep Contadores del extremo de escucha de la conexión (puede ser NULL).
+ * @param pend Contadores locales del handler; quedan en cero.
+ */
+static void fold_pending(struct_proto_stats *ps, struct_endpoint *ep, struct_proto_stats *pend)
+{
+    if (pend->bytes != 0)
+    {
+        stats_add(&ps->bytes, pend->bytes);
+
+        if (ep)
+            stats_add(&ep->bytes, pend->bytes);
+    }
+
+    if (pend->comp_bytes != 0)
+    {
+        stats_add(&ps->comp_bytes, pend->comp_bytes);
+        stats_add(&ps->raw_bytes, pend->raw_bytes);
+    }
+
+    pend->bytes = 0;
+    pend->comp_bytes = 0;
+    pend->raw_bytes = 0;
+}
+
+/**
+ * @brief Atención de un cliente conectado.
+ *
+ * @details Se ejecuta en el proceso hijo o en el hilo creado para el
+ *          cliente (ver run_listener), y vuelve al terminar la conexión.
+ *          Antes de reservar el buffer de recepción se fija la
+ *          afinidad del handler, de modo que el buffer quede en
+ *          el nodo NUMA de la CPU que lo va a utilizar. Se leen
+ *          mensajes hasta recibir el mensaje de fin de transmisión.
+ *
+ *          El estado de la conexión (buffer, canales, ventana de
+ *          descompresión) no se guarda en la pila: así, la de un hilo
+ *          handler puede ser chica.
+ *
+ *          Los bytes recibidos se acumulan en contadores locales del
+ *          handler y se vuelcan en lotes a los del protocolo y a los del
+ *          extremo de escucha, que comparten todos los handlers (procesos
+ *          e hilos).
+ *
+ *          La configuración modificable en tiempo de ejecución se lee
+ *          de una copia local, que sólo se recarga cuando cambia la
+ *          generación publicada por el proceso principal.
+ *
+ *          Si el cliente comienza con el saludo de una conexión
+ *          multiplexada, la conexión transporta tramas de varios canales
+ *          lógicos: se contabilizan sólo los bytes de datos, por canal
+ *          y por protocolo, y se devuelven créditos a cada canal.
+ *
+ *          Si, en cambio, comienza con el saludo de una conexión
+ *          comprimida, se cuentan los bytes recibidos y, además, los
+ *          que resultan de descomprimir cada bloque.
+ *
+ * @param cl_socket_fd Descriptor del socket del cliente.
+ * @param proto Protocolo de la conexión.
+ * @param ep Extremo de escucha que aceptó la conexión (-1 si no tiene estadísticas propias).
+ * @param peer Descripción del extremo remoto.
+ * @param accept_ns Instante en que el listener aceptó la conexión.
+ * @param sd Puntero a estructura de estadísticas compartida.
+ * @param aff Configuración de afinidad de CPU del servidor.
+ */
+void serve_client(int cl_socket_fd, int proto, int ep, char *peer, long int accept_ns, struct_data *sd, struct_affinity *aff)
+{
+    pin_handler(cl_socket_fd, aff);
+
+    char *buffer = alloc_local_buffer(_MAX_BUFF_SIZE_);
+
+    // Bytes recibidos todavía no sumados a los contadores del protocolo
+    struct_proto_stats pend;
+
+    memset(&pend, 0, sizeof(pend));
+
+    int threaded = (getpid() != (int)gettid());
+
+    struct_conn *conn = stats_conn_claim(sd, proto, peer);
+
+    struct_endpoint *eps = (ep >= 0) ? &sd->endpoints[ep] : NULL;
+
+    if (conn)
+        __atomic_store_n(&conn->endpoint, ep, __ATOMIC_RELAXED);
+
+    struct_sv_config cfg;
+
+    unsigned int generation = reload_config(sd, &cfg, cl_socket_fd);
+
+    // Registro de eventos: NULL mientras esté deshabilitado
+    char label[_TRACE_LABEL_LEN_];
+
+    snprintf(label, sizeof(label), "handler %s %s", proto_name(proto), peer);
+
+    struct_trace_ring *tr = cfg.trace ? trace_ring(_TRACE_HANDLER_, proto, label) : NULL;
+
+    long int received = 0;
+
+    /*
+     * El consumo de recursos del handler se publica en lotes: consultar al
+     * kernel en cada lectura costaría más que la lectura misma.
+     */
+    int schedstat_fd = open("/proc/thread-self/schedstat", (O_RDONLY | O_CLOEXEC));
+
+    struct_usage usage;
+
+    stats_usage_sample(&usage, schedstat_fd);
+
+    long int reads = 0;
+    long int last_flush = now_ns();
+
+    // Muestreo de TCP_INFO (sólo en conexiones TCP), junto con la publicación del consumo
+    int tcp = (proto != _PROTO_LOCAL_);
+
+    long int last_tcp = last_flush;
+
+    unsigned int ooo = 0;
+
+    // La memoria residente del handler se mide una vez, en la primera publicación del consumo
+    int rss_done = 0;
+
+    // Límites de velocidad de la conexión, de su protocolo y presupuesto global
+    struct_qos qos;
+
+    qos_init(&qos);
+    qos_refresh(sd, &cfg, proto, &qos);
+
+    // Latencia de establecimiento: creación del proceso o del hilo, afinidad, buffer y configuración
+    stats_add(&sd->proto[proto].accepts, 1);
+    stats_add(&sd->proto[proto].setup_ns, now_ns() - accept_ns);
+
+    if (eps)
+        stats_add(&eps->accepts, 1);
+
+    if (threaded)
+        stats_add(&sd->proto[proto].threads, 1);
+
+    TRACE(tr, _TRACE_START_, now_ns() - accept_ns);
+
+    // Canales lógicos, si la conexión es multiplexada, o bloques comprimidos
+    struct_mux *mux = NULL;
+    struct_lz_stream *lz = NULL;
+
+    int channels = mux_accept(cl_socket_fd);
+    int compressed = (channels == 0) ? lz_accept(cl_socket_fd) : 0;
+
+    size_t own = _MAX_BUFF_SIZE_;
+
+    int done = (channels == -1) || (compressed == -1);
+
+    if (done)
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, (channels == -1) ? "Invalid multiplexed connection hello" : "Invalid compressed connection hello");
+    else if (compressed)
+    {
+        lz = alloc_local_buffer(sizeof(*lz));
+        own += sizeof(*lz);
+
+        lz_init(lz);
+
+        if (conn)
+            conn->compressed = 1;
+    }
+    else if (channels > 0)
+    {
+        mux = alloc_local_buffer(sizeof(*mux));
+        own += sizeof(*mux);
+
+        mux_init(mux, channels);
+
+        for (int i = 0; i < channels; i++)
+        {
+            struct_chan *chan = stats_chan_claim(sd, i);
+
+            mux->acc[i] = chan ? &chan->bytes : NULL;
+        }
+
+        if (conn)
+            conn->channels = channels;
+
+        stats_add(&sd->proto[proto].channels, channels);
+    }
+
+    if (!done)
+        evlog(_EVLOG_DEBUG_, "connect", proto, "Client %s ready after %ldus (%s)", peer, (now_ns() - accept_ns) / 1000,
+              compressed ? "compressed" : ((channels > 0) ? "multiplexed" : "plain"));
+
+    while (!done)
+    {
+        if (__atomic_load_n(&sd->cfg.generation, __ATOMIC_ACQUIRE) != generation)
+        {
+            generation = reload_config(sd, &cfg, cl_socket_fd);
+
+            qos_refresh(sd, &cfg, proto, &qos);
+
+            tr = cfg.trace ? trace_ring(_TRACE_HANDLER_, proto, label) : NULL;
+        }
+
+        size_t to_read = qos_read_size(&cfg, proto, &qos, (size_t)cfg.read_size);
+
+        ssize_t aux = read(cl_socket_fd, buffer, to_read);
+
+        if (aux == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            // Un error fatal terminaría también a los demás hilos del listener: sólo termina esta conexión
+            show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed receiving message");
+
+            break;
+        }
+
+        reads++;
+
+        TRACE(tr, _TRACE_READ_, aux);
+
+        // Bytes de datos: en conexiones multiplexadas no se cuentan los encabezados de las tramas
+        long int payload = aux;
+
+        // Fin de transmisión explícito, o cierre de la conexión por parte del cliente
+        if (aux == 0)
+            break;
+        else if (channels > 0)
+        {
+            if ((payload = mux_feed(mux, cl_socket_fd, buffer, (size_t)aux, !cfg.paused)) == -1)
+            {
+                show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Invalid frame received on multiplexed connection");
+
+                break;
+            }
+
+            done = mux->closed;
+        }
+        else if (compressed)
+        {
+            long int raw = lz_feed(lz, buffer, (size_t)aux);
+
+            if (raw == -1)
+            {
+                show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Invalid block received on compressed connection");
+
+                break;
+            }
+
+            if (!cfg.paused)
+            {
+                pend.comp_bytes += aux;
+                pend.raw_bytes += raw;
+
+                if (conn)
+                    __atomic_store_n(&conn->raw_bytes, conn->raw_bytes + raw, __ATOMIC_RELAXED);
+            }
+
+            done = lz->closed;
+        }
+        else if (is_eot(buffer, aux))
+            break;
+
+        received += payload;
+
+        if (!cfg.paused)
+        {
+            pend.bytes += payload;
+
+            if (conn)
+                __atomic_store_n(&conn->bytes, conn->bytes + payload, __ATOMIC_RELAXED);
+        }
+
+        /*
+         * Los contadores locales se vuelcan cada _USAGE_CHECK_READS_ lecturas o
+         * cuando una lectura no llenó el buffer: el handler está al día con su
+         * cliente, y una operación atómica más no cambia su velocidad.
+         */
+        if (((size_t)aux < to_read) || ((reads % _USAGE_CHECK_READS_) == 0))
+            fold_pending(&sd->proto[proto], eps, &pend);
+
+        if ((reads % _USAGE_CHECK_READS_) == 0)
+        {
+            long int now = now_ns();
+
+            if ((now - last_flush) >= _USAGE_FLUSH_NS_)
+            {
+                stats_usage_flush(&sd->proto[proto], &usage, reads, schedstat_fd);
+
+                reads = 0;
+                last_flush = now;
+
+                if (!rss_done)
+                {
+                    rss_publish(&sd->proto[proto], conn, own);
+
+                    rss_done = 1;
+                }
+
+                if (tcp && ((now - last_tcp) >= _TCPINFO_NS_))
+                {
+                    tcp_publish(cl_socket_fd, &sd->proto[proto], conn, &ooo);
+
+                    last_tcp = now;
+                }
+            }
+        }
+
+        /*
+         * Si se superó algún límite, se deja de leer hasta recuperar los tokens
+         * consumidos: el buffer de recepción del kernel se llena y la ventana
+         * TCP frena al emisor, sin descartar datos.
+         */
+        if ((cfg.rate_cap[proto] > 0) || (qos.class_rate > 0))
+        {
+            long int slept = qos_throttle(sd, proto, conn, qos_account(sd, &cfg, proto, &qos, aux));
+
+            if (slept > 0)
+                TRACE(tr, _TRACE_THROTTLE_, slept);
+        }
+    }
+
+    TRACE(tr, _TRACE_EOT_, received);
+
+    trace_release();
+
+    fold_pending(&sd->proto[proto], eps, &pend);
+
+    stats_usage_flush(&sd->proto[proto], &usage, reads, schedstat_fd);
+
+    if (!rss_done)
+        rss_publish(&sd->proto[proto], conn, own);
+
+    close(cl_socket_fd);
+
+    evlog(_EVLOG_INFO_, "disconnect", proto, "Client %s disconnected after %.2fs, %ld bytes received", peer, (double)(now_ns() - accept_ns) / 1e9, received);
+
+    // Primero la entrada y luego el lugar: si el handler muere en el medio, el lugar se pierde pero nunca se libera dos veces
+    stats_conn_release(conn);
+
+    admit_release(sd, proto);
+
+    if (channels > 0)
+        stats_chan_release(sd);
+
+    free_local_buffer(buffer, _MAX_BUFF_SIZE_);
+
+    if (mux)
+        free_local_buffer(mux, sizeof(*mux));
+
+    if (lz)
+        free_local_buffer(lz, sizeof(*lz));
+
+    if (schedstat_fd != -1)
+        close(schedstat_fd);
+}
+
+/**
+ * @brief Esta función informa un error en la creación de un socket
+ *        de escucha y libera el descriptor, si llegó a crearse.
+ *
+ * @param socket_fd Descriptor a cerrar (-1 si no hay).
+ * @param msg Mensaje de error.
+ *
+ * @return Siempre -1, para devolverlo directamente.
+ */
+static int listener_fail(int socket_fd, char *msg)
+{
+    show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, msg);
+
+    if (socket_fd != -1)
+        close(socket_fd);
+
+    return -1;
+}
+
+/**
+ * @brief Esta función interpreta un extremo de escucha de un protocolo.
+ *
+ * @details El extremo es el archivo de socket (protocolo local), o un
+ *          número de puerto con una dirección opcional: 'PORT' escucha
+ *          en todas las direcciones, 'ADDR:PORT' (IPv4) o '[ADDR]:PORT'
+ *          (IPv6) sólo en la especificada.
+ *
+ * @param proto Protocolo del extremo.
+ * @param target Extremo a interpretar.
+ * @param addr Dirección resultante.
+ *
+ * @return 0 Si el extremo es válido.
+ *        -1 En caso contrario.
+ */
+int endpoint_parse(int proto, char *target, struct sockaddr_storage *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+
+    if (proto == _PROTO_LOCAL_)
+    {
+        struct sockaddr_un *un = (struct sockaddr_un *)addr;
+
+        if ((*target == '\0') || (strlen(target) >= sizeof(un->sun_path)))
+            return -1;
+
+        un->sun_family = AF_UNIX;
+
+        strcpy(un->sun_path, target);
+
+        return 0;
+    }
+
+    char host[INET6_ADDRSTRLEN] = "";
+
+    char *port = target;
+
+    if ((proto == _PROTO_IPV6_) && (*target == '['))
+    {
+        char *end = strstr(target, "]:");
+
+        if (!end || ((size_t)(end - target - 1) >= sizeof(host)))
+            return -1;
+
+        memcpy(host, target + 1, (size_t)(end - target - 1));
+        host[end - target - 1] = '\0';
+
+        port = end + 2;
+    }
+    else if ((proto == _PROTO_IPV4_) && strchr(target, ':'))
+    {
+        char *end = strchr(target, ':');
+
+        if ((size_t)(end - target) >= sizeof(host))
+            return -1;
+
+        memcpy(host, target, (size_t)(end - target));
+        host[end - target] = '\0';
+
+        port = end + 1;
+    }
+
+    char *rest;
+
+    long int number = strtol(port, &rest, 10);
+
+    if ((*port == '\0') || (*rest != '\0') || (number <= 0) || (number > 65535))
+        return -1;
+
+    if (proto == _PROTO_IPV4_)
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)addr;
+
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t)number);
+        in->sin_addr.s_addr = INADDR_ANY;
+
+        return ((*host != '\0') && (inet_pton(AF_INET, host, &in->sin_addr) != 1)) ? -1 : 0;
+    }
+
+    if (proto == _PROTO_IPV6_)
+    {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)addr;
+
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = (in_port_t)htons((uint16_t)number);
+        in6->sin6_addr = in6addr_any;
+
+        return ((*host != '\0') && (inet_pton(AF_INET6, host, &in6->sin6_addr) != 1)) ? -1 : 0;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Se crea el socket de escucha de un extremo de cualquier
+ *        protocolo (ver endpoint_parse).
+ *
+ * @param proto Protocolo del extremo.
+ * @param target Archivo de socket, o puerto con dirección opcional.
+ *
+ * @return El descriptor del socket, ya ligado y escuchando, o -1 si el
+ *         extremo es inválido o no pudo crearse.
+ */
+int mk_listener(int proto, char *target)
+{
+    struct sockaddr_storage addr;
+
+    if (endpoint_parse(proto, target, &addr) == -1)
+        return listener_fail(-1, "Invalid listening endpoint");
+
+    if (proto == _PROTO_LOCAL_)
+        return mk_local_listener(target);
+
+    if (proto == _PROTO_IPV4_)
+        return mk_ipv4_listener(((struct sockaddr_in *)&addr)->sin_addr, ntohs(((struct sockaddr_in *)&addr)->sin_port));
+
+    return mk_ipv6_listener(((struct sockaddr_in6 *)&addr)->sin6_addr, ntohs(((struct sockaddr_in6 *)&addr)->sin6_port));
+}
+
+/**
+ * @brief Se crea el socket de escucha TCP/IPv4.
+ *
+ * @param ip Dirección en la que escuchar (INADDR_ANY para todas).
+ * @param port Número de puerto a utilizar para la conexión.
+ *
+ * @return El descriptor del socket, ya ligado y escuchando, o -1 si no
+ *         pudo crearse (por ejemplo, si el puerto ya está en uso).
+ */
+int mk_ipv4_listener(struct in_addr ip, uint16_t port)
+{
+    struct sockaddr_in struct_sv;
+
+    int socket_fd;
+
+    // Creación del socket
+    if ((socket_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+        return listener_fail(-1, "Failed in socket creation {IPv4}");
+
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) == -1)
+        return listener_fail(socket_fd, "Failed trying to set port as reusable {IPv4}");
+
+    // Inicialización de la estructura del servidor
+    memset(&struct_sv, 0, sizeof(struct_sv));
+
+    struct_sv.sin_family = AF_INET;
+    struct_sv.sin_addr = ip;
+    struct_sv.sin_port = htons(port);
+
+    // Binding del socket del server
+    if (bind(socket_fd, (struct sockaddr *)&struct_sv, sizeof(struct_sv)) == -1)
+        return listener_fail(socket_fd, "Failed binding socket {IPv4}");
+
+    if (listen(socket_fd, 5) == -1) // Máximo 5 clientes en espera simultánea
+        return listener_fail(socket_fd, "Failed trying to listen to socket {IPv4}");
+
+    return socket_fd;
+}
+
+/**
+ * @brief Se crea el socket de escucha TCP/IPv6.
+ *
+ * @param ip Dirección en la que escuchar (in6addr_any para todas).
+ * @param port Número de puerto a utilizar para la conexión.
+ *
+ * @return El descriptor del socket, ya ligado y escuchando, o -1 si no
+ *         pudo crearse (por ejemplo, si el puerto ya está en uso).
+ */
+int mk_ipv6_listener(struct in6_addr ip, uint16_t port)
+{
+    struct sockaddr_in6 struct_sv;
+
+    int socket_fd;
+
+    // Creación del socket
+    if ((socket_fd = socket(AF_INET6, SOCK_STREAM, 0)) == -1)
+        return listener_fail(-1, "Failed in socket creation {IPv6}");
+
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) == -1)
+        return listener_fail(socket_fd, "Failed trying to set port as reusable {IPv6}");
+
+    // Inicialización de la estructura del servidor
+    memset(&struct_sv, 0, sizeof(struct_sv));
+
+    struct_sv.sin6_family = AF_INET6;
+    struct_sv.sin6_port = (in_port_t)htons(port);
+    struct_sv.sin6_addr = ip;
+
+    // Binding del socket del server
+    if (bind(socket_fd, (struct sockaddr *)&struct_sv, sizeof(struct_sv)) == -1)
+        return listener_fail(socket_fd, "Failed binding socket {IPv6}");
+
+    if (listen(socket_fd, 5) == -1) // Máximo 5 clientes en espera simultánea
+        return listener_fail(socket_fd, "Failed trying to listen to socket {IPv6}");
+
+    return socket_fd;
+}
+
+/**
+ * @brief Se crea el socket de escucha TCP local.
+ *
+ * @param socket_file Nombre del archivo a utilizar para la
+ *                    comunicación entre cliente y servidor.
+ *
+ * @return El descriptor del socket, ya ligado y escuchando, o -1 si no
+ *         pudo crearse.
+ */
+int mk_local_listener(char *socket_file)
+{
+    unlink(socket_file); // Desligamos el archivo en caso de ya existir de corridas anteriores
+
+    struct sockaddr_un struct_sv;
+
+    socklen_t sv_len;
+
+    int socket_fd;
+
+    // Creación del socket
+    if ((socket_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+        return listener_fail(-1, "Failed in socket creation {LOCAL}");
+
+    // Inicialización de la estructura del servidor
+    memset(&struct_sv, 0, sizeof(struct_sv));
+    struct_sv.sun_family = AF_UNIX;
+    strncpy(struct_sv.sun_path, socket_file, (sizeof(struct_sv.sun_path) - 1));
+
+    sv_len = (socklen_t)(strlen(struct_sv.sun_path) + sizeof(struct_sv.sun_family));
+
+    // Binding del socket del server
+    if (bind(socket_fd, (struct sockaddr *)&struct_sv, sv_len) == -1)
+        return listener_fail(socket_fd, "Failed binding socket {LOCAL}");
+
+    if (listen(socket_fd, 5) == -1) // Máximo 5 clientes en espera simultánea
+        return listener_fail(socket_fd, "Failed trying to listen to socket {LOCAL}");
+
+    return socket_fd;
+}
+
+/**
+ * @brief Esta función indica si un socket de escucha (por ejemplo,
+ *        uno heredado de otra instancia) corresponde al extremo
+ *        especificado.
+ *
+ * @details Un extremo sin dirección sólo corresponde a un socket que
+ *          escucha en todas las direcciones, y viceversa.
+ *
+ * @param socket_fd Descriptor del socket de escucha.
+ * @param proto Protocolo del socket.
+ * @param target Archivo de socket, o puerto con dirección opcional.
+ *
+ * @return 1 Si el socket corresponde al extremo especificado.
+ *         0 En caso contrario.
+ */
+int listener_matches(int socket_fd, int proto, char *target)
+{
+    struct sockaddr_storage addr, want;
+
+    socklen_t len = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+
+    if ((getsockname(socket_fd, (struct sockaddr *)&addr, &len) == -1) || (endpoint_parse(proto, target, &want) == -1) ||
+        (addr.ss_family != want.ss_family))
+        return 0;
+
+    switch (proto)
+    {
+    case _PROTO_LOCAL_:
+        return strcmp(((struct sockaddr_un *)&addr)->sun_path, ((struct sockaddr_un *)&want)->sun_path) == 0;
+    case _PROTO_IPV4_:
+    {
+        struct sockaddr_in *a = (struct sockaddr_in *)&addr;
+        struct sockaddr_in *w = (struct sockaddr_in *)&want;
+
+        return (a->sin_port == w->sin_port) && (a->sin_addr.s_addr == w->sin_addr.s_addr);
+    }
+    case _PROTO_IPV6_:
+    {
+        struct sockaddr_in6 *a = (struct sockaddr_in6 *)&addr;
+        struct sockaddr_in6 *w = (struct sockaddr_in6 *)&want;
+
+        return (a->sin6_port == w->sin6_port) && (memcmp(&a->sin6_addr, &w->sin6_addr, sizeof(a->sin6_addr)) == 0);
+    }
+    default:
+        return 0;
+    }
+}
+
+// Estado del listener del proceso actual (cada listener es un proceso)
+static int ls_fd = -1;                       // Socket de escucha
+static volatile sig_atomic_t ls_stop = 0;    // Se recibió SIGTERM: dejar de aceptar clientes
+static int ls_threads = 0;                   // Hilos handler en curso
+static int ls_spare_fd = -1;                 // Descriptor de reserva, para descartar conexiones sin descriptores libres
+static int ls_max_threads = 0;               // Hilos handler que admiten los descriptores del listener (0: aún no calculado)
+
+/**
+ * @brief Handler para la señal SIGTERM de un listener.
+ *
+ * @details Se cierra el socket de escucha (close es segura dentro de un
+ *          handler): si la señal llega justo antes de accept, la llamada
+ *          falla en lugar de bloquearse. El socket sigue abierto en el
+ *          proceso principal, o en la instancia que lo recibió durante un
+ *          reinicio en caliente. Una segunda señal termina el listener
+ *          sin esperar a sus hilos handler.
+ *
+ * @param signal Señal recibida.
+ */
+static void ls_handler(int signal)
+{
+    (void)signal;
+
+    if (ls_stop)
+        _exit(EXIT_SUCCESS);
+
+    ls_stop = 1;
+
+    close(ls_fd);
+}
+
+/**
+ * @brief Función de los hilos handler.
+ *
+ * @param arg Argumentos del hilo (struct_handler_args), que se liberan al terminar.
+ *
+ * @return Siempre NULL.
+ */
+static void *handler_thread(void *arg)
+{
+    struct_handler_args *ha = arg;
+
+    serve_client(ha->fd, ha->proto, ha->ep, ha->peer, ha->accept_ns, ha->sd, ha->aff);
+
+    free(ha);
+
+    __atomic_sub_fetch(&ls_threads, 1, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+/**
+ * @brief Esta función crea un hilo handler para una conexión aceptada.
+ *
+ * @details El hilo se crea desacoplado (nadie espera su resultado), con
+ *          la pila configurada y con todas las señales bloqueadas: las
+ *          que recibe el listener las atiende siempre su hilo principal,
+ *          que es el único que puede estar bloqueado en accept.
+ *
+ * @param cl_socket_fd Descriptor del socket del cliente.
+ * @param proto Protocolo de la conexión.
+ * @param ep Extremo de escucha que aceptó la conexión.
+ * @param peer Descripción del extremo remoto (se copia).
+ * @param accept_ns Instante en que el listener aceptó la conexión.
+ * @param sd Puntero a estructura de estadísticas compartida.
+ * @param aff Configuración de afinidad de CPU del servidor.
+ * @param cfg Copia local de la configuración del listener.
+ *
+ * @return 0 Si el hilo se creó.
+ *        -1 Si no pudo crearse.
+ */
+static int spawn_handler_thread(int cl_socket_fd, int proto, int ep, char *peer, long int accept_ns, struct_data *sd, struct_affinity *aff, struct_sv_config *cfg)
+{
+    struct_handler_args *ha = malloc(sizeof(*ha));
+
+    if (!ha)
+        return -1;
+
+    ha->fd = cl_socket_fd;
+    ha->proto = proto;
+    ha->ep = ep;
+    ha->accept_ns = accept_ns;
+    ha->sd = sd;
+    ha->aff = aff;
+
+    strncpy(ha->peer, peer, (_PEER_LEN_ - 1));
+    ha->peer[_PEER_LEN_ - 1] = '\0';
+
+    pthread_attr_t attr;
+
+    pthread_t tid;
+
+    sigset_t all, old;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, ((size_t)thread_stack_kb(cfg) * 1024));
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    __atomic_add_fetch(&ls_threads, 1, __ATOMIC_ACQ_REL);
+
+    int err = pthread_create(&tid, &attr, handler_thread, ha);
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    pthread_attr_destroy(&attr);
+
+    if (err != 0)
+    {
+        __atomic_sub_fetch(&ls_threads, 1, __ATOMIC_RELEASE);
+
+        free(ha);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Esta función descarta una conexión admitida que no pudo
+ *        entregarse a un handler.
+ *
+ * @param sd Puntero a estructura de estadísticas compartida.
+ * @param proto Protocolo de la conexión.
+ * @param eps Extremo de escucha de la conexión (puede ser NULL).
+ * @param cl_socket_fd Descriptor del socket del cliente.
+ * @param msg Mensaje de error.
  */
-void stats_reset(struct_data *sd)
+static void handler_fail(struct_data *sd, int proto, struct_endpoint *eps, int cl_socket_fd, char *msg)
 {
-    sd->local = 0;
-    sd->ipv4 = 0;
-    sd->ipv6 = 0;
-    sd->total = 0;
+    show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, msg);
+
+    admit_release(sd, proto);
+
+    stats_add(&sd->proto[proto].shed, 1);
+
+    if (eps)
+        stats_add(&eps->shed, 1);
+
+    admit_shed(cl_socket_fd);
 }
 
 /**
- * @brief Este método se encarga de sumar las
- *        estadísticas de datos recibidos en
- *        cada uno de los protocolos del servidor.
+ * @brief Esta función atiende un error de accept por falta de
+ *        descriptores o de memoria.
+ *
+ * @details Sin descriptores libres (EMFILE, ENFILE), la conexión sigue
+ *          en la cola del socket de escucha y accept volvería a fallar
+ *          de inmediato: se libera el descriptor de reserva para poder
+ *          aceptarla y descartarla, como a cualquier conexión que supera
+ *          los límites. Sin memoria (ENOBUFS, ENOMEM), la conexión queda
+ *          en la cola. En ambos casos, el listener espera un instante
+ *          antes de volver a aceptar, en lugar de terminar y dejar sin
+ *          atender a las conexiones nuevas (y, en el modo de hilos, a
+ *          las que ya atiende).
  *
- * @param sd Puntero a estructura de velocidades de comunicación
- *           de la cual se obtendrán los resultados.
+ * @param socket_fd Descriptor del socket de escucha.
+ * @param proto Protocolo del socket.
+ * @param sd Puntero a estructura de estadísticas compartida.
+ * @param eps Extremo de escucha del socket (puede ser NULL).
+ * @param err Error de accept.
  */
-void stats_sum(struct_data *sd)
+static void accept_exhausted(int socket_fd, int proto, struct_data *sd, struct_endpoint *eps, int err)
 {
-    long int sum = 0;
+    int shed = 0;
+
+    if (((err == EMFILE) || (err == ENFILE)) && (ls_spare_fd != -1))
+    {
+        close(ls_spare_fd);
 
-    sum += sd->local;
-    sum += sd->ipv4;
-    sum += sd->ipv6;
+        int fd = accept(socket_fd, NULL, NULL);
 
-    sd->total = sum;
+        if (fd != -1)
+        {
+            admit_shed(fd);
+
+            shed = 1;
+        }
+    }
+
+    // Se repone la reserva (o se intenta obtenerla, si antes no se pudo)
+    if ((ls_spare_fd == -1) || (err == EMFILE) || (err == ENFILE))
+        ls_spare_fd = open("/dev/null", (O_RDONLY | O_CLOEXEC));
+
+    if (shed)
+    {
+        stats_add(&sd->proto[proto].shed, 1);
+
+        if (eps)
+            stats_add(&eps->shed, 1);
+    }
+
+    evlog(_EVLOG_WARN_, "exhausted", proto, "Failed trying to accept client (%s), %s", strerror(err), shed ? "connection shed" : "retrying");
+
+    struct timespec ts = {0, _ACCEPT_BACKOFF_NS_};
+
+    nanosleep(&ts, NULL);
 }
 
 /**
- * @brief Se inicializa la conexión TCP/IPv4.
+ * @brief Se atienden las conexiones entrantes a un socket de escucha.
  *
- * @details Se inicia la conexión TCP/IPv4 y por cada
- *          cliente que se conecte al servidor mediante
- *          este protocolo, se crea un hilo hijo para
- *          escuchar los mensajes que el cliente envíe.
+ * @details Por cada cliente que se conecte al servidor mediante este
+ *          socket, se crea un handler para escuchar los mensajes que el
+ *          cliente envíe: un proceso hijo o, según la configuración
+ *          vigente, un hilo de este proceso con una pila chica, que se
+ *          crea mucho más rápido y no duplica las tablas de páginas. El
+ *          socket de escucha lo crea el proceso principal, de modo que
+ *          pueda entregárselo a otra instancia durante un reinicio en
+ *          caliente.
  *
- * @param port Número de puerto a utilizar para la conexión.
- * @param acc Acumulador donde se registrarán la cantidad de bytes
- *            recibidos en los mensajes de los clientes conectados.
+ *          Antes de crear el handler, cada conexión pasa por el control
+ *          de admisión: si se superan los límites de conexiones o de
+ *          memoria, se descarta (o se la hace esperar) sin crear handlers,
+ *          de modo que una ráfaga de conexiones no afecte a los clientes
+ *          ya conectados. Si el sistema no puede crear el handler, o no
+ *          quedan descriptores para aceptar la conexión, también se
+ *          descarta, en lugar de terminar el listener.
+ *
+ *          Al recibir SIGTERM (reinicio en caliente o 'unlisten'), el
+ *          listener deja de aceptar clientes y termina cuando sus hilos
+ *          handler terminan de atender a los suyos, igual que los
+ *          procesos handler, que no dependen del listener. Si termina
+ *          el proceso principal, el kernel termina al listener.
+ *
+ * @param socket_fd Descriptor del socket de escucha.
+ * @param proto Protocolo del socket.
+ * @param ep Entrada del socket en la tabla de extremos de escucha (-1 si no tiene).
+ * @param sd Puntero a estructura de estadísticas compartida.
+ * @param aff Configuración de afinidad de CPU del servidor.
  */
-void startup_ipv4_sv(uint16_t port, long int *acc)
+void run_listener(int socket_fd, int proto, int ep, struct_data *sd, struct_affinity *aff)
 {
-    struct sockaddr_in struct_sv;
-    struct sockaddr_in struct_cl;
+    struct sockaddr_storage struct_cl;
 
-    socklen_t client_len = sizeof(struct_cl);
+    socklen_t client_len;
 
-    int socket_fd;
+    char *tag = proto_tag(proto);
 
-    char buffer[_MAX_BUFF_SIZE_];
+    struct_endpoint *eps = (ep >= 0) ? &sd->endpoints[ep] : NULL;
 
-    // Creación del socket
-    if ((socket_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed in socket creation {IPv4}");
+    if (pin_to_cpus(aff, &aff->listener_cpus) == -1)
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed trying to pin listener to CPU set");
 
-    if(setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) == -1)
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to set port as reusable {IPv6}");
+    ls_fd = socket_fd;
 
-    // Inicialización de la estructura del servidor
-    memset(&struct_sv, 0, sizeof(struct_sv));
+    // Sin SA_RESTART: la señal interrumpe accept
+    struct sigaction sa;
 
-    struct_sv.sin_family = AF_INET;
-    struct_sv.sin_addr.s_addr = INADDR_ANY;
-    struct_sv.sin_port = htons(port);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = ls_handler;
 
-    // Binding del socket del server
-    if (bind(socket_fd, (struct sockaddr *)&struct_sv, sizeof(struct_sv)) == -1)
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed binding socket {IPv4}");
+    if (sigaction(SIGTERM, &sa, NULL) == -1)
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to assign handler to signal SIGTERM");
 
-    if (listen(socket_fd, 5) == -1) // Máximo 5 clientes en espera simultánea
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to listen to socket {IPv4}");
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    fprintf(stdout, "[PID: %d] <SERVER@%s> Available %s\n", getpid(), tag, listener_desc(socket_fd));
+
+    char label[_TRACE_LABEL_LEN_];
 
-    fprintf(stdout, "[PID: %d] <SERVER@IPv4> Available port: %d\n", getpid(), htons(struct_sv.sin_port));
+    snprintf(label, sizeof(label), "listener %s", listener_desc(socket_fd));
 
-    while (1)
+    // Copia local de la configuración para el control de admisión (se recarga al cambiar la generación)
+    struct_sv_config cfg;
+
+    memcpy(&cfg, &sd->cfg, sizeof(cfg));
+
+    ls_spare_fd = open("/dev/null", (O_RDONLY | O_CLOEXEC));
+
+    while (!ls_stop)
     {
+        client_len = sizeof(struct_cl);
+
         // Se esperan conexiones
         int cl_socket_fd = accept(socket_fd, (struct sockaddr *)&struct_cl, &client_len);
 
         if (cl_socket_fd == -1)
-            show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to accept client {IPv4}");
+        {
+            if (ls_stop)
+                break;
 
-        // Por cada conexión, se crea un proceso hijo que reciba los mensajes
-        int ch_pid = fork();
+            // El cliente abortó la conexión antes de que se aceptara
+            if ((errno == EINTR) || (errno == ECONNABORTED))
+                continue;
 
-        if (ch_pid == -1)
-            show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on process forking for client handling {IPv4}");
+            if ((errno == EMFILE) || (errno == ENFILE) || (errno == ENOBUFS) || (errno == ENOMEM))
+            {
+                accept_exhausted(socket_fd, proto, sd, eps, errno);
 
-        if (ch_pid == 0)
+                continue;
+            }
+
+            show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to accept client");
+        }
+
+        long int accept_ns = now_ns();
+
+        struct_trace_ring *tr = __atomic_load_n(&sd->cfg.trace, __ATOMIC_RELAXED) ? trace_ring(_TRACE_LISTENER_, proto, label) : NULL;
+
+        if (!admit_wait(sd, &cfg, proto))
         {
-            // Proceso hijo
-            close(socket_fd);
+            if (eps)
+                stats_add(&eps->shed, 1);
 
-            while (1)
+            admit_shed(cl_socket_fd);
+
+            continue;
+        }
+
+        /*
+         * Por cada conexión, se crea un hilo o un proceso hijo que reciba los
+         * mensajes. Mientras queden hilos handler, se siguen creando hilos aunque
+         * se haya vuelto al modo de procesos: fork sólo copia al hilo que lo
+         * invoca, y el hijo heredaría los locks (por ejemplo, los de malloc)
+         * que los demás tuvieran tomados, sin nadie que los libere.
+         */
+        if ((cfg.handler_mode == _HANDLER_THREAD_) || (__atomic_load_n(&ls_threads, __ATOMIC_ACQUIRE) > 0))
+        {
+            /*
+             * Todas las conexiones del listener comparten sus descriptores: al
+             * crear el primer hilo se eleva el límite (el modo pudo cambiar en
+             * tiempo de ejecución) y se calcula cuántos hilos admite.
+             */
+            if (!ls_max_threads)
             {
-                memset(buffer, 0, _MAX_BUFF_SIZE_);
+                long int nofile = raise_nofile();
 
-                ssize_t aux = read(cl_socket_fd, buffer, (_MAX_BUFF_SIZE_ - 1));
+                ls_max_threads = (nofile > (_LISTENER_FDS_ + _THREAD_FDS_)) ? (int)((nofile - _LISTENER_FDS_) / _THREAD_FDS_) : 1;
+            }
 
-                if (aux == -1)
-                    show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed receiving message {IPv4}");
+            if (__atomic_load_n(&ls_threads, __ATOMIC_ACQUIRE) >= ls_max_threads)
+            {
+                handler_fail(sd, proto, eps, cl_socket_fd, "Too many handler threads for the open files limit, connection shed");
 
-                if (strcmp(buffer, _EOT_MSG_) == 0)
-                {
-                    close(cl_socket_fd);
+                continue;
+            }
 
-                    exit(EXIT_FAILURE);
-                }
+            if (spawn_handler_thread(cl_socket_fd, proto, ep, peer_desc(&struct_cl), accept_ns, sd, aff, &cfg) == -1)
+            {
+                handler_fail(sd, proto, eps, cl_socket_fd, "Failed on thread creation for client handling, connection shed");
 
-                *acc += aux;
+                continue;
             }
+
+            TRACE(tr, _TRACE_ACCEPT_, 0);
+
+            evlog(_EVLOG_INFO_, "accept", proto, "New client accepted, managed by a handler thread");
+
+            continue;
+        }
+
+        int ch_pid = fork();
+
+        if (ch_pid == -1)
+        {
+            handler_fail(sd, proto, eps, cl_socket_fd, "Failed on process forking for client handling, connection shed");
+
+            continue;
+        }
+
+        if (ch_pid == 0)
+        {
+            // Proceso hijo (fork no le hereda PR_SET_PDEATHSIG, pero sí el handler de SIGTERM)
+            close(socket_fd);
+            close(ls_spare_fd);
+
+            signal(SIGTERM, SIG_DFL);
+
+            serve_client(cl_socket_fd, proto, ep, peer_desc(&struct_cl), accept_ns, sd, aff);
+
+            exit(EXIT_FAILURE);
         }
         else
         {
             // Proceso padre
-            fprintf(stdout, "[PID: %d] <SERVER@IPv4> New client accepted, managed by subprocess #%d.\n", getpid(), ch_pid);
+            TRACE(tr, _TRACE_ACCEPT_, ch_pid);
+
+            // El mensaje se encola: una terminal lenta o un pipe lleno no frenan la aceptación
+            evlog(_EVLOG_INFO_, "accept", proto, "New client accepted, managed by child process #%d", ch_pid);
 
             close(cl_socket_fd);
         }
     }
+
+    // Los hilos handler terminan con el proceso: se espera a que atiendan a sus clientes
+    int pending = __atomic_load_n(&ls_threads, __ATOMIC_ACQUIRE);
+
+    if (pending > 0)
+        evlog(_EVLOG_INFO_, "drain", proto, "Listener stopped, waiting for %d handler threads", pending);
+
+    struct timespec ts = {0, _DRAIN_POLL_NS_};
+
+    while (__atomic_load_n(&ls_threads, __ATOMIC_ACQUIRE) > 0)
+        nanosleep(&ts, NULL);
+
+    exit(EXIT_SUCCESS);
 }
 
 /**
- * @brief Se inicializa la conexión TCP/IPv6.
+ * @brief Se crea el proceso que atiende las conexiones de un listener.
  *
- * @details Se inicia la conexión TCP/IPv6 y por cada
- *          cliente que se conecte al servidor mediante
- *          este protocolo, se crea un hilo hijo para
- *          escuchar los mensajes que el cliente envíe.
+ * @details Antes de crearlo se reserva la entrada del socket en la tabla
+ *          de extremos de escucha, que el listener hereda. El proceso hijo
+ *          cierra los descriptores que sólo le sirven al proceso principal
+ *          (los demás sockets de escucha y los sockets de reinicio en
+ *          caliente y de control), para que sus handlers no los hereden.
  *
- * @param port Número de puerto a utilizar para la conexión.
- * @param acc Acumulador donde se registrarán la cantidad de bytes
- *            recibidos en los mensajes de los clientes conectados.
+ * @param sv Estado del proceso principal del servidor.
+ * @param idx Índice del listener a lanzar.
+ *
+ * @return El PID del proceso creado.
  */
-void startup_ipv6_sv(uint16_t port, long int *acc)
+int spawn_listener(struct_server *sv, int idx)
 {
-    struct sockaddr_in6 struct_sv;
-    struct sockaddr_in6 struct_cl;
+    sv->ls[idx].ep = stats_endpoint_claim(sv->sd, sv->ls[idx].proto, endpoint_name(sv->ls[idx].fd));
 
-    socklen_t client_len = sizeof(struct_cl);
+    if (sv->ls[idx].ep == -1)
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Endpoint table is full, the new listener will not have its own stats");
 
-    int socket_fd;
+    fflush(stdout);
 
-    char buffer[_MAX_BUFF_SIZE_];
+    int pid = fork();
 
-    // Creación del socket
-    if ((socket_fd = socket(AF_INET6, SOCK_STREAM, 0)) == -1)
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed in socket creation {IPv6}");
+    if (pid == -1)
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on process forking for listener");
 
-    if(setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) == -1)
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to set port as reusable {IPv6}");
+    if (pid == 0)
+    {
+        for (int i = 0; i < sv->n_ls; i++)
+            if (i != idx)
+                close(sv->ls[i].fd);
 
-    // Inicialización de la estructura del servidor
-    memset(&struct_sv, 0, sizeof(struct_sv));
+        if (sv->hfd != -1)
+            close(sv->hfd);
 
-    struct_sv.sin6_family = AF_INET6;
-    struct_sv.sin6_port = (in_port_t)htons(port);
-    struct_sv.sin6_addr = in6addr_any;
+        if (sv->cfd != -1)
+            close(sv->cfd);
 
-    // Binding del socket del server
-    if (bind(socket_fd, (struct sockaddr *)&struct_sv, sizeof(struct_sv)) == -1)
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed binding socket {IPv6}");
+        if (sv->cconn != -1)
+            close(sv->cconn);
 
-    if (listen(socket_fd, 5) == -1) // Máximo 5 clientes en espera simultánea
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to listen to socket {IPv6}");
+        // Los listeners mueren con SIGINT; SIGTERM la maneja run_listener, para esperar a sus hilos handler
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+
+        run_listener(sv->ls[idx].fd, sv->ls[idx].proto, sv->ls[idx].ep, sv->sd, &sv->aff);
+    }
+
+    sv->ls[idx].pid = pid;
+
+    return pid;
+}
+
+/**
+ * @brief Esta función agrega un listener a una instancia en ejecución.
+ *
+ * @param sv Estado del proceso principal del servidor.
+ * @param proto Protocolo del nuevo listener.
+ * @param target Archivo de socket, o puerto con dirección opcional (ver endpoint_parse).
+ *
+ * @return 0 Si el listener se creó y ya está aceptando clientes.
+ *        -1 Si no pudo crearse.
+ */
+int add_listener(struct_server *sv, int proto, char *target)
+{
+    if (sv->n_ls == _MAX_LISTENERS_)
+        return -1;
+
+    int fd = mk_listener(proto, target);
 
-    fprintf(stdout, "[PID: %d] <SERVER@IPv6> Available port: %d\n", getpid(), htons(struct_sv.sin6_port));
+    if (fd == -1)
+        return -1;
 
-    while (1)
+    struct_listener *l = &sv->ls[sv->n_ls];
+
+    l->proto = proto;
+    l->fd = fd;
+    l->primary = 0;
+
+    spawn_listener(sv, sv->n_ls++);
+
+    return 0;
+}
+
+/**
+ * @brief Esta función quita un listener de una instancia en ejecución.
+ *
+ * @details Las conexiones ya aceptadas por el listener no se ven
+ *          afectadas: sus handlers siguen atendiéndolas (y sumando sus
+ *          bytes a los del extremo, que conserva sus contadores).
+ *
+ * @param sv Estado del proceso principal del servidor.
+ * @param proto Protocolo del listener.
+ * @param target Archivo de socket, o puerto con dirección opcional (ver endpoint_parse).
+ *
+ * @return 0 Si el listener se quitó.
+ *        -1 Si no existe un listener con esos datos.
+ */
+int remove_listener(struct_server *sv, int proto, char *target)
+{
+    for (int i = 0; i < sv->n_ls; i++)
     {
-        // Se esperan conexiones
-        int cl_socket_fd = accept(socket_fd, (struct sockaddr *)&struct_cl, &client_len);
+        if ((sv->ls[i].proto != proto) || !listener_matches(sv->ls[i].fd, proto, target))
+            continue;
 
-        if (cl_socket_fd == -1)
-            show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to accept client {IPv6}");
+        kill(sv->ls[i].pid, SIGTERM);
 
-        // Por cada conexión, se crea un proceso hijo que reciba los mensajes
-        int cp_ipv6_pid = fork();
+        stats_endpoint_release(sv->sd, sv->ls[i].ep);
 
-        if (cp_ipv6_pid == -1)
-            show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on process forking for client handling {IPv6}");
+        close(sv->ls[i].fd);
 
-        if (cp_ipv6_pid == 0)
-        {
-            // Proceso hijo
-            close(socket_fd);
+        if (proto == _PROTO_LOCAL_)
+            unlink(target);
 
-            while (1)
-            {
-                memset(buffer, 0, _MAX_BUFF_SIZE_);
+        sv->ls[i] = sv->ls[--sv->n_ls];
 
-                ssize_t aux = read(cl_socket_fd, buffer, (_MAX_BUFF_SIZE_ - 1));
+        return 0;
+    }
 
-                if (aux == -1)
-                    show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed receiving message {IPv6}");
+    return -1;
+}
 
-                if (strcmp(buffer, _EOT_MSG_) == 0)
-                {
-                    close(cl_socket_fd);
+/**
+ * @brief Esta función describe el extremo remoto de una conexión.
+ *
+ * @param addr Dirección del extremo remoto, tal como la devuelve accept.
+ *
+ * @return Cadena estática con la dirección y el puerto del cliente.
+ */
+char *peer_desc(struct sockaddr_storage *addr)
+{
+    static char desc[_PEER_LEN_];
 
-                    exit(EXIT_FAILURE);
-                }
+    char ip[INET6_ADDRSTRLEN];
 
-                *acc += aux;
-            }
-        }
-        else
-        {
-            // Proceso padre
-            fprintf(stdout, "[PID: %d] <SERVER@IPv6> New client accepted, managed by child process #%d.\n", getpid(), cp_ipv6_pid);
+    if (addr->ss_family == AF_INET)
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)addr;
 
-            close(cl_socket_fd);
-        }
+        inet_ntop(AF_INET, &in->sin_addr, ip, sizeof(ip));
+
+        snprintf(desc, sizeof(desc), "%s:%d", ip, ntohs(in->sin_port));
+    }
+    else if (addr->ss_family == AF_INET6)
+    {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)addr;
+
+        inet_ntop(AF_INET6, &in6->sin6_addr, ip, sizeof(ip));
+
+        snprintf(desc, sizeof(desc), "[%s]:%d", ip, ntohs(in6->sin6_port));
     }
+    else
+        snprintf(desc, sizeof(desc), "local");
+
+    return desc;
 }
 
 /**
- * @brief Se inicializa la conexión TCP local.
+ * @brief Esta función interpreta el nombre de un modo de los handlers.
  *
- * @param socket_file Nombre del archivo a utilizar para la
- *                    comunicación entre cliente y servidor.
- * @param acc Acumulador donde se registrarán la cantidad de bytes
- *            recibidos en los mensajes de los clientes conectados.
+ * @param name Nombre del modo ("process" o "thread").
+ *
+ * @return El modo, o -1 si el nombre es inválido.
  */
-void startup_local_sv(char *socket_file, long int *acc)
+int handler_mode_parse(char *name)
 {
-    unlink(socket_file); // Desligamos el archivo en caso de ya existir de corridas anteriores
+    if (strcmp(name, "process") == 0)
+        return _HANDLER_PROCESS_;
 
-    struct sockaddr_un struct_sv;
-    struct sockaddr_un struct_cl;
+    if (strcmp(name, "thread") == 0)
+        return _HANDLER_THREAD_;
 
-    socklen_t sv_len;
-    socklen_t client_len = sizeof(struct_cl);
+    return -1;
+}
 
-    int socket_fd;
+/**
+ * @brief Esta función devuelve el nombre de un modo de los handlers.
+ *
+ * @param mode Modo de los handlers.
+ *
+ * @return El nombre del modo.
+ */
+char *handler_mode_name(int mode)
+{
+    return (mode == _HANDLER_THREAD_) ? "thread" : "process";
+}
 
-    char buffer[_MAX_BUFF_SIZE_];
+/**
+ * @brief Esta función devuelve la pila vigente de los hilos handler.
+ *
+ * @param cfg Configuración vigente.
+ *
+ * @return El tamaño de la pila, en KB.
+ */
+int thread_stack_kb(struct_sv_config *cfg)
+{
+    return (cfg->thread_stack > 0) ? cfg->thread_stack : _THREAD_STACK_KB_;
+}
 
-    // Creación del socket
-    if ((socket_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed in socket creation {LOCAL}");
+/**
+ * @brief Esta función eleva el límite blando de descriptores abiertos
+ *        (RLIMIT_NOFILE) del proceso hasta el límite duro.
+ *
+ * @details En el modo de hilos, cada conexión ocupa descriptores del
+ *          listener, y el límite blando por defecto (usualmente 1024)
+ *          se agota mucho antes que la memoria. Los procesos creados
+ *          después heredan el nuevo límite.
+ *
+ * @return El límite blando vigente, o -1 si no pudo obtenerse.
+ */
+long int raise_nofile(void)
+{
+    struct rlimit rl;
 
-    // Inicialización de la estructura del servidor
-    memset(&struct_sv, 0, sizeof(struct_sv));
-    struct_sv.sun_family = AF_UNIX;
-    strcpy(struct_sv.sun_path, socket_file);
+    if (getrlimit(RLIMIT_NOFILE, &rl) == -1)
+        return -1;
 
-    sv_len = (socklen_t)(strlen(struct_sv.sun_path) + sizeof(struct_sv.sun_family));
+    if (rl.rlim_cur < rl.rlim_max)
+    {
+        rlim_t cur = rl.rlim_cur;
 
-    // Binding del socket del server
-    if (bind(socket_fd, (struct sockaddr *)&struct_sv, sv_len) == -1)
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed binding socket {LOCAL}");
+        rl.rlim_cur = rl.rlim_max;
 
-    if (listen(socket_fd, 5) == -1) // Máximo 5 clientes en espera simultánea
-        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to listen to socket {LOCAL}");
+        if (setrlimit(RLIMIT_NOFILE, &rl) == -1)
+            rl.rlim_cur = cur;
+    }
 
-    fprintf(stdout, "[PID: %d] <SERVER@LOCAL> Available socket: %s\n", getpid(), struct_sv.sun_path);
+    return ((rl.rlim_cur == RLIM_INFINITY) || (rl.rlim_cur > (rlim_t)__INT_MAX__)) ? __INT_MAX__ : (long int)rl.rlim_cur;
+}
 
-    while (1)
+/**
+ * @brief Esta función devuelve la etiqueta de un protocolo
+ *        utilizada en los mensajes del servidor.
+ *
+ * @param proto Índice del protocolo.
+ *
+ * @return La etiqueta del protocolo.
+ */
+char *proto_tag(int proto)
+{
+    switch (proto)
     {
-        // Se esperan conexiones
-        int cl_socket_fd = accept(socket_fd, (struct sockaddr *)&struct_cl, &client_len);
+    case _PROTO_LOCAL_:
+        return "LOCAL";
+    case _PROTO_IPV4_:
+        return "IPv4";
+    case _PROTO_IPV6_:
+        return "IPv6";
+    default:
+        return "UNKNOWN";
+    }
+}
 
-        if (cl_socket_fd == -1)
-            show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to accept client {LOCAL}");
+/**
+ * @brief Esta función describe la dirección en la que escucha un socket.
+ *
+ * @param socket_fd Descriptor del socket de escucha.
+ *
+ * @return Cadena estática con el puerto (y la dirección, si no escucha
+ *         en todas) o el archivo de socket.
+ */
+char *listener_desc(int socket_fd)
+{
+    static char desc[_ENDPOINT_LEN_ + 16];
 
-        // Por cada conexión, se crea un proceso hijo que reciba los mensajes
-        int cp_ipv4_pid = fork();
+    struct sockaddr_storage addr;
 
-        if (cp_ipv4_pid == -1)
-            show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on process forking for client handling {LOCAL}");
+    socklen_t len = sizeof(addr);
 
-        if (cp_ipv4_pid == 0)
-        {
-            // Proceso hijo
-            close(socket_fd);
+    memset(&addr, 0, sizeof(addr));
 
-            while (1)
-            {
-                memset(buffer, 0, _MAX_BUFF_SIZE_);
+    if (getsockname(socket_fd, (struct sockaddr *)&addr, &len) == -1)
+        return "socket";
 
-                ssize_t aux = read(cl_socket_fd, buffer, (_MAX_BUFF_SIZE_ - 1));
+    char *name = endpoint_name(socket_fd);
 
-                if (aux == -1)
-                    show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed receiving message {LOCAL}");
+    if (addr.ss_family == AF_UNIX)
+        snprintf(desc, sizeof(desc), "socket: %s", name);
+    else if (strchr(name, ':'))
+        snprintf(desc, sizeof(desc), "address: %s", name);
+    else
+        snprintf(desc, sizeof(desc), "port: %s", name);
 
-                if (strcmp(buffer, _EOT_MSG_) == 0)
-                {
-                    close(cl_socket_fd);
+    return desc;
+}
 
-                    exit(EXIT_FAILURE);
-                }
+/**
+ * @brief Esta función obtiene el nombre del extremo en el que escucha
+ *        un socket, con la misma sintaxis con la que se especifica (ver
+ *        endpoint_parse): el archivo de socket, el puerto, o la
+ *        dirección y el puerto.
+ *
+ * @param socket_fd Descriptor del socket de escucha.
+ *
+ * @return Cadena estática con el nombre del extremo (vacía si no pudo
+ *         obtenerse).
+ */
+char *endpoint_name(int socket_fd)
+{
+    static char name[_ENDPOINT_LEN_];
 
-                *acc += aux;
-            }
-        }
+    struct sockaddr_storage addr;
+
+    socklen_t len = sizeof(addr);
+
+    char ip[INET6_ADDRSTRLEN];
+
+    memset(&addr, 0, sizeof(addr));
+
+    name[0] = '\0';
+
+    if (getsockname(socket_fd, (struct sockaddr *)&addr, &len) == -1)
+        return name;
+
+    if (addr.ss_family == AF_UNIX)
+    {
+        struct sockaddr_un *un = (struct sockaddr_un *)&addr;
+
+        // La ruta puede ocupar todo sun_path, sin el caracter nulo
+        snprintf(name, sizeof(name), "%.*s", (int)sizeof(un->sun_path), un->sun_path);
+    }
+    else if (addr.ss_family == AF_INET)
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)&addr;
+
+        if (in->sin_addr.s_addr == INADDR_ANY)
+            snprintf(name, sizeof(name), "%d", ntohs(in->sin_port));
         else
-        {
-            // Proceso padre
-            fprintf(stdout, "[PID: %d] <SERVER@LOCAL> New client accepted managed by child process #%d.\n", getpid(), cp_ipv4_pid);
+            snprintf(name, sizeof(name), "%s:%d", inet_ntop(AF_INET, &in->sin_addr, ip, sizeof(ip)), ntohs(in->sin_port));
+    }
+    else if (addr.ss_family == AF_INET6)
+    {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&addr;
 
-            close(cl_socket_fd);
-        }
+        if (IN6_IS_ADDR_UNSPECIFIED(&in6->sin6_addr))
+            snprintf(name, sizeof(name), "%d", ntohs(in6->sin6_port));
+        else
+            snprintf(name, sizeof(name), "[%s]:%d", inet_ntop(AF_INET6, &in6->sin6_addr, ip, sizeof(ip)), ntohs(in6->sin6_port));
     }
-}
\ No newline at end of file
+
+    return name;
+}
+
+/**
+ * @brief Esta función obtiene el archivo de un socket de escucha local.
+ *
+ * @param socket_fd Descriptor del socket de escucha.
+ *
+ * @return Cadena estática con la ruta del archivo de socket (vacía si
+ *         el socket no es local).
+ */
+char *listener_path(int socket_fd)
+{
+    static struct sockaddr_un addr;
+
+    socklen_t len = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+
+    if ((getsockname(socket_fd, (struct sockaddr *)&addr, &len) == -1) || (addr.sun_family != AF_UNIX))
+        addr.sun_path[0] = '\0';
+
+    return addr.sun_path;
+}
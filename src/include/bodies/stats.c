@@ -0,0 +1,782 @@
+/**
+ * @file stats.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de manejo de la memoria compartida
+ *        POSIX que contiene las estadísticas de cada instancia del
+ *        servidor para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-05
+ */
+
+#include "../headers/stats.h"
+
+/**
+ * @brief Esta función arma el nombre del segmento de memoria
+ *        compartida correspondiente a una instancia.
+ *
+ * @param instance Nombre de la instancia.
+ * @param name Buffer donde se almacenará el nombre del segmento.
+ * @param len Tamaño del buffer.
+ */
+static void stats_shm_name(char *instance, char *name, size_t len)
+{
+    if (snprintf(name, len, "/%s%s", _SHM_PREFIX_, instance) < 0)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed building shared memory name");
+}
+
+/**
+ * @brief Esta función verifica si un segmento de estadísticas existente
+ *        pertenece a una instancia en ejecución.
+ *
+ * @details El segmento se mapea en modo sólo lectura y con su tamaño
+ *          actual, sin modificarlo: puede ser de una instancia viva (de
+ *          esta u otra versión del servidor) o haber quedado de una
+ *          ejecución que no terminó correctamente.
+ *
+ * @param name Nombre del segmento.
+ *
+ * @return 1 Si el segmento pertenece a una instancia viva.
+ *         0 Si no existe o quedó de una ejecución anterior.
+ */
+static int stats_owned(char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd == -1)
+        return 0;
+
+    struct stat st;
+
+    int owned = 0;
+
+    if ((fstat(fd, &st) == 0) && ((size_t)st.st_size >= (offsetof(struct_data, pid) + sizeof(int))))
+    {
+        struct_data *sd = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (sd != MAP_FAILED)
+        {
+            owned = (__atomic_load_n(&sd->magic, __ATOMIC_ACQUIRE) == _STATS_MAGIC_) && (sd->pid != getpid()) && stats_alive(sd);
+
+            munmap(sd, (size_t)st.st_size);
+        }
+    }
+
+    close(fd);
+
+    return owned;
+}
+
+/**
+ * @brief Esta función crea el segmento de estadísticas de una
+ *        instancia del servidor.
+ *
+ * @details Si el segmento existe y su proceso dueño sigue vivo, se trata
+ *          de otra instancia corriendo con el mismo nombre, por lo que se
+ *          aborta antes de modificarlo, en lugar de compartir (y
+ *          corromper) sus contadores. Si quedó de una ejecución que no
+ *          terminó correctamente, se borra y se crea uno nuevo: la
+ *          creación es exclusiva, por lo que de dos instancias que
+ *          arrancan a la vez con el mismo nombre, sólo una lo obtiene.
+ *
+ * @param instance Nombre de la instancia.
+ *
+ * @return Puntero a la estructura de estadísticas mapeada.
+ */
+struct_data *stats_create(char *instance)
+{
+    char name[_INSTANCE_LEN_ + sizeof(_SHM_PREFIX_) + 1];
+
+    stats_shm_name(instance, name, sizeof(name));
+
+    if (stats_owned(name))
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "There is already a running server instance with that name");
+
+    shm_unlink(name);
+
+    int fd = shm_open(name, (O_CREAT | O_EXCL | O_RDWR), 0644);
+
+    if ((fd == -1) && (errno == EEXIST))
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "There is already a running server instance with that name");
+
+    if (fd == -1)
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on shared memory creation process [creation]");
+
+    if (ftruncate(fd, sizeof(struct_data)) == -1)
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on shared memory creation process [sizing]");
+
+    struct_data *sd = mmap(NULL, sizeof(struct_data), (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (sd == MAP_FAILED)
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on shared memory creation process [attachment]");
+
+    sd->version = _STATS_VERSION_;
+    sd->pid = getpid();
+
+    strncpy(sd->instance, instance, (_INSTANCE_LEN_ - 1));
+
+    sd->cfg.log_interval = 1;
+    sd->cfg.read_size = _MAX_BUFF_SIZE_ - 1;
+
+    for (int i = 0; i < _PROTOS_; i++)
+        sd->cfg.weight[i] = 1;
+
+    // El magic se escribe al final para que los lectores nunca vean un segmento a medio inicializar
+    __atomic_store_n(&sd->magic, _STATS_MAGIC_, __ATOMIC_RELEASE);
+
+    return sd;
+}
+
+/**
+ * @brief Esta función mapea en modo sólo lectura el segmento de
+ *        estadísticas de una instancia existente.
+ *
+ * @param instance Nombre de la instancia.
+ *
+ * @return Puntero a la estructura de estadísticas, o NULL si el segmento
+ *         no existe o no corresponde a esta versión del servidor.
+ */
+struct_data *stats_attach(char *instance)
+{
+    char name[_INSTANCE_LEN_ + sizeof(_SHM_PREFIX_) + 1];
+
+    stats_shm_name(instance, name, sizeof(name));
+
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+
+    if ((fstat(fd, &st) == -1) || ((size_t)st.st_size < sizeof(struct_data)))
+    {
+        close(fd);
+
+        return NULL;
+    }
+
+    struct_data *sd = mmap(NULL, sizeof(struct_data), PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (sd == MAP_FAILED)
+        return NULL;
+
+    if ((__atomic_load_n(&sd->magic, __ATOMIC_ACQUIRE) != _STATS_MAGIC_) || (sd->version != _STATS_VERSION_))
+    {
+        munmap(sd, sizeof(struct_data));
+
+        return NULL;
+    }
+
+    return sd;
+}
+
+/**
+ * @brief Esta función abre el segmento de estadísticas de una instancia
+ *        para poder entregárselo a otro proceso (reinicio en caliente).
+ *
+ * @param instance Nombre de la instancia.
+ *
+ * @return El descriptor del segmento, o -1 si no pudo abrirse.
+ */
+int stats_fd(char *instance)
+{
+    char name[_INSTANCE_LEN_ + sizeof(_SHM_PREFIX_) + 1];
+
+    stats_shm_name(instance, name, sizeof(name));
+
+    return shm_open(name, O_RDWR, 0);
+}
+
+/**
+ * @brief Esta función mapea el segmento de estadísticas recibido de
+ *        otra instancia y lo toma como propio.
+ *
+ * @details Los contadores no se reinician: la instancia entrante continúa
+ *          desde el estado de la saliente, cuyos handlers siguen sumando
+ *          sobre el mismo segmento mientras drenan sus conexiones.
+ *
+ * @param fd Descriptor del segmento recibido.
+ *
+ * @return Puntero a la estructura de estadísticas mapeada.
+ */
+struct_data *stats_adopt(int fd)
+{
+    struct_data *sd = mmap(NULL, sizeof(struct_data), (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if ((sd == MAP_FAILED) || (sd->magic != _STATS_MAGIC_) || (sd->version != _STATS_VERSION_))
+        show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed on shared memory adoption process [attachment]");
+
+    __atomic_store_n(&sd->pid, getpid(), __ATOMIC_RELEASE);
+
+    return sd;
+}
+
+/**
+ * @brief Esta función elimina el segmento de estadísticas de una instancia.
+ *
+ * @param instance Nombre de la instancia.
+ */
+void stats_destroy(char *instance)
+{
+    char name[_INSTANCE_LEN_ + sizeof(_SHM_PREFIX_) + 1];
+
+    stats_shm_name(instance, name, sizeof(name));
+
+    if ((shm_unlink(name) == -1) && (errno != ENOENT))
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed trying to remove shared memory segment");
+}
+
+/**
+ * @brief Esta función valida un nombre de instancia: sólo se permiten
+ *        caracteres alfanuméricos, '-' y '_', para que el nombre sea
+ *        utilizable como nombre de segmento en /dev/shm.
+ *
+ * @param instance Nombre de la instancia.
+ *
+ * @return 1 Si el nombre es válido.
+ *         0 Si el nombre es inválido.
+ */
+int stats_valid_instance(char *instance)
+{
+    size_t len = strlen(instance);
+
+    if ((len == 0) || (len >= _INSTANCE_LEN_))
+        return 0;
+
+    for (size_t i = 0; i < len; i++)
+        if (!(((instance[i] >= 'a') && (instance[i] <= 'z')) ||
+              ((instance[i] >= 'A') && (instance[i] <= 'Z')) ||
+              ((instance[i] >= '0') && (instance[i] <= '9')) ||
+              (instance[i] == '-') || (instance[i] == '_')))
+            return 0;
+
+    return 1;
+}
+
+/**
+ * @brief Esta función indica si el proceso dueño de un segmento
+ *        de estadísticas sigue en ejecución.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ *
+ * @return 1 Si el proceso dueño sigue vivo.
+ *         0 Si el segmento quedó huérfano.
+ */
+int stats_alive(struct_data *sd)
+{
+    int pid = __atomic_load_n(&sd->pid, __ATOMIC_RELAXED);
+
+    return (pid > 0) && ((kill(pid, 0) == 0) || (errno == EPERM));
+}
+
+/**
+ * @brief Esta función reserva una entrada libre de la tabla de
+ *        conexiones para el handler que la invoca.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param proto Protocolo de la conexión.
+ * @param peer Descripción del extremo remoto.
+ *
+ * @return Puntero a la entrada reservada, o NULL si la tabla está llena
+ *         (la conexión se atiende igual, pero sin estadísticas propias).
+ */
+struct_conn *stats_conn_claim(struct_data *sd, int proto, char *peer)
+{
+    int pid = (int)gettid();
+
+    for (int i = 0; i < _MAX_CONNS_; i++)
+    {
+        int expected = 0;
+
+        if (__atomic_compare_exchange_n(&sd->conns[i].pid, &expected, pid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            struct_conn *conn = &sd->conns[i];
+
+            conn->proto = proto;
+            conn->start_ns = now_ns();
+
+            __atomic_store_n(&conn->bytes, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&conn->throttled_ns, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&conn->raw_bytes, 0, __ATOMIC_RELAXED);
+
+            conn->channels = 0;
+            conn->compressed = 0;
+            conn->rcv_rtt_us = 0;
+            conn->rcv_space = 0;
+            conn->inq = 0;
+            conn->ooo_pkts = 0;
+            conn->threaded = (pid != getpid());
+            conn->rss_kb = 0;
+            conn->endpoint = -1;
+
+            strncpy(conn->peer, peer, (_PEER_LEN_ - 1));
+            conn->peer[_PEER_LEN_ - 1] = '\0';
+
+            return conn;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Esta función libera una entrada de la tabla de conexiones.
+ *
+ * @param conn Puntero a la entrada (puede ser NULL).
+ */
+void stats_conn_release(struct_conn *conn)
+{
+    if (conn)
+        __atomic_store_n(&conn->pid, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Esta función libera las entradas de las tablas de conexiones
+ *        y de canales cuyos handlers terminaron sin liberarlas (por
+ *        ejemplo, por haber recibido SIGKILL).
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param reaped Si no es NULL, almacena la cantidad de conexiones liberadas.
+ *
+ * @return La cantidad de conexiones activas.
+ */
+int stats_conn_sweep(struct_data *sd, int *reaped)
+{
+    int active = 0;
+    int freed = 0;
+
+    for (int i = 0; i < _MAX_CONNS_; i++)
+    {
+        int pid = __atomic_load_n(&sd->conns[i].pid, __ATOMIC_ACQUIRE);
+
+        if (pid == 0)
+            continue;
+
+        // El lugar que el handler ocupaba en el control de admisión se libera junto con su entrada
+        if ((kill(pid, 0) == -1) && (errno == ESRCH))
+        {
+            int proto = sd->conns[i].proto;
+
+            if (__atomic_compare_exchange_n(&sd->conns[i].pid, &pid, 0, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            {
+                freed++;
+
+                if ((proto >= 0) && (proto < _PROTOS_))
+                    __atomic_sub_fetch(&sd->admitted[proto], 1, __ATOMIC_RELEASE);
+            }
+        }
+        else
+            active++;
+    }
+
+    for (int i = 0; i < _MAX_CHANS_; i++)
+    {
+        int pid = __atomic_load_n(&sd->chans[i].pid, __ATOMIC_ACQUIRE);
+
+        if ((pid != 0) && (kill(pid, 0) == -1) && (errno == ESRCH))
+            __atomic_compare_exchange_n(&sd->chans[i].pid, &pid, 0, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+
+    if (reaped)
+        *reaped = freed;
+
+    return active;
+}
+
+/**
+ * @brief Esta función reserva una entrada libre de la tabla de canales
+ *        para el handler que la invoca.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param channel Número del canal dentro de su conexión.
+ *
+ * @return Puntero a la entrada reservada, o NULL si la tabla está llena.
+ */
+struct_chan *stats_chan_claim(struct_data *sd, int channel)
+{
+    int pid = (int)gettid();
+
+    for (int i = 0; i < _MAX_CHANS_; i++)
+    {
+        int expected = 0;
+
+        if (__atomic_compare_exchange_n(&sd->chans[i].pid, &expected, pid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            struct_chan *chan = &sd->chans[i];
+
+            chan->channel = channel;
+
+            __atomic_store_n(&chan->bytes, 0, __ATOMIC_RELAXED);
+
+            return chan;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Esta función libera todas las entradas de la tabla de canales
+ *        reservadas por el handler que la invoca.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ */
+void stats_chan_release(struct_data *sd)
+{
+    int pid = (int)gettid();
+
+    for (int i = 0; i < _MAX_CHANS_; i++)
+        if (__atomic_load_n(&sd->chans[i].pid, __ATOMIC_RELAXED) == pid)
+            __atomic_store_n(&sd->chans[i].pid, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Esta función reserva la entrada de la tabla de extremos de
+ *        escucha correspondiente a un extremo, y lo marca como activo.
+ *
+ * @details Sólo la invoca el proceso principal, por lo que no compite
+ *          con otros escritores. Si el extremo ya tiene una entrada (de
+ *          un listener anterior), se reutiliza.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param proto Protocolo del extremo.
+ * @param name Nombre del extremo (ver endpoint_name).
+ *
+ * @return El índice de la entrada, o -1 si la tabla está llena (el
+ *         extremo atiende clientes igual, pero sin estadísticas propias).
+ */
+int stats_endpoint_claim(struct_data *sd, int proto, char *name)
+{
+    int free_idx = -1;
+
+    for (int i = 0; i < _MAX_ENDPOINTS_; i++)
+    {
+        struct_endpoint *ep = &sd->endpoints[i];
+
+        if (ep->name[0] == '\0')
+        {
+            if (free_idx == -1)
+                free_idx = i;
+        }
+        else if ((ep->proto == proto) && (strcmp(ep->name, name) == 0))
+        {
+            __atomic_store_n(&ep->active, 1, __ATOMIC_RELEASE);
+
+            return i;
+        }
+    }
+
+    if (free_idx == -1)
+        return -1;
+
+    struct_endpoint *ep = &sd->endpoints[free_idx];
+
+    ep->proto = proto;
+
+    strncpy(ep->name, name, (_ENDPOINT_LEN_ - 1));
+    ep->name[_ENDPOINT_LEN_ - 1] = '\0';
+
+    __atomic_store_n(&ep->active, 1, __ATOMIC_RELEASE);
+
+    return free_idx;
+}
+
+/**
+ * @brief Esta función marca como inactivo un extremo de escucha. Su
+ *        entrada (y sus contadores) se conservan.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param ep Índice del extremo (puede ser -1).
+ */
+void stats_endpoint_release(struct_data *sd, int ep)
+{
+    if ((ep >= 0) && (ep < _MAX_ENDPOINTS_))
+        __atomic_store_n(&sd->endpoints[ep].active, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Esta función cuenta las conexiones en curso de un extremo de
+ *        escucha, según la tabla de conexiones.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param ep Índice del extremo.
+ *
+ * @return La cantidad de conexiones en curso.
+ */
+int stats_endpoint_conns(struct_data *sd, int ep)
+{
+    int conns = 0;
+
+    for (int i = 0; i < _MAX_CONNS_; i++)
+        if ((__atomic_load_n(&sd->conns[i].pid, __ATOMIC_ACQUIRE) != 0) && (__atomic_load_n(&sd->conns[i].endpoint, __ATOMIC_RELAXED) == ep))
+            conns++;
+
+    return conns;
+}
+
+/**
+ * @brief Esta función publica los cambios hechos en la configuración
+ *        compartida, para que los handlers los recarguen.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ */
+void stats_cfg_commit(struct_data *sd)
+{
+    __atomic_fetch_add(&sd->cfg.generation, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Esta función suma atómicamente un valor a un contador compartido.
+ *
+ * @details Se utiliza un orden de memoria relajado: los contadores son
+ *          independientes entre sí y sólo interesa que ningún incremento
+ *          se pierda cuando varios procesos escriben a la vez.
+ *
+ * @param counter Puntero al contador.
+ * @param value Valor a sumar.
+ */
+void stats_add(long int *counter, long int value)
+{
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Esta función lee atómicamente un contador compartido.
+ *
+ * @param counter Puntero al contador.
+ *
+ * @return El valor actual del contador.
+ */
+long int stats_read(long int *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Esta función suma los bytes recibidos en todos los
+ *        protocolos de una instancia.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ *
+ * @return El total de bytes recibidos por la instancia.
+ */
+long int stats_total(struct_data *sd)
+{
+    long int sum = 0;
+
+    for (int i = 0; i < _PROTOS_; i++)
+        sum += stats_read(&sd->proto[i].bytes);
+
+    return sum;
+}
+
+/**
+ * @brief Esta función lee todos los contadores de los protocolos
+ *        de una instancia.
+ *
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param out Vector de _PROTOS_ estructuras donde se almacenará la lectura.
+ */
+void stats_snapshot(struct_data *sd, struct_proto_stats *out)
+{
+    for (int i = 0; i < _PROTOS_; i++)
+    {
+        out[i].bytes = stats_read(&sd->proto[i].bytes);
+        out[i].reads = stats_read(&sd->proto[i].reads);
+        out[i].utime_ns = stats_read(&sd->proto[i].utime_ns);
+        out[i].stime_ns = stats_read(&sd->proto[i].stime_ns);
+        out[i].wait_ns = stats_read(&sd->proto[i].wait_ns);
+        out[i].nvcsw = stats_read(&sd->proto[i].nvcsw);
+        out[i].nivcsw = stats_read(&sd->proto[i].nivcsw);
+        out[i].accepts = stats_read(&sd->proto[i].accepts);
+        out[i].setup_ns = stats_read(&sd->proto[i].setup_ns);
+        out[i].throttled_ns = stats_read(&sd->proto[i].throttled_ns);
+        out[i].channels = stats_read(&sd->proto[i].channels);
+        out[i].comp_bytes = stats_read(&sd->proto[i].comp_bytes);
+        out[i].raw_bytes = stats_read(&sd->proto[i].raw_bytes);
+        out[i].shed = stats_read(&sd->proto[i].shed);
+        out[i].deferred = stats_read(&sd->proto[i].deferred);
+        out[i].tcp_samples = stats_read(&sd->proto[i].tcp_samples);
+        out[i].rcv_rtt_us = stats_read(&sd->proto[i].rcv_rtt_us);
+        out[i].rcv_space = stats_read(&sd->proto[i].rcv_space);
+        out[i].backlogged = stats_read(&sd->proto[i].backlogged);
+        out[i].ooo_pkts = stats_read(&sd->proto[i].ooo_pkts);
+        out[i].threads = stats_read(&sd->proto[i].threads);
+        out[i].rss_bytes = stats_read(&sd->proto[i].rss_bytes);
+        out[i].rss_samples = stats_read(&sd->proto[i].rss_samples);
+    }
+}
+
+/**
+ * @brief Esta función calcula los bytes útiles de un protocolo: los
+ *        de las conexiones comprimidas se cuentan descomprimidos.
+ *
+ * @param ps Contadores del protocolo.
+ *
+ * @return Los bytes útiles recibidos.
+ */
+long int stats_goodput(struct_proto_stats *ps)
+{
+    return ps->bytes - ps->comp_bytes + ps->raw_bytes;
+}
+
+/**
+ * @brief Esta función obtiene el consumo de recursos acumulado del
+ *        hilo que la invoca.
+ *
+ * @details En un handler que es un proceso, su único hilo es el proceso
+ *          entero; en uno que es un hilo del listener, la muestra no
+ *          incluye a los demás hilos. El tiempo de espera en la cola de
+ *          ejecución se toma del segundo campo de
+ *          /proc/thread-self/schedstat; si el kernel no lo provee (fd
+ *          igual a -1), queda en cero.
+ *
+ * @param usage Estructura donde se almacenará la muestra.
+ * @param schedstat_fd Descriptor de /proc/thread-self/schedstat abierto, o -1.
+ */
+void stats_usage_sample(struct_usage *usage, int schedstat_fd)
+{
+    struct rusage ru;
+
+    memset(usage, 0, sizeof(*usage));
+
+    if (getrusage(RUSAGE_THREAD, &ru) == 0)
+    {
+        usage->utime_ns = (ru.ru_utime.tv_sec * 1000000000L) + (ru.ru_utime.tv_usec * 1000L);
+        usage->stime_ns = (ru.ru_stime.tv_sec * 1000000000L) + (ru.ru_stime.tv_usec * 1000L);
+        usage->nvcsw = ru.ru_nvcsw;
+        usage->nivcsw = ru.ru_nivcsw;
+    }
+
+    char buf[128];
+
+    ssize_t len;
+
+    if ((schedstat_fd != -1) && ((len = pread(schedstat_fd, buf, (sizeof(buf) - 1), 0)) > 0))
+    {
+        buf[len] = '\0';
+
+        long int run_ns;
+
+        if (sscanf(buf, "%ld %ld", &run_ns, &usage->wait_ns) != 2)
+            usage->wait_ns = 0;
+    }
+}
+
+/**
+ * @brief Esta función suma a los contadores de un protocolo el consumo
+ *        de recursos del handler desde la muestra anterior.
+ *
+ * @param ps Contadores del protocolo.
+ * @param prev Última muestra publicada; se actualiza con la actual.
+ * @param reads Llamadas a read desde la publicación anterior.
+ * @param schedstat_fd Descriptor de /proc/thread-self/schedstat abierto, o -1.
+ */
+void stats_usage_flush(struct_proto_stats *ps, struct_usage *prev, long int reads, int schedstat_fd)
+{
+    struct_usage curr;
+
+    stats_usage_sample(&curr, schedstat_fd);
+
+    stats_add(&ps->reads, reads);
+    stats_add(&ps->utime_ns, curr.utime_ns - prev->utime_ns);
+    stats_add(&ps->stime_ns, curr.stime_ns - prev->stime_ns);
+    stats_add(&ps->wait_ns, curr.wait_ns - prev->wait_ns);
+    stats_add(&ps->nvcsw, curr.nvcsw - prev->nvcsw);
+    stats_add(&ps->nivcsw, curr.nivcsw - prev->nivcsw);
+
+    *prev = curr;
+}
+
+/**
+ * @brief Esta función devuelve el nombre de un protocolo.
+ *
+ * @param proto Índice del protocolo.
+ *
+ * @return El nombre del protocolo.
+ */
+char *proto_name(int proto)
+{
+    switch (proto)
+    {
+    case _PROTO_LOCAL_:
+        return "local";
+    case _PROTO_IPV4_:
+        return "ipv4";
+    case _PROTO_IPV6_:
+        return "ipv6";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Esta función obtiene el índice de un protocolo a partir de su nombre.
+ *
+ * @param name Nombre del protocolo ("local", "ipv4" o "ipv6").
+ *
+ * @return El índice del protocolo, o -1 si el nombre es inválido.
+ */
+int proto_parse(char *name)
+{
+    for (int i = 0; i < _PROTOS_; i++)
+        if (strcmp(name, proto_name(i)) == 0)
+            return i;
+
+    return -1;
+}
+
+/**
+ * @brief Esta función arma la dirección de un socket auxiliar de una
+ *        instancia (reinicio en caliente, control), en el espacio de
+ *        nombres abstracto de Linux: no deja archivos que haya que borrar.
+ *
+ * @param instance Nombre de la instancia.
+ * @param suffix Sufijo que identifica al socket.
+ * @param addr Estructura donde se almacenará la dirección.
+ *
+ * @return El largo de la dirección.
+ */
+socklen_t instance_addr(char *instance, char *suffix, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+
+    addr->sun_family = AF_UNIX;
+
+    // El primer byte nulo indica una dirección abstracta
+    int len = snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "%s%s.%s", _SHM_PREFIX_, instance, suffix);
+
+    return (socklen_t)(sizeof(addr->sun_family) + 1 + (size_t)len);
+}
+
+/**
+ * @brief Esta función verifica que el proceso conectado a un socket
+ *        auxiliar de una instancia sea del mismo usuario o de root.
+ *
+ * @details Las direcciones abstractas no tienen permisos de archivo:
+ *          cualquier usuario del host puede conectarse, por lo que las
+ *          credenciales del otro extremo (SO_PEERCRED) son el único
+ *          control de acceso.
+ *
+ * @param fd Descriptor de la conexión (aceptada o establecida).
+ *
+ * @return 1 Si el otro extremo puede operar sobre la instancia.
+ *         0 Si no (o si no pudieron obtenerse sus credenciales).
+ */
+int instance_peer_ok(int fd)
+{
+    struct ucred cred;
+
+    socklen_t len = sizeof(cred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1)
+        return 0;
+
+    return (cred.uid == 0) || (cred.uid == geteuid());
+}
@@ -0,0 +1,122 @@
+/**
+ * @file tcpinfo.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de muestreo del estado de las
+ *        conexiones TCP (TCP_INFO) para el TP #1 de Sistemas
+ *        Operativos II.
+ * @version 0.1
+ * @since 2022-04-25
+ */
+
+#include "../headers/tcpinfo.h"
+
+/**
+ * @brief Esta función toma una muestra del estado de una conexión TCP.
+ *
+ * @details Si el kernel no conoce algunos campos de TCP_INFO (por
+ *          ejemplo, los tiempos limitados, en kernels anteriores a
+ *          4.9), devuelve una estructura más corta y esos campos
+ *          quedan en cero.
+ *
+ * @param fd Descriptor de la conexión.
+ * @param s Puntero donde se almacenará la muestra.
+ *
+ * @return 0 Si se tomó la muestra.
+ *        -1 Si el descriptor no es una conexión TCP.
+ */
+int tcpinfo_sample(int fd, struct_tcp_sample *s)
+{
+    struct tcp_info ti;
+
+    socklen_t len = sizeof(ti);
+
+    memset(&ti, 0, sizeof(ti));
+
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) == -1)
+        return -1;
+
+    memset(s, 0, sizeof(*s));
+
+    s->ts_ns = now_ns();
+    s->rtt_us = ti.tcpi_rtt;
+    s->rcv_rtt_us = ti.tcpi_rcv_rtt;
+    s->cwnd = ti.tcpi_snd_cwnd;
+    s->snd_wnd = ti.tcpi_snd_wnd;
+    s->retrans = ti.tcpi_total_retrans;
+    s->ooo = ti.tcpi_rcv_ooopack;
+    s->rcv_space = ti.tcpi_rcv_space;
+    s->delivery = ti.tcpi_delivery_rate;
+    s->busy_us = ti.tcpi_busy_time;
+    s->rwnd_us = ti.tcpi_rwnd_limited;
+    s->sndbuf_us = ti.tcpi_sndbuf_limited;
+
+    len = sizeof(s->rcvbuf);
+
+    if ((ioctl(fd, SIOCINQ, &s->inq) == -1) || (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &s->rcvbuf, &len) == -1))
+        s->inq = s->rcvbuf = 0;
+
+    return 0;
+}
+
+/**
+ * @brief Esta función indica si, en una muestra del receptor, la
+ *        cola de recepción está acumulando datos sin leer.
+ *
+ * @details SO_RCVBUF informa el doble del espacio para datos (el resto
+ *          es para el control del kernel): con más de un cuarto de ese
+ *          valor sin leer, la mitad de la ventana está ocupada y es el
+ *          handler, y no la red, quien frena la conexión.
+ *
+ * @param s Muestra del receptor.
+ *
+ * @return 1 Si la cola está acumulando datos, 0 si no.
+ */
+int tcpinfo_backlogged(struct_tcp_sample *s)
+{
+    return (s->rcvbuf > 0) && (s->inq > (s->rcvbuf / 4));
+}
+
+/**
+ * @brief Esta función describe el estado de emisión de una conexión
+ *        entre dos muestras, indicando qué la limitó.
+ *
+ * @details Del tiempo que la conexión tuvo datos para enviar, el kernel
+ *          informa cuánto estuvo limitada por la ventana del receptor
+ *          (el servidor no lee lo suficientemente rápido) y cuánto por
+ *          el buffer de envío (el cliente no escribe lo suficientemente
+ *          rápido); el resto lo limitó la ventana de congestión, es
+ *          decir, la red.
+ *
+ * @param prev Muestra anterior.
+ * @param curr Muestra actual.
+ * @param buf Buffer donde se almacenará la descripción.
+ * @param len Tamaño del buffer.
+ *
+ * @return El resultado de snprintf.
+ */
+int tcpinfo_describe(struct_tcp_sample *prev, struct_tcp_sample *curr, char *buf, size_t len)
+{
+    double elapsed_us = (double)(curr->ts_ns - prev->ts_ns) / 1e3;
+    double busy = (double)(curr->busy_us - prev->busy_us);
+    double rwnd = (double)(curr->rwnd_us - prev->rwnd_us);
+    double sndbuf = (double)(curr->sndbuf_us - prev->sndbuf_us);
+    double cwnd = busy - rwnd - sndbuf;
+
+    char *limit = "-";
+
+    if (busy > 0)
+    {
+        if ((rwnd * 100) >= (busy * _TCPINFO_LIMITED_))
+            limit = "receiver";
+        else if ((sndbuf * 100) >= (busy * _TCPINFO_LIMITED_))
+            limit = "sender";
+        else if ((cwnd * 100) >= (busy * _TCPINFO_LIMITED_))
+            limit = "network";
+    }
+
+    return snprintf(buf, len, "rtt %.2f[ms] cwnd %u, %u retransmits, delivery %.1f[Mb/s], peer window %u[KB], busy %.0f%% (rwnd-limited %.0f%%, sndbuf-limited %.0f%%), limited by: %s",
+                    (double)curr->rtt_us / 1e3, curr->cwnd, curr->retrans - prev->retrans, ((double)curr->delivery * 8) / 1e6, curr->snd_wnd / 1024,
+                    (elapsed_us > 0) ? ((100.0 * busy) / elapsed_us) : 0.0,
+                    (busy > 0) ? ((100.0 * rwnd) / busy) : 0.0,
+                    (busy > 0) ? ((100.0 * sndbuf) / busy) : 0.0, limit);
+}
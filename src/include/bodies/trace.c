@@ -0,0 +1,302 @@
+/**
+ * @file trace.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Librería con funciones de registro de eventos (tracing) de
+ *        los procesos del servidor en memoria compartida para el TP #1
+ *        de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-21
+ */
+
+#include "../headers/trace.h"
+
+// Segmento de la instancia, heredado por los procesos hijos
+static struct_trace *trace_shm = NULL;
+
+// Registro del proceso (o hilo) actual, y su dueño: tras un fork, el hijo debe pedir uno propio
+static __thread struct_trace_ring *my_ring = NULL;
+static __thread int my_tid = 0;
+
+/**
+ * @brief Esta función arma el nombre del segmento de eventos de
+ *        una instancia.
+ *
+ * @param instance Nombre de la instancia.
+ * @param name Buffer donde se almacenará el nombre del segmento.
+ * @param len Tamaño del buffer.
+ */
+static void trace_shm_name(char *instance, char *name, size_t len)
+{
+    if (snprintf(name, len, "/%s%s", _TRACE_PREFIX_, instance) < 0)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed building trace shared memory name");
+}
+
+/**
+ * @brief Esta función lee el reloj de los eventos.
+ *
+ * @return Ciclos del TSC en x86, o nanosegundos del reloj monotónico.
+ */
+static inline unsigned long int trace_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (unsigned long int)now_ns();
+#endif
+}
+
+/**
+ * @brief Esta función crea (o, luego de un reinicio en caliente,
+ *        reutiliza) el segmento de eventos de una instancia.
+ *
+ * @details El segmento se crea siempre, para que el registro de eventos
+ *          pueda habilitarse en cualquier momento; como el archivo es
+ *          disperso, sólo ocupan memoria los registros que se usan.
+ *
+ * @param instance Nombre de la instancia.
+ *
+ * @return Puntero al segmento, o NULL si no pudo crearse.
+ */
+struct_trace *trace_open(char *instance)
+{
+    char name[_INSTANCE_LEN_ + sizeof(_TRACE_PREFIX_) + 1];
+
+    trace_shm_name(instance, name, sizeof(name));
+
+    int fd = shm_open(name, (O_CREAT | O_RDWR), 0644);
+
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+
+    int reuse = (fstat(fd, &st) == 0) && ((size_t)st.st_size == sizeof(struct_trace));
+
+    if (!reuse && (ftruncate(fd, sizeof(struct_trace)) == -1))
+    {
+        close(fd);
+
+        return NULL;
+    }
+
+    struct_trace *tr = mmap(NULL, sizeof(struct_trace), (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (tr == MAP_FAILED)
+        return NULL;
+
+    // Los handlers de la instancia saliente siguen escribiendo en el segmento existente
+    if (!reuse || (tr->magic != _TRACE_MAGIC_) || (tr->version != _TRACE_VERSION_))
+    {
+        tr->version = _TRACE_VERSION_;
+
+#if defined(__x86_64__) || defined(__i386__)
+        tr->cycles_per_ns = cpu_cycles_per_ns();
+#else
+        tr->cycles_per_ns = 1.0;
+#endif
+
+        tr->ts0 = trace_clock();
+        tr->mono0 = now_ns();
+
+        __atomic_store_n(&tr->magic, _TRACE_MAGIC_, __ATOMIC_RELEASE);
+    }
+
+    trace_shm = tr;
+
+    return tr;
+}
+
+/**
+ * @brief Esta función mapea en modo sólo lectura el segmento de
+ *        eventos de una instancia.
+ *
+ * @param instance Nombre de la instancia.
+ *
+ * @return Puntero al segmento, o NULL si no existe o no corresponde
+ *         a esta versión del servidor.
+ */
+struct_trace *trace_attach(char *instance)
+{
+    char name[_INSTANCE_LEN_ + sizeof(_TRACE_PREFIX_) + 1];
+
+    trace_shm_name(instance, name, sizeof(name));
+
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+
+    if ((fstat(fd, &st) == -1) || ((size_t)st.st_size != sizeof(struct_trace)))
+    {
+        close(fd);
+
+        return NULL;
+    }
+
+    struct_trace *tr = mmap(NULL, sizeof(struct_trace), PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (tr == MAP_FAILED)
+        return NULL;
+
+    if ((__atomic_load_n(&tr->magic, __ATOMIC_ACQUIRE) != _TRACE_MAGIC_) || (tr->version != _TRACE_VERSION_))
+    {
+        munmap(tr, sizeof(struct_trace));
+
+        return NULL;
+    }
+
+    return tr;
+}
+
+/**
+ * @brief Esta función elimina el segmento de eventos de una instancia.
+ *
+ * @param instance Nombre de la instancia.
+ */
+void trace_destroy(char *instance)
+{
+    char name[_INSTANCE_LEN_ + sizeof(_TRACE_PREFIX_) + 1];
+
+    trace_shm_name(instance, name, sizeof(name));
+
+    if ((shm_unlink(name) == -1) && (errno != ENOENT))
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed trying to remove trace shared memory segment");
+}
+
+/**
+ * @brief Esta función devuelve el registro de eventos del proceso
+ *        actual, asignándole uno la primera vez.
+ *
+ * @details Los registros se recorren en orden circular a partir del
+ *          siguiente al último asignado, de modo que los eventos de los
+ *          procesos que terminaron se conserven el mayor tiempo posible.
+ *
+ * @param role Rol del proceso.
+ * @param proto Protocolo que atiende (-1 si no corresponde).
+ * @param label Descripción del proceso.
+ *
+ * @return El registro, o NULL si no hay segmento o todos están en uso.
+ */
+struct_trace_ring *trace_ring(int role, int proto, char *label)
+{
+    int tid = (int)gettid();
+
+    if ((my_tid == tid) && my_ring)
+        return my_ring;
+
+    if (!trace_shm)
+        return NULL;
+
+    my_tid = tid;
+    my_ring = NULL;
+
+    unsigned int start = __atomic_fetch_add(&trace_shm->next, 1, __ATOMIC_RELAXED);
+
+    for (unsigned int i = 0; i < _TRACE_RINGS_; i++)
+    {
+        struct_trace_ring *r = &trace_shm->rings[(start + i) % _TRACE_RINGS_];
+
+        int expected = 0;
+
+        if (__atomic_compare_exchange_n(&r->owner, &expected, tid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            // Mientras se reinicia, el registro no tiene eventos válidos para los lectores
+            __atomic_store_n(&r->head, 0, __ATOMIC_RELEASE);
+
+            r->pid = tid;
+            r->role = role;
+            r->proto = proto;
+
+            strncpy(r->label, label, (_TRACE_LABEL_LEN_ - 1));
+            r->label[_TRACE_LABEL_LEN_ - 1] = '\0';
+
+            my_ring = r;
+
+            break;
+        }
+    }
+
+    return my_ring;
+}
+
+/**
+ * @brief Esta función libera el registro de eventos del proceso
+ *        actual. Sus eventos se conservan hasta que se reutilice.
+ */
+void trace_release(void)
+{
+    if (my_ring && (my_tid == (int)gettid()))
+        __atomic_store_n(&my_ring->owner, 0, __ATOMIC_RELEASE);
+
+    my_ring = NULL;
+}
+
+/**
+ * @brief Esta función registra un evento (ver la macro TRACE).
+ *
+ * @param r Registro del proceso.
+ * @param type Tipo de evento.
+ * @param arg Argumento del evento.
+ */
+void trace_emit(struct_trace_ring *r, int type, long int arg)
+{
+    unsigned long int head = r->head;
+
+    struct_trace_event *ev = &r->ev[head & (_TRACE_EVENTS_ - 1)];
+
+    ev->ts = trace_clock();
+    ev->type = type;
+    ev->arg = arg;
+
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Esta función convierte el instante de un evento a nanosegundos
+ *        del reloj monotónico.
+ *
+ * @param tr Segmento de eventos.
+ * @param ts Instante del evento.
+ *
+ * @return El instante en nanosegundos.
+ */
+double trace_ns(struct_trace *tr, unsigned long int ts)
+{
+    return (double)tr->mono0 + (((double)ts - (double)tr->ts0) / tr->cycles_per_ns);
+}
+
+/**
+ * @brief Esta función devuelve el nombre de un tipo de evento.
+ *
+ * @param type Tipo de evento.
+ *
+ * @return El nombre del evento.
+ */
+char *trace_type_name(int type)
+{
+    switch (type)
+    {
+    case _TRACE_ACCEPT_:
+        return "accept";
+    case _TRACE_START_:
+        return "handler_start";
+    case _TRACE_READ_:
+        return "read";
+    case _TRACE_EOT_:
+        return "eot";
+    case _TRACE_THROTTLE_:
+        return "throttle";
+    case _TRACE_REAP_:
+        return "reap";
+    case _TRACE_TICK_:
+        return "log_tick";
+    default:
+        return "unknown";
+    }
+}
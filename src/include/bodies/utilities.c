@@ -9,6 +9,8 @@
 
 #include "../headers/utilities.h"
 
+void (*show_err_hook)(int, int, char *) = NULL;
+
 /**
  * @brief Esta función muestra el mensaje solicitado en pantalla
  *        y termina la ejecución del programa si es necesario.
@@ -20,7 +22,19 @@
  */
 void show_err(int pid, int source, int err_type, char *msg)
 {
-    try_write(STDERR_FILENO, mk_err_msg(pid, source, err_type, msg));
+    // Los errores fatales se escriben siempre en forma directa: el proceso termina a continuación
+    if ((err_type == _NORM_ERR_) && show_err_hook)
+    {
+        show_err_hook(pid, source, msg);
+
+        return;
+    }
+
+    char *err_msg = mk_err_msg(pid, source, err_type, msg);
+
+    try_write(STDERR_FILENO, err_msg);
+
+    free(err_msg);
 
     if (err_type == _FATAL_ERR_)
         exit(EXIT_FAILURE);
@@ -32,13 +46,7 @@ void show_err(int pid, int source, int err_type, char *msg)
  */
 void show_examples()
 {
-    // +817 por el largo del mensaje
-    char *h_msg = malloc((sizeof(char) * 817) + sizeof(NULL));
-
-    if (!h_msg)
-        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in memory allocation");
-
-    strcpy(h_msg, "///////////////////////////////////////////////////////////////////   E X A M P L E S   //////////////////////////////////////////////////////////////////\n\n\
+    char examples_txt[] = "///////////////////////////////////////////////////////////////////   E X A M P L E S   //////////////////////////////////////////////////////////////////\n\n\
 These examples are provided assuming the correct project compilation, standing in the project's root folder.\n\n\
 <SERVER>\n\n\
     ./bin/srv my_socket 2222 5000\n\n\
@@ -49,9 +57,21 @@ These examples are provided assuming the correct project compilation, standing i
     ./bin/cln ipv4 127.0.0.1 2222 12\n\
     ./bin/cln ipv4 [IPv4 address] 2222 3\n\
     ./bin/cln ipv6 ::1 lo 5000 37\n\
-    ./bin/cln ipv6 [IPv6 address] [interface] 5000 242\n\n\
+    ./bin/cln ipv6 [IPv6 address] [interface] 5000 242\n\
+    ./bin/cln -C 32 ipv4 127.0.0.1 2222 4096\n\
+    ./bin/cln -C 32 -M 4 local my_socket 4096\n\
+    ./bin/cln -P log -Z ipv4 127.0.0.1 2222 8192\n\
+    ./bin/cln -T 1000:1000 -W 8192 -D 200 ipv4 127.0.0.1 2222 16\n\n\
 For more help, run this program with '-h', '--help', or '?'.\n\n\
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////\n");
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////\n";
+
+    // El largo se toma del mensaje (sizeof incluye el caracter nulo)
+    char *h_msg = malloc(sizeof(examples_txt));
+
+    if (!h_msg)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in memory allocation");
+
+    strcpy(h_msg, examples_txt);
 
     try_write(STDOUT_FILENO, h_msg);
 
@@ -65,28 +85,55 @@ For more help, run this program with '-h', '--help', or '?'.\n\n\
  */
 void show_help()
 {
-    char max_buff_size_str[5];
+    char max_buff_size_str[12];
 
     itoa(_MAX_BUFF_SIZE_, max_buff_size_str);
 
-    // +2582 por el largo del mensaje
-    char *h_msg = malloc(strlen(max_buff_size_str) + (sizeof(char) * 2582) + sizeof(NULL));
-
-    if (!h_msg)
-        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in memory allocation");
-
-    strcpy(h_msg, "///////////////////////////////////////////////////////////////////////   H E L P   //////////////////////////////////////////////////////////////////////\n\n\
+    char *help_txt = "///////////////////////////////////////////////////////////////////////   H E L P   //////////////////////////////////////////////////////////////////////\n\n\
 <SERVER>\n\
     In order to setup the server correctly, the user must provide the following arguments:\n\n\
         First argument:\n\
-            Local TCP/IP connection socket file name.\n\
+            Local TCP/IP connection socket file name, or a comma-separated list of them.\n\
         Second argument:\n\
-            TCP/IPv4 port number.\n\
+            TCP/IPv4 port number, or a comma-separated list of them. Each port may be preceded by\n\
+            the address to listen on (e.g. '2222,127.0.0.1:2223'); otherwise, it listens on all of them.\n\
         Third argument:\n\
-            TCP/IPv6 port number.\n\
+            TCP/IPv6 port number, or a comma-separated list of them (e.g. '5000,[::1]:5001').\n\
         Fourth argument (optional):\n\
             Logging time interval (in seconds).\n\n\
-<CLIENT>\n\
+    The following options may precede the arguments:\n\n\
+        --listener-cpus LIST:\n\
+            Pin the connection listeners to the given CPU list (e.g. '0-1,4').\n\
+        --handler-cpus LIST:\n\
+            Pin the client handlers to the given CPU list.\n\
+        --logger-cpus LIST:\n\
+            Pin the logging loop to the given CPU list.\n\
+        --auto-affinity:\n\
+            Run each client handler on the CPU that receives its packets (SO_INCOMING_CPU),\n\
+            with its receive buffer allocated on that CPU's NUMA node.\n\
+        --instance NAME:\n\
+            Name of this server instance (default: its PID). Stats are kept in /dev/shm/so2tp1.NAME,\n\
+            and can be merged with those of other running instances with './bin/agg'.\n\
+        --takeover NAME:\n\
+            Hot restart: take the listening sockets and stats of the running instance NAME, which stops\n\
+            accepting clients and exits once its current connections are drained.\n\
+        --metrics PORT|PATH:\n\
+            Serve OpenMetrics (Prometheus) metrics over HTTP at /metrics, on the given loopback TCP port\n\
+            or Unix socket path.\n\
+        --trace:\n\
+            Record accept, read, throttle and log events of every server process in /dev/shm, to be exported\n\
+            as a Chrome trace with './bin/trc NAME' (it can also be toggled with './bin/ctl NAME trace on|off').\n\
+        --event-log PATH:\n\
+            Append the server messages (accepted and closed connections, errors) to PATH as JSON lines,\n\
+            instead of writing them to stdout.\n\
+        --handler-mode process|thread:\n\
+            Handle each client with a child process of its listener (default) or with a thread of it.\n\
+        --thread-stack KB:\n\
+            Stack size of the handler threads, from 32 to 8192 (default: 64).\n\n\
+    A running instance can be reconfigured with './bin/ctl NAME COMMAND' (run './bin/ctl -h' for help).\n\n";
+
+    // El texto se divide en tres partes: ISO C99 no garantiza literales de más de 4095 caracteres
+    char *client_txt = "<CLIENT>\n\
     In order to setup the client correctly, the user must provide the following arguments:\n\n\
         First argument:\n\
             Client's connection protocol.\n\
@@ -106,12 +153,55 @@ void show_help()
         If the client is connected via TCP/IPv6, the fourth argument must be:\n\
             The IPv6 port used for the connection.\n\
         If the client is connected via TCP/IPv6, the fifth argument must be:\n\
-            The size of the buffer to be sent, and no more arguments are needed.\n\n\
+            The size of the buffer to be sent, and no more arguments are needed.\n\n";
+
+    char *client_opts_txt = "    The following options may precede the arguments:\n\n\
+        --channels N (-C N):\n\
+            Send N logical channels multiplexed over the connection, using framed messages with per-channel\n\
+            flow control credits (at most 256 channels per connection).\n\
+        --connections M (-M M):\n\
+            Open M connections to the server. With --channels, the N channels are spread over the M connections.\n\
+        --payload GEN (-P GEN):\n\
+            Data to be sent: const (a single repeated character, the default), random (incompressible bytes),\n\
+            text (English-like words) or log (log lines with timestamps and numeric fields).\n\
+        --compress (-Z):\n\
+            Compress each buffer before sending it, with an LZ-family block compressor (the server decompresses\n\
+            it and reports both wire and decompressed bytes). It can not be combined with --channels.\n\
+        --tcp-info (-I):\n\
+            Every second, print the sending state of each TCP connection (RTT, congestion window, retransmits,\n\
+            delivery rate, and the share of time limited by the receiver window or the send buffer).\n\
+        --report SECONDS (-R SECONDS):\n\
+            Every SECONDS seconds, print the bytes sent (on the wire and of data), the send calls, the partial\n\
+            sends, and the sends refused with a full send buffer (EAGAIN) along with the time blocked waiting\n\
+            for room. A summary of the whole connection is always printed on exit (SIGINT).\n\
+        --format text|csv|json (-F FORMAT):\n\
+            Format of the reports and the summary (default: text).\n\
+        --tick N[:USEC] (-T N[:USEC]):\n\
+            Small-message mode: produce N messages of the buffer size per tick, every USEC microseconds (as fast\n\
+            as possible if omitted), and report messages per second, send calls per message and queueing delay.\n\
+            It can not be combined with --channels or --compress.\n\
+        --coalesce BYTES (-W BYTES):\n\
+            In small-message mode, queue messages and send them in one sendmsg call once BYTES are queued\n\
+            (default: one send call per message).\n\
+        --deadline USEC (-D USEC):\n\
+            In small-message mode, send the queued messages once the oldest one has waited USEC microseconds.\n\
+        --flush-tick (-E):\n\
+            In small-message mode, send the queued messages at the end of every tick.\n\n\
 The maximum buffer size allowed is 10000.\n\n\
 If the user does not provide a logging time interval, or enters a negative number, or enters a number less or equal to zero, or the input is not\n\
 a number, the logging interval will be set to its default value of 1 second between logs.\n\n\
 For execution examples, run this program with '-e', '--examples', or '!'.\n\n\
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////\n");
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////\n";
+
+    // +1 por el caracter nulo
+    char *h_msg = malloc(strlen(max_buff_size_str) + strlen(help_txt) + strlen(client_txt) + strlen(client_opts_txt) + 1);
+
+    if (!h_msg)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in memory allocation");
+
+    strcpy(h_msg, help_txt);
+    strcat(h_msg, client_txt);
+    strcat(h_msg, client_opts_txt);
 
     try_write(STDOUT_FILENO, h_msg);
 
@@ -151,6 +241,90 @@ void try_write(int stdx, char *msg)
     }
 }
 
+/**
+ * @brief Esta función obtiene el tiempo actual de un reloj monotónico.
+ *
+ * @return El tiempo actual, en nanosegundos.
+ */
+long int now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1000000000L) + ts.tv_nsec;
+}
+
+/**
+ * @brief Esta función estima la frecuencia de la CPU, para convertir
+ *        tiempos de CPU en ciclos.
+ *
+ * @details En x86 se mide el contador de marcas de tiempo (TSC) contra
+ *          el reloj monotónico durante un intervalo breve: en las CPUs
+ *          actuales el TSC avanza a frecuencia nominal constante. En otras
+ *          arquitecturas se usa la frecuencia máxima informada por cpufreq.
+ *
+ * @return Ciclos por nanosegundo (1 si no pudo estimarse).
+ */
+double cpu_cycles_per_ns()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    long int start_ns = now_ns();
+
+    unsigned long long start_tsc = __rdtsc();
+
+    struct timespec ts = {.tv_sec = 0, .tv_nsec = 20000000L};
+
+    nanosleep(&ts, NULL);
+
+    unsigned long long end_tsc = __rdtsc();
+
+    long int end_ns = now_ns();
+
+    if (end_ns > start_ns)
+        return (double)(end_tsc - start_tsc) / (double)(end_ns - start_ns);
+#else
+    FILE *f = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r");
+
+    long int khz = 0;
+
+    if (f)
+    {
+        if (fscanf(f, "%ld", &khz) != 1)
+            khz = 0;
+
+        fclose(f);
+    }
+
+    if (khz > 0)
+        return (double)khz / 1e6;
+#endif
+
+    return 1.0;
+}
+
+/**
+ * @brief Esta función determina si una lectura contiene el mensaje
+ *        de fin de transmisión.
+ *
+ * @details Equivale a comparar con strcmp un buffer inicializado en
+ *          ceros antes de la lectura, sin necesidad de limpiarlo: sólo
+ *          se miran los bytes efectivamente leídos.
+ *
+ * @param buffer Bytes leídos.
+ * @param len Cantidad de bytes leídos.
+ *
+ * @return 1 Si la lectura es el mensaje de fin de transmisión.
+ *         0 En caso contrario.
+ */
+int is_eot(char *buffer, ssize_t len)
+{
+    ssize_t eot_len = (ssize_t)(sizeof(_EOT_MSG_) - 1);
+
+    // Si se leyeron más bytes, el mensaje debe estar seguido de un caracter nulo (como lo exige strcmp)
+    return (len >= eot_len) && (memcmp(buffer, _EOT_MSG_, (size_t)eot_len) == 0) && ((len == eot_len) || (buffer[eot_len] == '\0'));
+}
+
 /**
  * @brief Esta función convierte un número
  *        entero a una cadena de caracteres.
@@ -197,10 +371,9 @@ char *itoa(int num, char buff[])
 /**
  * @brief Esta función se encarga de armar un mensaje de error.
  *
- * @details Se almacena memoria inicializada con ceros para evitar
- *          error con strcat. Se sobrescribe con el formato
- *          correspondiente para un mensaje de error y el mensaje
- *          que indica la falla, recibido por parámetro.
+ * @details El encabezado (pid, fuente y gravedad) se arma con snprintf
+ *          en un buffer local; el mensaje recibido se copia con memcpy,
+ *          recorriéndolo una única vez (ver ./bin/mbench).
  *
  * @param pid ID del proceso que mostrará el error.
  * @param source Fuente del error.
@@ -211,59 +384,27 @@ char *itoa(int num, char buff[])
  */
 char *mk_err_msg(int pid, int source, int err_type, char *msg)
 {
-    char *err_msg;
-    char aux[10];
-
-    if (snprintf(aux, sizeof(aux), "%d", pid) < 0)
-    {
-        fprintf(stderr, "\nFatal snprintf error --- ABORTING\n");
+    char prefix[64];
 
-        exit(EXIT_FAILURE);
-    }
+    int prefix_len = snprintf(prefix, sizeof(prefix), "\n[PID: %d] <%s> [[ %s ]] : ", pid,
+                              (source == _SERVER_SRC_) ? "SERVER" : ((source == _CLIENT_SRC_) ? "CLIENT" : "GENERAL"),
+                              (err_type == _FATAL_ERR_) ? "FATAL ERROR" : "ERROR");
 
-    if (err_type == _FATAL_ERR_)
-    {
-        // +9 por "\n[PID : ", +2 por "] ", +7 por "CLIENT" o "SERVER", +23 por "> [[ FATAL ERROR ]] : " y +4 por "\n\n"
-        err_msg = (char *)calloc(strlen(msg) + strlen(aux) + sizeof(NULL) + (sizeof(char) * 45), sizeof(char));
+    size_t msg_len = strlen(msg);
 
-        if (!err_msg)
-            show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in memory allocation");
-
-        strcpy(err_msg, "\n[PID: ");
-        strcat(err_msg, aux);
-        strcat(err_msg, "] <");
-
-        if (source == _SERVER_SRC_)
-            strcat(err_msg, "SERVER");
-        else if (source == _CLIENT_SRC_)
-            strcat(err_msg, "CLIENT");
-        else
-            strcat(err_msg, "GENERAL");
+    char *err_msg;
 
-        strcat(err_msg, "> [[ FATAL ERROR ]] : ");
-    }
-    else
+    // sizeof incluye el caracter nulo
+    if ((prefix_len < 0) || !(err_msg = malloc((size_t)prefix_len + msg_len + sizeof(".\n\n"))))
     {
-        // +9 por "\n[PID : ", +2 por "] ", +7 por "CLIENT" o "SERVER", +17 por "> [[ ERROR ]] : " y +4 por "\n\n"
-        err_msg = (char *)calloc(strlen(msg) + strlen(aux) + sizeof(NULL) + (sizeof(char) * 39), sizeof(char));
-
-        if (!err_msg)
-            show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in memory allocation");
+        fprintf(stderr, "\nFatal error building an error message --- ABORTING\n");
 
-        strcpy(err_msg, aux);
-
-        if (source == _SERVER_SRC_)
-            strcat(err_msg, "SERVER");
-        else if (source == _CLIENT_SRC_)
-            strcat(err_msg, "CLIENT");
-        else
-            strcat(err_msg, "GENERAL");
-
-        strcat(err_msg, "> [[ ERROR ]] : ");
+        exit(EXIT_FAILURE);
     }
 
-    strcat(err_msg, msg);
-    strcat(err_msg, ".\n\n");
+    memcpy(err_msg, prefix, (size_t)prefix_len);
+    memcpy(err_msg + prefix_len, msg, msg_len);
+    memcpy(err_msg + (size_t)prefix_len + msg_len, ".\n\n", sizeof(".\n\n"));
 
     return err_msg;
-}
\ No newline at end of file
+}
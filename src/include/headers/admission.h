@@ -0,0 +1,38 @@
+/**
+ * @file admission.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de control de admisión de
+ *        conexiones (límites de conexiones simultáneas y de memoria)
+ *        para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-23
+ */
+
+#ifndef __ADMISSION__
+#define __ADMISSION__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "stats.h"
+
+/* ---------- Definición de constantes ---------- */
+
+#define _OVERLOAD_REJECT_ 0 // Las conexiones que superan los límites se cierran de inmediato
+#define _OVERLOAD_DEFER_ 1  // Las conexiones esperan un lugar libre, hasta un tiempo máximo
+
+#define _ADMIT_DEFER_MS_ 1000       // Espera máxima por defecto de una conexión diferida
+#define _ADMIT_POLL_NS_ 1000000L    // Período con el que una conexión diferida busca un lugar libre
+#define _ADMIT_MEM_NS_ 100000000L   // Período de lectura de la memoria disponible del host
+
+/* ---------- Prototipado de funciones ---------- */
+
+int admit_try(struct_data *, struct_sv_config *, int);
+void admit_release(struct_data *, int);
+int admit_wait(struct_data *, struct_sv_config *, int);
+int admit_defer_ms(struct_sv_config *);
+void admit_shed(int);
+
+long int mem_available(void);
+char *overload_name(int);
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * @file affinity.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de afinidad de CPU y
+ *        ubicación de memoria en nodos NUMA locales para el
+ *        TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-02
+ */
+
+#ifndef __AFFINITY__
+#define __AFFINITY__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "utilities.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Conjuntos de CPUs a los que se fija cada tipo de proceso del servidor.
+ * Un conjunto vacío indica que ese tipo de proceso no se fija a ninguna CPU
+ * en particular: usa las CPUs que tenía el servidor al arrancar.
+ */
+typedef struct struct_affinity
+{
+    cpu_set_t startup_cpus; // Afinidad del servidor al arrancar
+    cpu_set_t listener_cpus;
+    cpu_set_t handler_cpus;
+    cpu_set_t logger_cpus;
+    int auto_mode; // Fijar cada handler a la CPU de SO_INCOMING_CPU
+} struct_affinity;
+
+/* ---------- Prototipado de funciones ---------- */
+
+void affinity_init(struct_affinity *);
+int parse_cpu_list(char *, cpu_set_t *);
+int pin_to_cpus(struct_affinity *, cpu_set_t *);
+int pin_to_incoming_cpu(int, cpu_set_t *);
+void pin_handler(int, struct_affinity *);
+
+void *alloc_local_buffer(size_t);
+void free_local_buffer(void *, size_t);
+
+#endif
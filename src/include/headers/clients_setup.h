@@ -13,9 +13,18 @@
 /* ---------- Librerías a utilizar -------------- */
 
 #include "utilities.h"
+#include "lz.h"
+#include "mux.h"
+#include "payload.h"
+#include "tcpinfo.h"
+#include "report.h"
+#include "coalesce.h"
 
 #include <arpa/inet.h>
+#include <getopt.h>
 #include <net/if.h>
+#include <poll.h>
+#include <sys/time.h>
 
 /* ---------- Definición de constantes ---------- */
 
@@ -23,9 +32,24 @@
 #define _IPV6_ "ipv6"
 #define _LOCAL_ "local"
 
+#define _MAX_CONNECTIONS_ 256 // Máximo de conexiones por cliente
+
 /* ---------- Definición de variables ----------- */
 
-int socket_fd;
+extern int socket_fd;
+extern int mux_channels;                  // Canales lógicos de la conexión (0: conexión común)
+extern int payload_gen;                   // Generador de los datos a enviar (ver payload.h)
+extern int compress;                      // Si es distinto de cero, los datos se envían comprimidos
+extern int tcp_info;                      // Si es distinto de cero, se informa el estado TCP de la conexión
+extern int report_interval;               // Segundos entre informes de envío (0: sólo el resumen final)
+extern int report_fmt;                    // Formato de los informes de envío (ver report.h)
+extern int tick_msgs;                     // Mensajes por período del modo de mensajes chicos (0: modo común)
+extern long int tick_ns;                  // Duración de cada período (0: sin pausa entre períodos)
+extern size_t coalesce_bytes;             // Umbral de tamaño de los lotes (0: cada mensaje se envía solo)
+extern long int deadline_ns;              // Espera máxima de un mensaje en su lote (0: sin límite)
+extern int flush_tick;                    // Si es distinto de cero, el lote se envía al final de cada período
+extern volatile sig_atomic_t mux_sending; // Hay una trama (o un bloque comprimido) a medio enviar
+extern volatile sig_atomic_t mux_stop;    // Se recibió SIGINT durante el envío de una trama o bloque
 
 /* ---------- Prototipado de funciones ---------- */
 
@@ -33,5 +57,16 @@ void handler(int);
 void run_ipv4_cl(char *, uint16_t, int);
 void run_ipv6_cl(char *, char *, uint16_t, int);
 void run_local_cl(char *, int);
+void run_mux(char *, int);
+void run_payload(int);
+void run_small(char *, int);
+void mux_finish(void);
+int cl_send(const void *, size_t, long int);
+int cl_sendv(struct iovec *, int, long int);
+void tcp_report(int);
+void report_tick(int);
+void report_poll(void);
+void report_start(void);
+void report_summary(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+/**
+ * @file coalesce.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de agrupamiento de mensajes
+ *        chicos en envíos vectoriales de los clientes para el TP #1 de
+ *        Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-27
+ */
+
+#ifndef __COALESCE__
+#define __COALESCE__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "utilities.h"
+
+#include <sys/uio.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _COALESCE_MAX_IOV_ 1024          // IOV_MAX en Linux: segmentos por llamada a sendmsg
+#define _COALESCE_MAX_BYTES_ 4194304     // Umbral máximo de un lote
+#define _COALESCE_MAX_TICK_MSGS_ 1000000 // Mensajes por período del modo de mensajes chicos
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Lote de mensajes pendientes de envío. Los mensajes no se copian: cada
+ * segmento apunta a los datos del mensaje, que deben seguir siendo
+ * válidos hasta que el lote se envíe. Los mensajes contiguos en memoria
+ * comparten un segmento.
+ *
+ * Para calcular la espera de los mensajes en el lote sin recorrerlo, se
+ * guarda la suma de los instantes en que se agregaron, relativos al del
+ * mensaje más antiguo (los instantes absolutos desbordarían la suma): la
+ * espera total al enviarlo es msgs * (ahora - first_ns) - enqueued_ns.
+ */
+typedef struct struct_coalesce
+{
+    struct iovec iov[_COALESCE_MAX_IOV_];
+    int n_iov;
+    long int msgs;        // Mensajes en el lote
+    size_t bytes;         // Bytes en el lote
+    long int first_ns;    // Instante en que se agregó el mensaje más antiguo
+    long int enqueued_ns; // Suma de los instantes en que se agregó cada mensaje, desde first_ns
+    size_t threshold;     // Umbral de tamaño (0: cada mensaje se envía solo)
+    long int deadline_ns; // Espera máxima del mensaje más antiguo (0: sin límite)
+} struct_coalesce;
+
+/* ---------- Prototipado de funciones ---------- */
+
+void coalesce_init(struct_coalesce *, size_t, long int);
+int coalesce_add(struct_coalesce *, const void *, size_t, long int);
+long int coalesce_due_ns(struct_coalesce *);
+long int coalesce_wait_ns(struct_coalesce *, long int);
+void coalesce_reset(struct_coalesce *);
+int coalesce_parse_tick(char *, int *, long int *);
+
+#endif
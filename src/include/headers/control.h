@@ -0,0 +1,35 @@
+/**
+ * @file control.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones del socket de control, que
+ *        permite reconfigurar una instancia del servidor en ejecución
+ *        para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-12
+ */
+
+#ifndef __CONTROL__
+#define __CONTROL__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "stats.h"
+
+#include <limits.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _CTL_LINE_LEN_ 256   // Largo máximo de un comando
+#define _CTL_TIMEOUT_MS_ 500 // Espera máxima por un comando, para no bloquear al proceso principal
+
+/* ---------- Definición de estructuras --------- */
+
+// Definida en servers_setup.h
+struct struct_server;
+
+/* ---------- Prototipado de funciones ---------- */
+
+int control_open(char *);
+void control_handle(struct struct_server *);
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * @file evlog.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones del registro asíncrono de
+ *        eventos (JSON lines) de los procesos del servidor para el
+ *        TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-24
+ */
+
+#ifndef __EVLOG__
+#define __EVLOG__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "stats.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _EVLOG_PREFIX_ "so2tp1-evlog." // Prefijo de los segmentos de eventos en /dev/shm
+#define _EVLOG_MAGIC_ 0x474c5645       // "EVLG"
+#define _EVLOG_VERSION_ 1
+
+#define _EVLOG_SLOTS_ 4096   // Eventos encolados como máximo (potencia de dos)
+#define _EVLOG_MSG_LEN_ 192
+#define _EVLOG_EVENT_LEN_ 16
+#define _EVLOG_KEYS_ 64      // Grupos de mensajes repetidos con límite propio
+#define _EVLOG_RATE_ 100     // Mensajes repetidos por segundo permitidos en cada grupo
+#define _EVLOG_BURST_ 200    // Ráfaga de mensajes repetidos permitida en cada grupo
+#define _EVLOG_IDLE_NS_ 2000000L // Espera del escritor cuando la cola está vacía
+
+// Niveles de los eventos (0 en la configuración compartida equivale a _EVLOG_INFO_)
+#define _EVLOG_DEBUG_ 1
+#define _EVLOG_INFO_ 2
+#define _EVLOG_WARN_ 3
+#define _EVLOG_ERROR_ 4
+
+/* ---------- Definición de estructuras --------- */
+
+// Definida en servers_setup.h
+struct struct_server;
+
+typedef struct struct_evlog_rec
+{
+    long int ts; // Reloj de tiempo real, en ns
+    int pid; // TID, en los hilos handler
+    int level;
+    int proto; // -1 si el evento no corresponde a un protocolo
+    unsigned int suppressed; // Mensajes del mismo grupo descartados desde el anterior
+    char event[_EVLOG_EVENT_LEN_];
+    char msg[_EVLOG_MSG_LEN_];
+} struct_evlog_rec;
+
+/*
+ * Cada posición de la cola tiene un número de secuencia: vale 'pos' cuando
+ * está libre para el productor que reservó la posición 'pos', y 'pos + 1'
+ * cuando contiene el evento listo para el escritor.
+ */
+typedef struct struct_evlog_slot
+{
+    unsigned long int seq;
+    struct_evlog_rec rec;
+} struct_evlog_slot;
+
+// Límite de mensajes repetidos (GCRA, como en qos.h) de un grupo
+typedef struct struct_evlog_limit
+{
+    long int tat;
+    unsigned int suppressed;
+    int pad;
+} struct_evlog_limit;
+
+/*
+ * Segmento de eventos de una instancia: una cola circular con muchos
+ * productores (listeners, handlers y el proceso principal) y un único
+ * consumidor (el escritor). Los productores nunca esperan: si la cola
+ * está llena, el evento se descarta y se cuenta en 'dropped'.
+ */
+typedef struct struct_evlog
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned long int head;    // Próxima posición a reservar por un productor
+    unsigned long int tail;    // Próxima posición a leer por el escritor
+    unsigned long int dropped; // Eventos descartados con la cola llena
+    int consumer;              // Escritor dueño de la cola (0 si no hay)
+    int pad;
+    struct_evlog_limit limits[_EVLOG_KEYS_];
+    struct_evlog_slot slots[_EVLOG_SLOTS_];
+} struct_evlog;
+
+/* ---------- Prototipado de funciones ---------- */
+
+struct_evlog *evlog_open(char *, struct_data *, int);
+void evlog_destroy(char *);
+int spawn_evlog(struct struct_server *, char *);
+
+void evlog(int, char *, int, const char *, ...) __attribute__((format(printf, 4, 5)));
+
+int evlog_level(struct_sv_config *);
+int evlog_parse_level(char *);
+char *evlog_level_name(int);
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file handoff.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de reinicio en caliente
+ *        (traspaso de sockets de escucha entre instancias del
+ *        servidor) para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-09
+ */
+
+#ifndef __HANDOFF__
+#define __HANDOFF__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "stats.h"
+
+#include <sys/un.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _HANDOFF_MAGIC_ 0x46464F48 // "HOFF"
+#define _HANDOFF_MAX_FDS_ 40       // Máximo de descriptores traspasados (listeners + estadísticas)
+#define _HANDOFF_TIMEOUT_ 5        // Segundos de espera de la confirmación de la nueva instancia
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Estado que la instancia saliente le entrega a la entrante junto con
+ * los descriptores: los sockets de escucha (en el orden de 'protos') y,
+ * a continuación, el segmento de estadísticas, que pasa a ser compartido
+ * por ambas instancias mientras la saliente drena sus conexiones.
+ */
+typedef struct struct_handoff
+{
+    unsigned int magic;
+    int pid; // Proceso principal de la instancia saliente
+    int n_listeners;
+    int protos[_HANDOFF_MAX_FDS_];
+    int primary[_HANDOFF_MAX_FDS_]; // Listeners creados a partir de los argumentos
+    unsigned int log_interval;
+    char instance[_INSTANCE_LEN_];
+} struct_handoff;
+
+/* ---------- Prototipado de funciones ---------- */
+
+int handoff_open(char *);
+int handoff_give(int, struct_handoff *, int *);
+int handoff_take(char *, struct_handoff *, int *);
+void handoff_ack(int);
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file lz.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de compresión (de la familia
+ *        LZ77) de los datos enviados por los clientes para el TP #1 de
+ *        Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-22
+ */
+
+#ifndef __LZ__
+#define __LZ__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "utilities.h"
+
+#include <arpa/inet.h>
+#include <stdint.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _LZ_MAGIC_ "SO2Z" // Prefijo del saludo (nunca coincide con el tráfico de un cliente común)
+#define _LZ_VERSION_ 1
+#define _LZ_HELLO_LEN_ 8 // Prefijo, versión y reservado
+#define _LZ_HDR_LEN_ 4   // Largo original y largo codificado de cada bloque
+
+#define _LZ_MAX_BLOCK_ 16384 // Máximo de bytes originales por bloque
+#define _LZ_BOUND_(n) ((n) + ((n) / 255) + 16) // Peor caso del largo codificado de n bytes
+
+#define _LZ_MIN_MATCH_ 4
+#define _LZ_MAX_OFFSET_ 65535
+#define _LZ_HASH_BITS_ 12
+#define _LZ_LAST_LITERALS_ 5 // Los últimos bytes de un bloque siempre viajan como literales
+#define _LZ_MF_LIMIT_ 12     // Ninguna coincidencia comienza a menos de estos bytes del final
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Estado del lado receptor de una conexión comprimida. Los bloques pueden
+ * quedar partidos entre dos lecturas, por lo que se acumulan hasta estar
+ * completos y recién entonces se descomprimen.
+ */
+typedef struct struct_lz_stream
+{
+    int closed;
+    unsigned char hdr[_LZ_HDR_LEN_];
+    int hdr_len;   // Bytes recibidos del encabezado en curso
+    int raw_len;   // Largo original del bloque en curso
+    int block_len; // Largo codificado del bloque en curso
+    int have;      // Bytes recibidos del bloque en curso
+    unsigned char block[_LZ_MAX_BLOCK_];
+    unsigned char out[_LZ_MAX_BLOCK_];
+} struct_lz_stream;
+
+/* ---------- Prototipado de funciones ---------- */
+
+int lz_compress(const unsigned char *, int, unsigned char *, int);
+int lz_decompress(const unsigned char *, int, unsigned char *, int);
+
+void lz_encode(unsigned char *, int, int);
+int lz_hello(int);
+int lz_accept(int);
+
+void lz_init(struct_lz_stream *);
+long int lz_feed(struct_lz_stream *, char *, size_t);
+
+#endif
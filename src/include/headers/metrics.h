@@ -0,0 +1,50 @@
+/**
+ * @file metrics.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones del exportador de métricas
+ *        en formato OpenMetrics (Prometheus) para el TP #1 de Sistemas
+ *        Operativos II.
+ * @version 0.1
+ * @since 2022-04-16
+ */
+
+#ifndef __METRICS__
+#define __METRICS__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "stats.h"
+
+#include <arpa/inet.h>
+#include <poll.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _METRICS_PREFIX_ "so2tp1_"
+#define _METRICS_REQ_LEN_ 4096      // Largo máximo de un pedido HTTP
+#define _METRICS_TIMEOUT_MS_ 500    // Espera máxima por un pedido o una respuesta
+#define _METRICS_SAMPLE_MS_ 1000    // Período de muestreo de las velocidades por conexión
+#define _RATE_BUCKETS_ 8            // Límites del histograma de velocidades: 1e3 a 1e10 bytes por segundo
+
+/* ---------- Definición de estructuras --------- */
+
+// Definida en servers_setup.h
+struct struct_server;
+
+/*
+ * Histograma acumulativo de las velocidades por conexión de un protocolo,
+ * muestreadas periódicamente por el exportador (que es el único que lo usa).
+ */
+typedef struct struct_rate_hist
+{
+    long int buckets[_RATE_BUCKETS_ + 1]; // El último corresponde a +Inf
+    long int count;
+    double sum;
+} struct_rate_hist;
+
+/* ---------- Prototipado de funciones ---------- */
+
+int metrics_open(char *);
+int spawn_metrics(struct struct_server *, int);
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * @file mux.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones del protocolo de canales
+ *        lógicos multiplexados sobre una misma conexión para el TP #1
+ *        de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-19
+ */
+
+#ifndef __MUX__
+#define __MUX__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "utilities.h"
+
+#include <arpa/inet.h>
+#include <stdint.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _MUX_MAGIC_ "SO2X" // Prefijo del saludo (nunca coincide con el tráfico de un cliente común)
+#define _MUX_VERSION_ 1
+#define _MUX_HELLO_LEN_ 8 // Prefijo, versión y cantidad de canales
+#define _MUX_HDR_LEN_ 8   // Canal, tipo y largo de cada trama
+
+#define _MUX_MAX_CHANNELS_ 256 // Máximo de canales por conexión
+#define _MUX_WINDOW_ 262144    // Créditos iniciales de cada canal, en bytes
+
+#define _MUX_DATA_ 0   // Datos de un canal (cliente a servidor)
+#define _MUX_CREDIT_ 1 // Devolución de créditos de un canal (servidor a cliente)
+#define _MUX_CLOSE_ 2  // Fin de transmisión de la conexión completa
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Estado del lado receptor de una conexión multiplexada. Las tramas
+ * pueden quedar partidas entre dos lecturas, por lo que se conserva el
+ * encabezado incompleto y los bytes pendientes de la trama en curso.
+ */
+typedef struct struct_mux
+{
+    int channels;
+    int closed;
+    unsigned char hdr[_MUX_HDR_LEN_];
+    int hdr_len;        // Bytes recibidos del encabezado en curso
+    int channel;        // Canal de la trama en curso
+    long int remaining; // Bytes de datos pendientes de la trama en curso
+    long int window[_MUX_MAX_CHANNELS_];   // Créditos que el emisor aún puede usar en cada canal
+    long int consumed[_MUX_MAX_CHANNELS_]; // Bytes leídos aún no devueltos como créditos
+    long int *acc[_MUX_MAX_CHANNELS_];     // Contadores compartidos de cada canal (pueden ser NULL)
+} struct_mux;
+
+/* ---------- Prototipado de funciones ---------- */
+
+void mux_encode(unsigned char *, int, int, uint32_t);
+void mux_decode(unsigned char *, int *, int *, uint32_t *);
+int mux_send_frame(int, int, int, uint32_t);
+
+int mux_hello(int, int);
+int mux_accept(int);
+
+void mux_init(struct_mux *, int);
+long int mux_feed(struct_mux *, int, char *, size_t, int);
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ * @file payload.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con generadores de los datos que envían
+ *        los clientes para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-22
+ */
+
+#ifndef __PAYLOAD__
+#define __PAYLOAD__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "utilities.h"
+
+/* ---------- Definición de constantes ---------- */
+
+#define _PAYLOAD_CONST_ 0  // Un único caracter repetido (el comportamiento original de los clientes)
+#define _PAYLOAD_RANDOM_ 1 // Bytes aleatorios: incompresibles
+#define _PAYLOAD_TEXT_ 2   // Palabras en minúscula, con la distribución sesgada de un texto
+#define _PAYLOAD_LOG_ 3    // Líneas de log con marcas de tiempo, niveles y campos numéricos
+
+#define _PAYLOAD_POOL_ 1048576 // Bytes generados por conexión, que se envían en forma circular
+
+/* ---------- Prototipado de funciones ---------- */
+
+int payload_parse(char *);
+char *payload_name(int);
+void payload_fill(char *, size_t, int, unsigned int);
+
+#endif
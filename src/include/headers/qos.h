@@ -0,0 +1,45 @@
+/**
+ * @file qos.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de calidad de servicio
+ *        (límites de velocidad y reparto del presupuesto global entre
+ *        protocolos) para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-18
+ */
+
+#ifndef __QOS__
+#define __QOS__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "stats.h"
+
+/* ---------- Definición de constantes ---------- */
+
+#define _QOS_BURST_NS_ 20000000L    // Ráfaga admitida por las cubetas compartidas (20ms de tráfico)
+#define _QOS_REFRESH_NS_ 100000000L // Período de recálculo de la porción del presupuesto global
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Estado local de un handler: la cubeta de su conexión y la velocidad
+ * vigente de su protocolo, que se recalcula periódicamente.
+ */
+typedef struct struct_qos
+{
+    long int tokens;
+    long int last_refill;
+    long int class_rate; // Bytes por segundo del protocolo (0: sin límite)
+    long int last_refresh;
+} struct_qos;
+
+/* ---------- Prototipado de funciones ---------- */
+
+void qos_init(struct_qos *);
+void qos_refresh(struct_data *, struct_sv_config *, int, struct_qos *);
+size_t qos_read_size(struct_sv_config *, int, struct_qos *, size_t);
+long int qos_account(struct_data *, struct_sv_config *, int, struct_qos *, long int);
+long int qos_throttle(struct_data *, int, struct_conn *, long int);
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * @file report.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de los informes de envío de
+ *        los clientes para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-26
+ */
+
+#ifndef __REPORT__
+#define __REPORT__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "utilities.h"
+
+/* ---------- Definición de constantes ---------- */
+
+// Formatos de los informes
+#define _REPORT_TEXT_ 0 // Una línea legible por informe
+#define _REPORT_CSV_ 1  // Una fila por informe, luego de un encabezado
+#define _REPORT_JSON_ 2 // Un objeto JSON por línea
+
+#define _REPORT_LINE_LEN_ 512
+
+// Datos medidos, además de los que se miden siempre
+#define _REPORT_TIMED_ 1 // Envíos rechazados y tiempo bloqueado (envíos no bloqueantes)
+#define _REPORT_MSGS_ 2  // Mensajes lógicos y su espera en los lotes (modo de mensajes chicos)
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Contadores de envío de una conexión, acumulativos desde que se
+ * estableció. Los informes se calculan a partir de la diferencia entre
+ * dos lecturas, igual que los del servidor.
+ */
+typedef struct struct_cl_stats
+{
+    long int bytes;      // Bytes enviados, tal como viajan por la conexión
+    long int payload;    // Bytes de datos: sin encabezados de tramas o bloques, y sin comprimir
+    long int sends;      // Llamadas a send
+    long int partial;    // Envíos en que el kernel aceptó sólo una parte del buffer
+    long int eagain;     // Envíos rechazados con el buffer de envío lleno
+    long int blocked_ns; // Tiempo esperando lugar en el buffer de envío
+    long int msgs;       // Mensajes lógicos enviados (modo de mensajes chicos)
+    long int queue_ns;   // Suma de la espera de cada mensaje en su lote, hasta que se envió
+} struct_cl_stats;
+
+/* ---------- Prototipado de funciones ---------- */
+
+int report_parse_format(char *);
+int report_header(char *, size_t, int);
+int report_format(char *, size_t, int, char *, struct_cl_stats *, struct_cl_stats *, double, double, int);
+
+#endif
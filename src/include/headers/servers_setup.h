@@ -13,31 +13,130 @@
 /* ---------- Librerías a utilizar -------------- */
 
 #include "utilities.h"
+#include "affinity.h"
+#include "stats.h"
+#include "handoff.h"
+#include "control.h"
+#include "metrics.h"
+#include "qos.h"
+#include "admission.h"
+#include "mux.h"
+#include "lz.h"
+#include "trace.h"
+#include "evlog.h"
+#include "tcpinfo.h"
 
+#include <arpa/inet.h>
 #include <fcntl.h>
 #include <sys/types.h>
-#include <sys/shm.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 
 /* ---------- Definición de constantes ---------- */
 
 #define _SV_PARAMS_ 5 // Cantidad máxima de argumentos para el servidor
 
+#define _MAX_LISTENERS_ 32 // Máximo de sockets de escucha por instancia (entre todos los protocolos)
+
+#define _ENDPOINT_SEP_ "," // Separador de los extremos de un mismo protocolo en los argumentos
+
+#define _ACCEPT_BACKOFF_NS_ 10000000L // Espera de un listener tras agotarse los descriptores o la memoria
+
+// Modos de los handlers (ver run_listener)
+#define _HANDLER_PROCESS_ 0 // Un proceso hijo del listener por conexión
+#define _HANDLER_THREAD_ 1  // Un hilo del listener por conexión
+
+#define _THREAD_STACK_KB_ 64       // Pila por defecto de los hilos handler
+#define _THREAD_STACK_MIN_KB_ 32   // El estado de la conexión no está en la pila, pero sí las llamadas a la libc
+#define _THREAD_STACK_MAX_KB_ 8192
+#define _DRAIN_POLL_NS_ 10000000L  // Período con el que un listener detenido espera a sus hilos handler
+#define _THREAD_FDS_ 2             // Descriptores de un listener por cada hilo handler (socket y schedstat del hilo)
+#define _LISTENER_FDS_ 16          // Descriptores que un listener reserva para sí mismo en el modo de hilos
+
 /* ---------- Definición de estructuras --------- */
 
-typedef struct struct_data
+/*
+ * Socket de escucha administrado por el proceso principal, junto
+ * con el proceso que acepta sus conexiones.
+ */
+typedef struct struct_listener
 {
-    long int local;
-    long int ipv4;
-    long int ipv6;
-    long int total;
-} struct_data;
+    int proto;
+    int fd;
+    int pid;
+    int primary; // Creado a partir de los argumentos (y no agregado en tiempo de ejecución)
+    int ep;      // Entrada de la tabla de extremos de escucha (-1 si no tiene estadísticas propias)
+} struct_listener;
+
+/*
+ * Estado del proceso principal de una instancia del servidor.
+ */
+typedef struct struct_server
+{
+    char instance[_INSTANCE_LEN_];
+    struct_data *sd;
+    struct_affinity aff;
+    struct_listener ls[_MAX_LISTENERS_];
+    int n_ls;
+    int hfd; // Socket de reinicio en caliente
+    int cfd;   // Socket de control
+    int cconn; // Conexión de control en curso (-1 si no hay)
+    char *metrics;   // Destino del exportador de métricas (NULL si no hay)
+    int metrics_pid; // Proceso exportador de métricas
+    int evlog_pid;   // Proceso escritor del registro de eventos
+} struct_server;
+
+/*
+ * Argumentos de un hilo handler. La descripción del extremo remoto se
+ * copia: peer_desc devuelve una cadena estática que el listener
+ * sobrescribe en el próximo accept.
+ */
+typedef struct struct_handler_args
+{
+    int fd;
+    int proto;
+    int ep;
+    long int accept_ns;
+    struct_data *sd;
+    struct_affinity *aff;
+    char peer[_PEER_LEN_];
+} struct_handler_args;
 
 /* ---------- Prototipado de funciones ---------- */
 
-void stats_reset(struct_data *);
-void stats_sum(struct_data *);
-void startup_ipv4_sv(uint16_t, long int *);
-void startup_ipv6_sv(uint16_t, long int *);
-void startup_local_sv(char *, long int *);
+void sv_handler(int);
+int hand_over(struct_server *);
+int write_efficiency(FILE *, char *, struct_proto_stats *, struct_proto_stats *, double, double);
+int write_admission(FILE *, char *, struct_proto_stats *, struct_proto_stats *, long int);
+int write_tcp(FILE *, char *, struct_proto_stats *, struct_proto_stats *, double);
+int write_handlers(FILE *, char *, struct_proto_stats *, struct_proto_stats *, int);
+int write_endpoints(FILE *, struct_data *, struct_endpoint *, struct_proto_stats *, struct_proto_stats *, double);
+void serve_client(int, int, int, char *, long int, struct_data *, struct_affinity *);
+
+int endpoint_parse(int, char *, struct sockaddr_storage *);
+int mk_ipv4_listener(struct in_addr, uint16_t);
+int mk_ipv6_listener(struct in6_addr, uint16_t);
+int mk_local_listener(char *);
+int mk_listener(int, char *);
+int listener_matches(int, int, char *);
+void run_listener(int, int, int, struct_data *, struct_affinity *);
+int spawn_listener(struct_server *, int);
+int add_listener(struct_server *, int, char *);
+int remove_listener(struct_server *, int, char *);
+
+int handler_mode_parse(char *);
+char *handler_mode_name(int);
+int thread_stack_kb(struct_sv_config *);
+long int raise_nofile(void);
+
+char *proto_tag(int);
+char *listener_desc(int);
+char *endpoint_name(int);
+char *listener_path(int);
+char *peer_desc(struct sockaddr_storage *);
 
 #endif
\ No newline at end of file
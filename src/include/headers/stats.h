@@ -0,0 +1,251 @@
+/**
+ * @file stats.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de manejo de la memoria
+ *        compartida POSIX que contiene las estadísticas de cada
+ *        instancia del servidor para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-05
+ */
+
+#ifndef __STATS__
+#define __STATS__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "utilities.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _PROTO_LOCAL_ 0
+#define _PROTO_IPV4_ 1
+#define _PROTO_IPV6_ 2
+#define _PROTOS_ 3 // Cantidad de protocolos soportados
+
+#define _SHM_PREFIX_ "so2tp1." // Prefijo de los segmentos en /dev/shm
+#define _SHM_DIR_ "/dev/shm"
+#define _INSTANCE_LEN_ 32 // Largo máximo del nombre de instancia
+
+#define _STATS_MAGIC_ 0x32544F53 // "SOT2"
+#define _STATS_VERSION_ 13
+
+#define _MAX_CONNS_ 1024 // Máximo de conexiones con estadísticas individuales
+#define _PEER_LEN_ 64
+#define _MAX_CHANS_ 4096 // Máximo de canales lógicos con estadísticas individuales (entre todas las conexiones)
+#define _MAX_ENDPOINTS_ 64 // Máximo de extremos de escucha con estadísticas individuales (incluidos los ya quitados)
+#define _ENDPOINT_LEN_ 112 // Alcanza para la ruta de un socket local (sun_path)
+
+#define _USAGE_FLUSH_NS_ 100000000L // Período con el que los handlers publican su consumo de recursos
+#define _USAGE_CHECK_READS_ 64      // Lecturas entre consultas del reloj para decidir si publicarlo
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Contadores de un protocolo. Son acumulativos desde el arranque de la
+ * instancia: nunca se reinician, por lo que cualquier lector (el logger,
+ * el agregador) calcula velocidades a partir de la diferencia entre dos
+ * lecturas. Se actualizan con operaciones atómicas.
+ *
+ * En las conexiones comprimidas, 'bytes' cuenta los bytes recibidos tal
+ * como viajan por la red; 'comp_bytes' cuenta esos mismos bytes y
+ * 'raw_bytes' su tamaño luego de descomprimirlos, de modo que los bytes
+ * útiles del protocolo son bytes - comp_bytes + raw_bytes.
+ *
+ * Además de los bytes, cada handler suma el consumo de recursos de su
+ * proceso o hilo (getrusage y /proc/thread-self/schedstat), lo que permite
+ * comparar la eficiencia de cada protocolo y no sólo su velocidad. También
+ * suma, una vez por conexión, la memoria residente que le cuesta al
+ * servidor atenderla, para comparar los modos de los handlers.
+ *
+ * Los handlers de conexiones TCP suman además una muestra de TCP_INFO por
+ * segundo (ver tcpinfo.h): los promedios de un intervalo se obtienen
+ * dividiendo las sumas por la cantidad de muestras.
+ */
+typedef struct struct_proto_stats
+{
+    long int bytes;
+    long int reads;    // Llamadas a read
+    long int utime_ns; // Tiempo de CPU en modo usuario
+    long int stime_ns; // Tiempo de CPU en modo kernel
+    long int wait_ns;  // Tiempo en la cola de ejecución, esperando una CPU
+    long int nvcsw;    // Cambios de contexto voluntarios
+    long int nivcsw;   // Cambios de contexto involuntarios
+    long int accepts;  // Conexiones aceptadas
+    long int setup_ns; // Tiempo total desde accept hasta que cada handler está listo para leer
+    long int throttled_ns; // Tiempo que los handlers esperaron por límites de velocidad
+    long int channels;     // Canales lógicos abiertos en conexiones multiplexadas
+    long int comp_bytes;   // Bytes recibidos en conexiones comprimidas
+    long int raw_bytes;    // Bytes descomprimidos de las conexiones comprimidas
+    long int shed;         // Conexiones descartadas por el control de admisión
+    long int deferred;     // Conexiones que esperaron un lugar libre (admitidas o no)
+    long int tcp_samples;  // Muestras de TCP_INFO tomadas
+    long int rcv_rtt_us;   // Suma del RTT estimado por el receptor en cada muestra
+    long int rcv_space;    // Suma de la ventana de recepción en cada muestra, en bytes
+    long int backlogged;   // Muestras con la cola de recepción acumulando datos (handler lento)
+    long int ooo_pkts;     // Paquetes recibidos fuera de orden (pérdidas o reordenamiento en la red)
+    long int threads;      // Conexiones atendidas por hilos (el resto, por procesos)
+    long int rss_bytes;    // Suma de la memoria residente propia de cada handler (ver servers_setup.c)
+    long int rss_samples;  // Handlers que midieron su memoria residente
+} struct_proto_stats;
+
+/*
+ * Consumo de recursos acumulado de un proceso (o de un hilo), tal como lo
+ * informa el kernel. Cada handler guarda la última muestra publicada.
+ */
+typedef struct struct_usage
+{
+    long int utime_ns;
+    long int stime_ns;
+    long int wait_ns;
+    long int nvcsw;
+    long int nivcsw;
+} struct_usage;
+
+/*
+ * Configuración modificable en tiempo de ejecución (mediante el socket de
+ * control). Sólo la escribe el proceso principal: luego de cada cambio
+ * incrementa 'generation'. Los handlers comparan la generación con la de
+ * su copia local en cada lectura y sólo recargan la configuración cuando
+ * cambió, por lo que nunca toman un lock para ver los cambios.
+ */
+typedef struct struct_sv_config
+{
+    unsigned int generation;
+    unsigned int log_interval;     // Segundos entre escrituras del log
+    int paused;                    // Si es distinto de cero, no se contabilizan bytes
+    int read_size;                 // Bytes por lectura de los handlers
+    int rcvbuf;                    // SO_RCVBUF de las conexiones (0: valor del kernel)
+    long int rate_cap[_PROTOS_];   // Límite por conexión, en bytes por segundo (0: sin límite)
+    long int proto_cap[_PROTOS_];  // Límite de cada protocolo (suma de sus conexiones)
+    long int global_cap;           // Presupuesto global de la instancia, repartido según los pesos
+    int weight[_PROTOS_];          // Peso de cada protocolo en el reparto del presupuesto global
+    int trace;                     // Si es distinto de cero, los procesos registran eventos (ver trace.h)
+    int max_conns[_PROTOS_];       // Conexiones simultáneas de cada protocolo (0: sin límite)
+    int max_total;                 // Conexiones simultáneas de la instancia, es decir, handlers (0: sin límite)
+    long int min_free_mem;         // Memoria disponible del host por debajo de la cual no se admiten conexiones
+    int overload;                  // Política al superar un límite (ver admission.h)
+    int defer_ms;                  // Espera máxima de una conexión diferida (0: valor por defecto)
+    int log_level;                 // Nivel mínimo del registro de eventos (0: valor por defecto, ver evlog.h)
+    int handler_mode;              // Procesos o hilos para las conexiones nuevas (ver servers_setup.h)
+    int thread_stack;              // Pila de los hilos handler, en KB (0: valor por defecto)
+} struct_sv_config;
+
+/*
+ * Estadísticas de una conexión individual. Un handler reserva una entrada
+ * libre (pid == 0) al comenzar y la libera al terminar; el proceso principal
+ * libera las entradas de handlers que terminaron de forma abrupta. Si el
+ * handler es un hilo, 'pid' es su TID.
+ */
+typedef struct struct_conn
+{
+    int pid;
+    int proto;
+    long int bytes;
+    long int start_ns;
+    long int throttled_ns;
+    int channels;       // Canales lógicos (0 si la conexión no es multiplexada)
+    int compressed;     // Si es distinto de cero, 'bytes' son bytes comprimidos
+    long int raw_bytes; // Bytes descomprimidos (sólo en conexiones comprimidas)
+    int rcv_rtt_us;     // Última muestra de TCP_INFO (sólo en conexiones TCP)
+    int rcv_space;
+    int inq;
+    long int ooo_pkts;
+    int threaded; // Si es distinto de cero, el handler es un hilo del listener
+    int rss_kb;   // Memoria residente propia del handler (0 hasta medirla)
+    int endpoint; // Extremo de escucha que aceptó la conexión (-1 si no tiene estadísticas propias)
+    char peer[_PEER_LEN_];
+} struct_conn;
+
+/*
+ * Estadísticas de un canal lógico de una conexión multiplexada. El handler
+ * de la conexión reserva una entrada por canal, marcada con su pid.
+ */
+typedef struct struct_chan
+{
+    int pid;
+    int channel;
+    long int bytes;
+} struct_chan;
+
+/*
+ * Estadísticas de un extremo de escucha (un archivo de socket, o un puerto
+ * con su dirección). Sólo el proceso principal reserva las entradas, una
+ * por extremo, al lanzar su listener: si el extremo se quita y se vuelve a
+ * agregar (o lo hereda otra instancia), se reutiliza su entrada, por lo que
+ * los contadores son acumulativos igual que los de los protocolos. Los
+ * handlers suman sus bytes a los de su extremo junto con los del protocolo:
+ * los contadores de un protocolo son la suma de los de sus extremos.
+ */
+typedef struct struct_endpoint
+{
+    int proto;
+    int active; // Si es distinto de cero, hay un listener aceptando conexiones en el extremo
+    char name[_ENDPOINT_LEN_];
+    long int bytes;
+    long int accepts;
+    long int shed;
+} struct_endpoint;
+
+typedef struct struct_data
+{
+    unsigned int magic;
+    unsigned int version;
+    int pid; // Proceso dueño de la instancia
+    char instance[_INSTANCE_LEN_];
+    struct_proto_stats proto[_PROTOS_];
+    struct_sv_config cfg;
+    struct_conn conns[_MAX_CONNS_];
+    struct_chan chans[_MAX_CHANS_];
+    long int qos_tat[_PROTOS_]; // Estado de las cubetas compartidas de cada protocolo (ver qos.c)
+    long int admitted[_PROTOS_]; // Conexiones admitidas en curso de cada protocolo (ver admission.c)
+    struct_endpoint endpoints[_MAX_ENDPOINTS_];
+} struct_data;
+
+/* ---------- Prototipado de funciones ---------- */
+
+struct_data *stats_create(char *);
+struct_data *stats_attach(char *);
+struct_data *stats_adopt(int);
+int stats_fd(char *);
+void stats_destroy(char *);
+
+int stats_valid_instance(char *);
+int stats_alive(struct_data *);
+
+struct_conn *stats_conn_claim(struct_data *, int, char *);
+void stats_conn_release(struct_conn *);
+int stats_conn_sweep(struct_data *, int *);
+
+struct_chan *stats_chan_claim(struct_data *, int);
+void stats_chan_release(struct_data *);
+
+int stats_endpoint_claim(struct_data *, int, char *);
+void stats_endpoint_release(struct_data *, int);
+int stats_endpoint_conns(struct_data *, int);
+
+void stats_cfg_commit(struct_data *);
+
+void stats_add(long int *, long int);
+long int stats_read(long int *);
+long int stats_total(struct_data *);
+long int stats_goodput(struct_proto_stats *);
+void stats_snapshot(struct_data *, struct_proto_stats *);
+
+void stats_usage_sample(struct_usage *, int);
+void stats_usage_flush(struct_proto_stats *, struct_usage *, long int, int);
+
+char *proto_name(int);
+int proto_parse(char *);
+
+socklen_t instance_addr(char *, char *, struct sockaddr_un *);
+int instance_peer_ok(int);
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * @file tcpinfo.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de muestreo del estado de
+ *        las conexiones TCP (TCP_INFO) para el TP #1 de Sistemas
+ *        Operativos II.
+ * @version 0.1
+ * @since 2022-04-25
+ */
+
+#ifndef __TCPINFO__
+#define __TCPINFO__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "utilities.h"
+
+#include <linux/sockios.h>
+#include <linux/tcp.h>
+#include <sys/ioctl.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _TCPINFO_NS_ 1000000000L // Período de muestreo de cada conexión
+#define _TCPINFO_LIMITED_ 50     // Porcentaje del tiempo de envío a partir del cual se indica el límite dominante
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Muestra del estado de una conexión TCP. Los campos de emisión (cwnd,
+ * retransmisiones, delivery rate y tiempos limitados) sólo tienen sentido
+ * del lado que envía datos, es decir, en el cliente; los de recepción
+ * (RTT del receptor, ventana, cola de recepción y paquetes fuera de
+ * orden), en el servidor. Los tiempos y contadores son acumulativos
+ * desde el inicio de la conexión.
+ */
+typedef struct struct_tcp_sample
+{
+    long int ts_ns;
+    unsigned int rtt_us;        // RTT suavizado del emisor
+    unsigned int rcv_rtt_us;    // RTT estimado por el receptor
+    unsigned int cwnd;          // Ventana de congestión, en segmentos
+    unsigned int snd_wnd;       // Ventana anunciada por el receptor, en bytes
+    unsigned int retrans;       // Segmentos retransmitidos
+    unsigned int ooo;           // Paquetes recibidos fuera de orden
+    unsigned int rcv_space;     // Ventana de recepción ajustada por el kernel, en bytes
+    int inq;                    // Bytes en la cola de recepción, sin leer
+    int rcvbuf;                 // SO_RCVBUF (incluye el espacio de control del kernel)
+    unsigned long int delivery; // Delivery rate, en bytes por segundo
+    unsigned long int busy_us;  // Tiempo enviando datos
+    unsigned long int rwnd_us;  // Tiempo limitado por la ventana del receptor
+    unsigned long int sndbuf_us; // Tiempo limitado por el buffer de envío
+} struct_tcp_sample;
+
+/* ---------- Prototipado de funciones ---------- */
+
+int tcpinfo_sample(int, struct_tcp_sample *);
+int tcpinfo_backlogged(struct_tcp_sample *);
+int tcpinfo_describe(struct_tcp_sample *, struct_tcp_sample *, char *, size_t);
+
+#endif
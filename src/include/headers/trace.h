@@ -0,0 +1,110 @@
+/**
+ * @file trace.h
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com).
+ * @brief Header de librería con funciones de registro de eventos
+ *        (tracing) de los procesos del servidor en memoria compartida
+ *        para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-21
+ */
+
+#ifndef __TRACE__
+#define __TRACE__
+
+/* ---------- Librerías a utilizar -------------- */
+
+#include "stats.h"
+
+/* ---------- Definición de constantes ---------- */
+
+#define _TRACE_PREFIX_ "so2tp1-trace." // Prefijo de los segmentos de eventos en /dev/shm
+#define _TRACE_MAGIC_ 0x43525453       // "STRC"
+#define _TRACE_VERSION_ 1
+
+#define _TRACE_RINGS_ 128   // Procesos con registro de eventos simultáneo
+#define _TRACE_EVENTS_ 8192 // Eventos por proceso (potencia de dos)
+#define _TRACE_LABEL_LEN_ 96
+
+// Rol del proceso dueño de un registro
+#define _TRACE_MASTER_ 0
+#define _TRACE_LISTENER_ 1
+#define _TRACE_HANDLER_ 2
+
+// Tipos de evento (el significado del argumento se indica en cada caso)
+#define _TRACE_ACCEPT_ 0   // Conexión aceptada por un listener (PID del handler)
+#define _TRACE_START_ 1    // Handler listo para leer (latencia de establecimiento, en ns)
+#define _TRACE_READ_ 2     // Lectura de un handler (bytes leídos)
+#define _TRACE_EOT_ 3      // Fin de la conexión (bytes recibidos por el handler)
+#define _TRACE_THROTTLE_ 4 // Espera por límites de velocidad (ns)
+#define _TRACE_REAP_ 5     // Entradas de handlers terminados liberadas por el proceso principal
+#define _TRACE_TICK_ 6     // Escritura del log (bytes por segundo de la instancia)
+
+/*
+ * Registra un evento si el proceso tiene un registro asignado. Con el
+ * registro de eventos deshabilitado, 'ring' es NULL y el costo es el de
+ * un salto condicional siempre predicho.
+ */
+#define TRACE(ring, type, arg)                                  \
+    do                                                          \
+    {                                                           \
+        if (__builtin_expect((ring) != NULL, 0))                \
+            trace_emit((ring), (type), (long int)(arg));        \
+    } while (0)
+
+/* ---------- Definición de estructuras --------- */
+
+typedef struct struct_trace_event
+{
+    unsigned long int ts; // Ciclos del TSC (o nanosegundos del reloj monotónico, ver struct_trace)
+    int type;
+    int pad;
+    long int arg;
+} struct_trace_event;
+
+/*
+ * Registro circular de eventos de un proceso. Sólo lo escribe su dueño, por
+ * lo que no requiere locks: cada evento se escribe antes de publicar el nuevo
+ * valor de 'head'. Al terminar, el proceso libera el registro pero los eventos
+ * se conservan hasta que otro proceso lo reutilice.
+ */
+typedef struct struct_trace_ring
+{
+    int owner; // Proceso que usa el registro (0 si está libre)
+    int pid;   // Último proceso que lo usó
+    int role;
+    int proto;
+    char label[_TRACE_LABEL_LEN_];
+    unsigned long int head; // Cantidad de eventos escritos desde que se asignó
+    struct_trace_event ev[_TRACE_EVENTS_];
+} struct_trace_ring;
+
+/*
+ * Segmento de eventos de una instancia. Los instantes se toman del TSC y
+ * se convierten a tiempo con la calibración del encabezado (en otras
+ * arquitecturas, 'cycles_per_ns' es 1 y los instantes ya son nanosegundos).
+ */
+typedef struct struct_trace
+{
+    unsigned int magic;
+    unsigned int version;
+    double cycles_per_ns;
+    unsigned long int ts0; // Lectura del TSC tomada junto con 'mono0'
+    long int mono0;        // Reloj monotónico, en ns
+    unsigned int next;     // Próximo registro a asignar (se recorren en orden circular)
+    struct_trace_ring rings[_TRACE_RINGS_];
+} struct_trace;
+
+/* ---------- Prototipado de funciones ---------- */
+
+struct_trace *trace_open(char *);
+struct_trace *trace_attach(char *);
+void trace_destroy(char *);
+
+struct_trace_ring *trace_ring(int, int, char *);
+void trace_release(void);
+void trace_emit(struct_trace_ring *, int, long int);
+
+double trace_ns(struct_trace *, unsigned long int);
+char *trace_type_name(int);
+
+#endif
@@ -10,6 +10,11 @@
 #ifndef __UTILITIES__
 #define __UTILITIES__
 
+// Necesario para afinidad de CPU (cpu_set_t) y otras extensiones de glibc
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 /* ---------- Librerías a utilizar -------------- */
 
 #include <errno.h>
@@ -22,6 +27,11 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 /* ---------- Definición de constantes ---------- */
 
@@ -36,6 +46,14 @@
 
 #define _MAX_BUFF_SIZE_ 10000
 
+/* ---------- Variables globales --------------- */
+
+/*
+ * Si está definida, show_err le entrega los errores no fatales en lugar de
+ * escribirlos en stderr (el servidor los encola en su registro de eventos).
+ */
+extern void (*show_err_hook)(int, int, char *);
+
 /* ---------- Prototipado de funciones ---------- */
 
 void show_err(int, int, int, char *);
@@ -45,6 +63,10 @@ void show_help(void);
 void try_kill(int, int);
 void try_write(int, char *);
 
+long int now_ns(void);
+double cpu_cycles_per_ns(void);
+int is_eot(char *, ssize_t);
+
 char *itoa(int, char[]);
 char *mk_err_msg(int, int, int, char *);
 
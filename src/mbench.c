@@ -0,0 +1,422 @@
+/**
+ * @file mbench.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Microbenchmarks de las rutinas del camino crítico de envío y
+ *        recepción para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-20
+ */
+
+#include "include/headers/utilities.h"
+
+#include <getopt.h>
+#include <sched.h>
+
+/* ---------- Definición de constantes ---------- */
+
+#define _MB_ITERS_ 100000 // Llamadas por medición
+#define _MB_REPEAT_ 7     // Mediciones por rutina y tamaño (se informa la mediana)
+#define _MB_N_SIZES_ 5
+
+/* ---------- Definición de estructuras --------- */
+
+/*
+ * Rutina a medir: recibe un buffer de _MAX_BUFF_SIZE_ bytes y el tamaño
+ * de la operación (bytes leídos, largo del mensaje, etc.).
+ */
+typedef void (*kernel_fn)(char *, size_t);
+
+/*
+ * Par de rutinas comparadas: la versión anterior del camino crítico y
+ * la que la reemplaza.
+ */
+typedef struct struct_kernel_pair
+{
+    char *name;
+    char *legacy_desc;
+    char *current_desc;
+    kernel_fn legacy;
+    kernel_fn current;
+} struct_kernel_pair;
+
+/* ---------- Variables globales ---------------- */
+
+static volatile long int sink; // Resultados de las rutinas, para que el compilador no las descarte
+
+static char payload[_MAX_BUFF_SIZE_]; // Datos "leídos" del socket
+
+static double cycles_per_ns;
+
+/* ---------- Medición de ciclos ---------------- */
+
+/**
+ * @brief Esta función lee el contador de ciclos al comenzar una medición.
+ *
+ * @details En x86 se usa el TSC, precedido de lfence para que no se
+ *          adelante a las instrucciones previas. El TSC avanza a la
+ *          frecuencia nominal del procesador, por lo que los ciclos
+ *          informados son ciclos de referencia. En otras arquitecturas
+ *          se convierte el reloj monotónico a ciclos.
+ *
+ * @return El valor del contador.
+ */
+static inline unsigned long long cycles_start(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+
+    return __rdtsc();
+#else
+    return (unsigned long long)((double)now_ns() * cycles_per_ns);
+#endif
+}
+
+/**
+ * @brief Esta función lee el contador de ciclos al terminar una medición.
+ *
+ * @details rdtscp espera a que terminen las instrucciones previas, y el
+ *          lfence posterior evita que las siguientes se adelanten.
+ *
+ * @return El valor del contador.
+ */
+static inline unsigned long long cycles_stop(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int aux;
+
+    unsigned long long t = __rdtscp(&aux);
+
+    _mm_lfence();
+
+    return t;
+#else
+    return (unsigned long long)((double)now_ns() * cycles_per_ns);
+#endif
+}
+
+/* ---------- Rutinas medidas ------------------- */
+
+/**
+ * @brief Rutina vacía: su costo (llamada indirecta y bucle) se descuenta
+ *        de todas las demás.
+ */
+static void k_noop(char *buffer, size_t size)
+{
+    (void)buffer;
+    (void)size;
+
+    __asm__ __volatile__("" ::: "memory");
+}
+
+/**
+ * @brief Lectura del handler antes del cambio: limpieza del buffer
+ *        completo, lectura (simulada con memcpy) y strcmp contra el
+ *        mensaje de fin de transmisión.
+ */
+static void k_read_memset_strcmp(char *buffer, size_t size)
+{
+    memset(buffer, 0, _MAX_BUFF_SIZE_);
+
+    memcpy(buffer, payload, size);
+
+    __asm__ __volatile__("" ::: "memory");
+
+    sink += (strcmp(buffer, _EOT_MSG_) == 0);
+}
+
+/**
+ * @brief Lectura del handler actual: lectura (simulada con memcpy) y
+ *        comparación de los bytes leídos con is_eot.
+ */
+static void k_read_is_eot(char *buffer, size_t size)
+{
+    memcpy(buffer, payload, size);
+
+    __asm__ __volatile__("" ::: "memory");
+
+    sink += is_eot(buffer, (ssize_t)size);
+}
+
+/**
+ * @brief Envío del cliente antes del cambio: strlen del buffer en
+ *        cada llamada a send.
+ */
+static void k_send_strlen(char *buffer, size_t size)
+{
+    (void)size;
+
+    __asm__ __volatile__("" ::: "memory");
+
+    sink += (long int)strlen(buffer);
+}
+
+/**
+ * @brief Envío del cliente actual: el largo se calcula una única vez
+ *        y se reutiliza.
+ */
+static void k_send_cached(char *buffer, size_t size)
+{
+    (void)buffer;
+
+    __asm__ __volatile__("" ::: "memory");
+
+    sink += (long int)size;
+}
+
+/**
+ * @brief Copia de la versión anterior de mk_err_msg: calloc del largo
+ *        estimado y una cadena de strcat.
+ */
+static char *legacy_mk_err_msg(int pid, int source, char *msg)
+{
+    char aux[10];
+
+    snprintf(aux, sizeof(aux), "%d", pid);
+
+    char *err_msg = (char *)calloc(strlen(msg) + strlen(aux) + sizeof(NULL) + (sizeof(char) * 45), sizeof(char));
+
+    if (!err_msg)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in memory allocation");
+
+    strcpy(err_msg, "\n[PID: ");
+    strcat(err_msg, aux);
+    strcat(err_msg, "] <");
+
+    if (source == _SERVER_SRC_)
+        strcat(err_msg, "SERVER");
+    else if (source == _CLIENT_SRC_)
+        strcat(err_msg, "CLIENT");
+    else
+        strcat(err_msg, "GENERAL");
+
+    strcat(err_msg, "> [[ FATAL ERROR ]] : ");
+    strcat(err_msg, msg);
+    strcat(err_msg, ".\n\n");
+
+    return err_msg;
+}
+
+/**
+ * @brief Mensaje de error antes del cambio (el buffer contiene el
+ *        texto del error, de 'size' caracteres).
+ */
+static void k_err_strcat(char *buffer, size_t size)
+{
+    (void)size;
+
+    char *msg = legacy_mk_err_msg(12345, _SERVER_SRC_, buffer);
+
+    sink += msg[1];
+
+    free(msg);
+}
+
+/**
+ * @brief Mensaje de error actual: encabezado con snprintf y mensaje
+ *        copiado con memcpy.
+ */
+static void k_err_snprintf(char *buffer, size_t size)
+{
+    (void)size;
+
+    char *msg = mk_err_msg(12345, _SERVER_SRC_, _FATAL_ERR_, buffer);
+
+    sink += msg[1];
+
+    free(msg);
+}
+
+/* ---------- Programa principal ---------------- */
+
+/**
+ * @brief Esta función compara dos valores para qsort.
+ */
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Esta función mide una rutina.
+ *
+ * @param fn Rutina a medir.
+ * @param buffer Buffer de trabajo.
+ * @param size Tamaño de la operación.
+ * @param iters Llamadas por medición.
+ * @param repeat Cantidad de mediciones.
+ *
+ * @return La mediana de los ciclos por llamada.
+ */
+static double measure(kernel_fn fn, char *buffer, size_t size, int iters, int repeat)
+{
+    double samples[repeat];
+
+    // Calentamiento: caché, predictores de saltos y páginas del buffer
+    for (int i = 0; i < (iters / 10) + 1; i++)
+        fn(buffer, size);
+
+    for (int r = 0; r < repeat; r++)
+    {
+        unsigned long long t0 = cycles_start();
+
+        for (int i = 0; i < iters; i++)
+            fn(buffer, size);
+
+        unsigned long long t1 = cycles_stop();
+
+        samples[r] = (double)(t1 - t0) / iters;
+    }
+
+    qsort(samples, (size_t)repeat, sizeof(double), cmp_double);
+
+    return samples[repeat / 2];
+}
+
+/**
+ * @brief Esta función prepara el buffer de trabajo de una rutina.
+ *
+ * @details Las rutinas de envío y de mensajes de error reciben una
+ *          cadena de 'size' caracteres; las de lectura, los datos
+ *          "leídos" en 'payload'.
+ *
+ * @param buffer Buffer de trabajo.
+ * @param size Tamaño de la operación.
+ */
+static void fill_buffer(char *buffer, size_t size)
+{
+    memset(buffer, 'a', _MAX_BUFF_SIZE_);
+
+    buffer[(size < _MAX_BUFF_SIZE_) ? size : (_MAX_BUFF_SIZE_ - 1)] = '\0';
+}
+
+/**
+ * @brief Esta función muestra la ayuda del programa.
+ */
+static void usage(void)
+{
+    fprintf(stdout, "Usage: ./bin/mbench [-n iterations] [-r repeat] [-c]\n\n\
+Measures, in CPU cycles per call, the hot-path kernels of the server and the client against the code they replaced:\n\
+    read_check: per-read memset of the whole buffer + strcmp, against is_eot on the bytes read.\n\
+    send_len: per-send strlen of the buffer, against a length computed once.\n\
+    err_msg: mk_err_msg built with a chain of strcat, against a snprintf header plus memcpy of the message.\n\n\
+    -n iterations: calls per measurement (default %d).\n\
+    -r repeat: measurements per kernel and size; the median is shown (default %d).\n\
+    -c: CSV output.\n", _MB_ITERS_, _MB_REPEAT_);
+}
+
+/**
+ * @brief Función principal de los microbenchmarks.
+ *
+ * @param argc Cantidad de argumentos recibidos.
+ * @param argv Vector con los argumentos recibidos.
+ *
+ * @return 0 Si la ejecución fue exitosa.
+ *         1 Si la ejecución tuvo errores.
+ */
+int main(int argc, char *argv[])
+{
+    int iters = _MB_ITERS_;
+    int repeat = _MB_REPEAT_;
+    int csv = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:ch")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            iters = atoi(optarg);
+            break;
+
+        case 'r':
+            repeat = atoi(optarg);
+            break;
+
+        case 'c':
+            csv = 1;
+            break;
+
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((iters <= 0) || (repeat <= 0))
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Invalid number of iterations or repetitions. Run this program with '-h' for help");
+
+    // Se fija la CPU actual, para que todas las lecturas del contador sean de la misma CPU
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET((size_t)sched_getcpu(), &set);
+
+    if (sched_setaffinity(0, sizeof(set), &set) == -1)
+        show_err(getpid(), _GENERAL_SRC_, _NORM_ERR_, "Failed pinning the benchmark to the current CPU");
+
+    cycles_per_ns = cpu_cycles_per_ns();
+
+    memset(payload, 'a', sizeof(payload));
+
+    char *buffer = malloc(_MAX_BUFF_SIZE_);
+
+    if (!buffer)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed in memory allocation");
+
+    struct_kernel_pair kernels[] = {
+        {"read_check", "memset+strcmp", "is_eot", k_read_memset_strcmp, k_read_is_eot},
+        {"send_len", "strlen", "cached", k_send_strlen, k_send_cached},
+        {"err_msg", "strcat", "snprintf+memcpy", k_err_strcat, k_err_snprintf}};
+
+    size_t sizes[_MB_N_SIZES_] = {16, 100, 1000, 4096, _MAX_BUFF_SIZE_ - 1};
+
+    fill_buffer(buffer, 0);
+
+    double overhead = measure(k_noop, buffer, 0, iters, repeat);
+
+    if (csv)
+        fprintf(stdout, "kernel,size,legacy,current,legacy_cycles,current_cycles,speedup\n");
+    else
+        fprintf(stdout, "%.2f cycles/ns, %.1f cycles of call overhead subtracted\n\n", cycles_per_ns, overhead);
+
+    for (size_t k = 0; k < (sizeof(kernels) / sizeof(kernels[0])); k++)
+    {
+        if (!csv)
+            fprintf(stdout, "%s: %s -> %s\n%-12s %6s %16s %16s %8s\n", kernels[k].name, kernels[k].legacy_desc, kernels[k].current_desc,
+                    "kernel", "size", "legacy[cyc]", "current[cyc]", "speedup");
+
+        for (int s = 0; s < _MB_N_SIZES_; s++)
+        {
+            fill_buffer(buffer, sizes[s]);
+            double legacy = measure(kernels[k].legacy, buffer, sizes[s], iters, repeat) - overhead;
+
+            fill_buffer(buffer, sizes[s]);
+            double current = measure(kernels[k].current, buffer, sizes[s], iters, repeat) - overhead;
+
+            // Las rutinas más baratas que la llamada vacía se informan como cero
+            legacy = (legacy > 0) ? legacy : 0;
+            current = (current > 0) ? current : 0;
+
+            double speedup = (current > 0.5) ? (legacy / current) : 0;
+
+            if (csv)
+                fprintf(stdout, "%s,%zu,%s,%s,%.1f,%.1f,%.2f\n", kernels[k].name, sizes[s], kernels[k].legacy_desc,
+                        kernels[k].current_desc, legacy, current, speedup);
+            else if (speedup > 0)
+                fprintf(stdout, "%-12s %6zu %16.1f %16.1f %7.1fx\n", kernels[k].name, sizes[s], legacy, current, speedup);
+            else
+                fprintf(stdout, "%-12s %6zu %16.1f %16.1f %8s\n", kernels[k].name, sizes[s], legacy, current, "-");
+        }
+    }
+
+    free(buffer);
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+#!/bin/bash
+
+# author: Bonino, Francisco Ignacio.
+# version: 0.1
+# since: 2022-04-14
+
+# Benchmark de loopback del servidor. Por cada combinación de protocolo,
+# tamaño de buffer y cantidad de conexiones, se levanta una instancia del
+# servidor, se la carga con clientes y se miden (con './bin/agg -x') la
+# velocidad, el costo de CPU de los handlers y la latencia de establecimiento
+# de las conexiones. Los resultados se guardan en CSV y JSON y se comparan
+# contra una línea base: si alguna métrica empeora más que el umbral, el
+# script termina con error.
+#
+# Variables de entorno (opcionales):
+#   BENCH_PROTOS, BENCH_SIZES, BENCH_CONNS: matriz a recorrer.
+#   BENCH_DURATION, BENCH_WARMUP: segundos de medición y de calentamiento.
+#   BENCH_REPEAT: corridas por combinación (se informa la de velocidad mediana).
+#   BENCH_THRESHOLD: empeoramiento admitido en velocidad y CPU por byte (%).
+#   BENCH_LATENCY_THRESHOLD: empeoramiento admitido en latencia (%).
+#   BENCH_BASELINE: archivo de línea base.
+#   BENCH_UPDATE: si vale 1, los resultados reemplazan a la línea base.
+
+set -u
+
+cd "$(dirname "$0")/../../.."
+
+PROTOS=${BENCH_PROTOS:-"local ipv4 ipv6"}
+SIZES=${BENCH_SIZES:-"100 1000 9999"}
+CONNS=${BENCH_CONNS:-"1 4"}
+DURATION=${BENCH_DURATION:-2}
+WARMUP=${BENCH_WARMUP:-1}
+REPEAT=${BENCH_REPEAT:-3}
+THRESHOLD=${BENCH_THRESHOLD:-25}
+LATENCY_THRESHOLD=${BENCH_LATENCY_THRESHOLD:-200}
+BASELINE=${BENCH_BASELINE:-src/resources/bench/baseline.csv}
+UPDATE=${BENCH_UPDATE:-0}
+
+OUT_CSV=src/resources/log/bench.csv
+OUT_JSON=src/resources/log/bench.json
+
+INSTANCE=bench$$
+SOCKET=/tmp/so2tp1_bench$$.sock
+PORT4=47001
+PORT6=47002
+
+HEADER="proto,size,conns,MBps,cpu_pct,ns_per_byte,reads_per_MB,setup_us"
+
+for bin in srv cln agg ctl; do
+    if [ ! -x "bin/$bin" ]; then
+        echo "bin/$bin not found, run 'make' first" >&2
+        exit 1
+    fi
+done
+
+mkdir -p src/resources/log
+
+# Suma los contadores de un protocolo en una lectura de './bin/agg -x'
+counters() {
+    echo "$1" | awk -F, -v proto="$2" '$3 == proto { print $4, $5, $6 + $7, $11, $12 }'
+}
+
+# Lanza un cliente del protocolo indicado (con exec, para que las señales le lleguen directamente)
+client() {
+    case $1 in
+    local) exec ./bin/cln local "$SOCKET" "$2" ;;
+    ipv4) exec ./bin/cln ipv4 127.0.0.1 "$PORT4" "$2" ;;
+    ipv6) exec ./bin/cln ipv6 ::1 lo "$PORT6" "$2" ;;
+    esac
+}
+
+# Ejecuta una celda de la matriz y muestra la fila de resultados
+run_cell() {
+    local proto=$1 size=$2 conns=$3
+
+    ./bin/srv --instance "$INSTANCE" "$SOCKET" "$PORT4" "$PORT6" >/dev/null 2>&1 &
+    local srv_pid=$!
+
+    # Se espera a que la instancia atienda su socket de control (ya está aceptando)
+    for _ in $(seq 50); do
+        ./bin/ctl "$INSTANCE" config >/dev/null 2>&1 && break
+        sleep 0.1
+    done
+
+    local pids=()
+
+    for _ in $(seq "$conns"); do
+        client "$proto" "$size" >/dev/null 2>&1 &
+        pids+=($!)
+    done
+
+    sleep "$WARMUP"
+
+    local t0 s0 t1 s1
+    t0=$(date +%s%N)
+    s0=$(./bin/agg -x -I "$INSTANCE")
+
+    sleep "$DURATION"
+
+    t1=$(date +%s%N)
+    s1=$(./bin/agg -x -I "$INSTANCE")
+
+    kill -INT "${pids[@]}" 2>/dev/null
+    wait "${pids[@]}" 2>/dev/null
+
+    kill -INT "$srv_pid" 2>/dev/null
+    wait "$srv_pid" 2>/dev/null
+
+    read -r b0 r0 c0 _ _ <<<"$(counters "$s0" "$proto")"
+    read -r b1 r1 c1 a1 l1 <<<"$(counters "$s1" "$proto")"
+
+    awk -v p="$proto" -v s="$size" -v n="$conns" -v ns=$((t1 - t0)) \
+        -v b=$((b1 - b0)) -v r=$((r1 - r0)) -v c=$((c1 - c0)) -v a="$a1" -v l="$l1" 'BEGIN {
+        mb = (b > 0) ? b / 1e6 : 1e-9
+        printf "%s,%d,%d,%.1f,%.1f,%.3f,%.1f,%.1f\n", p, s, n,
+               (b / 1e6) / (ns / 1e9), (100 * c) / ns, (b > 0) ? c / b : 0, r / mb, (a > 0) ? (l / a) / 1e3 : 0
+    }'
+}
+
+echo "$HEADER" >"$OUT_CSV"
+
+for proto in $PROTOS; do
+    for size in $SIZES; do
+        for conns in $CONNS; do
+            # Las mediciones en loopback son ruidosas: se toma la corrida de velocidad mediana
+            row=$(for _ in $(seq "$REPEAT"); do run_cell "$proto" "$size" "$conns"; done |
+                sort -t, -k4 -g | sed -n "$(((REPEAT + 1) / 2))p")
+            echo "$row" >>"$OUT_CSV"
+            echo "$row"
+        done
+    done
+done
+
+# Salida JSON, a partir del CSV
+awk -F, 'NR == 1 { split($0, keys, ","); print "["; next }
+         { printf "%s  {", (NR > 2) ? ",\n" : ""
+           for (i = 1; i <= NF; i++)
+               printf "%s\"%s\": %s", (i > 1) ? ", " : "", keys[i], (i == 1) ? "\"" $i "\"" : $i
+           printf "}" }
+         END { print "\n]" }' "$OUT_CSV" >"$OUT_JSON"
+
+echo "Results saved to $OUT_CSV and $OUT_JSON"
+
+if [ "$UPDATE" = "1" ]; then
+    cp "$OUT_CSV" "$BASELINE"
+    echo "Baseline updated: $BASELINE"
+    exit 0
+fi
+
+if [ ! -f "$BASELINE" ]; then
+    echo "No baseline found at $BASELINE (run 'make bench_baseline' to create it)"
+    exit 0
+fi
+
+# Comparación contra la línea base: menos velocidad, o más CPU por byte o latencia, es un empeoramiento
+awk -F, -v t="$THRESHOLD" -v lt="$LATENCY_THRESHOLD" '
+    FNR == 1 { next }
+    NR == FNR { key = $1 "," $2 "," $3; base_mbps[key] = $4; base_nspb[key] = $6; base_setup[key] = $8; next }
+    {
+        key = $1 "," $2 "," $3
+
+        if (!(key in base_mbps))
+            next
+
+        if ($4 < base_mbps[key] * (1 - t / 100)) {
+            printf "REGRESSION %s: %.1f MB/s (baseline %.1f)\n", key, $4, base_mbps[key]; bad++
+        }
+
+        if ((base_nspb[key] > 0) && ($6 > base_nspb[key] * (1 + t / 100))) {
+            printf "REGRESSION %s: %.3f ns/B of CPU (baseline %.3f)\n", key, $6, base_nspb[key]; bad++
+        }
+
+        if ((base_setup[key] > 0) && ($8 > base_setup[key] * (1 + lt / 100))) {
+            printf "REGRESSION %s: %.1f us connection setup (baseline %.1f)\n", key, $8, base_setup[key]; bad++
+        }
+    }
+    END {
+        if (bad) {
+            printf "%d regressions beyond the threshold\n", bad
+            exit 1
+        }
+
+        print "No regressions beyond the threshold"
+    }' "$BASELINE" "$OUT_CSV"
@@ -8,6 +8,9 @@
 
 #include "include/headers/servers_setup.h"
 
+// Bandera que indica que se recibió una señal de finalización
+volatile sig_atomic_t sv_exit = 0;
+
 /**
  * @brief Función principal del servidor.
  *
@@ -21,6 +24,9 @@ int main(int argc, char *argv[])
 {
     int parent_pid = getpid();
 
+    // Salida con buffer por línea, para que los mensajes no se pierdan si stdout es un pipe o un archivo
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
     // Validación de argumentos
     if (argc == 2)
     {
@@ -40,6 +46,101 @@ int main(int argc, char *argv[])
             show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid arguments amount. Run this program with '-h', '--help' or '?' for help");
     }
 
+    // Opciones de afinidad de CPU e instancia (todas opcionales)
+    struct_affinity aff;
+
+    affinity_init(&aff);
+
+    // Por defecto, el nombre de la instancia es el PID del servidor
+    char instance[_INSTANCE_LEN_];
+
+    snprintf(instance, sizeof(instance), "%d", parent_pid);
+
+    struct option sv_options[] = {
+        {"listener-cpus", required_argument, NULL, 'L'},
+        {"handler-cpus", required_argument, NULL, 'H'},
+        {"logger-cpus", required_argument, NULL, 'G'},
+        {"auto-affinity", no_argument, NULL, 'A'},
+        {"instance", required_argument, NULL, 'n'},
+        {"takeover", required_argument, NULL, 'T'},
+        {"metrics", required_argument, NULL, 'M'},
+        {"trace", no_argument, NULL, 'R'},
+        {"event-log", required_argument, NULL, 'E'},
+        {"handler-mode", required_argument, NULL, 'D'},
+        {"thread-stack", required_argument, NULL, 'K'},
+        {0, 0, 0, 0}};
+
+    int opt;
+    int takeover = 0;
+    int trace = 0;
+    int handler_mode = -1;
+    int thread_stack = 0;
+
+    char *metrics = NULL;
+    char *event_log = NULL;
+
+    while ((opt = getopt_long(argc, argv, "", sv_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'L':
+            if (parse_cpu_list(optarg, &aff.listener_cpus) == -1)
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid listener CPU list. Run this program with '-h', '--help' or '?' for help");
+            break;
+        case 'H':
+            if (parse_cpu_list(optarg, &aff.handler_cpus) == -1)
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid handler CPU list. Run this program with '-h', '--help' or '?' for help");
+            break;
+        case 'G':
+            if (parse_cpu_list(optarg, &aff.logger_cpus) == -1)
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid logger CPU list. Run this program with '-h', '--help' or '?' for help");
+            break;
+        case 'A':
+            aff.auto_mode = 1;
+            break;
+        case 'n':
+            if (!stats_valid_instance(optarg))
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid instance name. Run this program with '-h', '--help' or '?' for help");
+
+            strcpy(instance, optarg);
+            break;
+        case 'T':
+            if (!stats_valid_instance(optarg))
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid instance name. Run this program with '-h', '--help' or '?' for help");
+
+            // La nueva instancia hereda el nombre (y el segmento de estadísticas) de la saliente
+            strcpy(instance, optarg);
+
+            takeover = 1;
+            break;
+        case 'M':
+            metrics = optarg;
+            break;
+        case 'R':
+            trace = 1;
+            break;
+        case 'E':
+            event_log = optarg;
+            break;
+        case 'D':
+            if ((handler_mode = handler_mode_parse(optarg)) == -1)
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid handler mode. Run this program with '-h', '--help' or '?' for help");
+            break;
+        case 'K':
+            thread_stack = atoi(optarg);
+
+            if ((thread_stack < _THREAD_STACK_MIN_KB_) || (thread_stack > _THREAD_STACK_MAX_KB_))
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid thread stack size. Run this program with '-h', '--help' or '?' for help");
+            break;
+        default:
+            show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid option received. Run this program with '-h', '--help' or '?' for help");
+        }
+    }
+
+    // A partir de aquí sólo quedan los argumentos posicionales
+    argc -= (optind - 1);
+    argv += (optind - 1);
+
     if ((argc != _SV_PARAMS_) && argc != (_SV_PARAMS_ - 1))
         show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid arguments amount. Run this program with '-h', '--help' or '?' for help");
 
@@ -51,58 +152,249 @@ int main(int argc, char *argv[])
     if (signal(SIGCHLD, SIG_IGN) == SIG_ERR)
         show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed trying to ignore signal SIGCHLD");
 
-    // Creación de memoria compartida para estructura de velocidades de comunicación
-    key_t key = 11111; // Key arbitraria - consultar ftok
+    /*
+     * Todos los procesos del servidor (listeners y handlers) quedan en un grupo
+     * de procesos propio, para poder terminarlos juntos sin afectar al proceso
+     * que lanzó el servidor (por ejemplo, un script).
+     */
+    if ((getpgrp() != parent_pid) && (setpgid(0, 0) == -1))
+        show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed trying to create server process group");
 
-    int smid = shmget(key, sizeof(struct_data), (IPC_CREAT | 0666));
+    /*
+     * Los handlers son hijos de los listeners. Al marcar al proceso principal
+     * como 'subreaper', si un listener termina (por ejemplo, luego de un reinicio
+     * en caliente) sus handlers pasan a ser hijos de este proceso y es posible
+     * esperar a que drenen sus conexiones.
+     */
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1) == -1)
+        show_err(parent_pid, _SERVER_SRC_, _NORM_ERR_, "Failed trying to become subreaper");
 
-    if (smid == -1)
-        show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed on shared memory creation process [creation]");
+    // Si no se especifica, el tiempo de log será el de la configuración compartida (un segundo por defecto)
+    unsigned int log_interval = 0;
 
-    struct_data *sd = (struct_data *)shmat(smid, 0, 0);
+    if ((argc == _SV_PARAMS_) && (atoi(argv[4]) > 0))
+        log_interval = (unsigned int)atoi(argv[4]);
 
-    if (sd == (void *)-1)
-        show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed on shared memory creation process [attachment]");
+    /* ----------------- SOCKETS DE ESCUCHA ----------------- */
 
-    /* ----------------- SOCKET LOCAL ----------------- */
+    struct_server sv;
 
-    int cp_local_pid = fork();
+    memset(&sv, 0, sizeof(sv));
 
-    if (cp_local_pid == -1)
-        show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed on process forking for IPv6 socket");
+    strcpy(sv.instance, instance);
 
-    if (cp_local_pid == 0) // Proceso hijo - Creación de socket local
-        startup_local_sv(argv[1], &sd->local);
+    sv.aff = aff;
+    sv.hfd = -1;
+    sv.cfd = -1;
+    sv.cconn = -1;
+    sv.metrics = metrics;
+    sv.metrics_pid = -1;
+    sv.evlog_pid = -1;
 
-    /* ----------------- SOCKET IPv4 ----------------- */
+    /*
+     * Listeners principales, creados a partir de los argumentos posicionales: cada
+     * uno admite una lista de extremos del mismo protocolo, separados por comas
+     * (por ejemplo, '2222,127.0.0.1:2223'). Los extremos de cada protocolo se
+     * atienden igual que uno solo, cada uno con su listener y sus contadores.
+     */
+    char *target[_MAX_LISTENERS_];
 
-    int cp_ipv4_pid = fork();
+    for (int p = 0; p < _PROTOS_; p++)
+    {
+        int first = sv.n_ls;
 
-    if (cp_ipv4_pid == -1)
-        show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed on process forking for IPv4 socket");
+        for (char *t = strtok(argv[p + 1], _ENDPOINT_SEP_); t; t = strtok(NULL, _ENDPOINT_SEP_))
+        {
+            struct sockaddr_storage addr;
 
-    if (cp_ipv4_pid == 0) // Proceso hijo - Creación de socket TCP/IPv4
-        startup_ipv4_sv((uint16_t)atoi(argv[2]), &sd->ipv4);
+            if (endpoint_parse(p, t, &addr) == -1)
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid listening endpoint. Run this program with '-h', '--help' or '?' for help");
 
-    /* ----------------- SOCKET IPv6 ----------------- */
+            if (sv.n_ls == _MAX_LISTENERS_)
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Too many listening endpoints");
 
-    int cp_ipv6_pid = fork();
+            target[sv.n_ls] = t;
+            sv.ls[sv.n_ls++] = (struct_listener){p, -1, -1, 1, -1};
+        }
 
-    if (cp_ipv6_pid == -1)
-        show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed on process forking for IPv6 socket");
+        if (sv.n_ls == first)
+            show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Invalid listening endpoint. Run this program with '-h', '--help' or '?' for help");
+    }
 
-    if (cp_ipv6_pid == 0) // Proceso hijo - Creación de socket TCP/IPv6
-        startup_ipv6_sv((uint16_t)atoi(argv[3]), &sd->ipv6);
+    int n_primary = sv.n_ls;
 
-    /* --------------------- LOG --------------------- */
+    int ack_fd = -1;
 
-    // El tiempo de log será de un segundo por defecto
-    unsigned int log_interval;
+    if (takeover)
+    {
+        /*
+         * Reinicio en caliente: se reciben los sockets de escucha de la instancia
+         * en ejecución. De los principales se reutilizan los que coinciden con los
+         * argumentos; los que no (por ejemplo, si se cambió un puerto) se reemplazan
+         * por nuevos. Los agregados en tiempo de ejecución se conservan tal cual.
+         * Los extremos de la instancia saliente quedan inactivos hasta que se
+         * lancen los listeners que los conservan.
+         */
+        struct_handoff st;
 
-    if ((argc == _SV_PARAMS_) && (atoi(argv[4]) > 0))
-        log_interval = (unsigned int)atoi(argv[4]);
+        int fds[_HANDOFF_MAX_FDS_];
+
+        ack_fd = handoff_take(instance, &st, fds);
+
+        sv.sd = stats_adopt(fds[st.n_listeners]);
+
+        for (int i = 0; i < _MAX_ENDPOINTS_; i++)
+            stats_endpoint_release(sv.sd, i);
+
+        for (int i = 0; i < st.n_listeners; i++)
+        {
+            int proto = st.protos[i];
+
+            int valid = (proto >= 0) && (proto < _PROTOS_);
+            int kept = 0;
+
+            if (valid && !st.primary[i] && (sv.n_ls < _MAX_LISTENERS_))
+            {
+                sv.ls[sv.n_ls++] = (struct_listener){proto, fds[i], -1, 0, -1};
+
+                kept = 1;
+            }
+
+            for (int j = 0; valid && st.primary[i] && (j < n_primary) && !kept; j++)
+            {
+                if ((sv.ls[j].proto == proto) && (sv.ls[j].fd == -1) && listener_matches(fds[i], proto, target[j]))
+                {
+                    sv.ls[j].fd = fds[i];
+
+                    kept = 1;
+                }
+            }
+
+            if (!kept)
+            {
+                // El archivo de un socket local que ya no se utiliza se quita, igual que con 'unlisten'
+                if (proto == _PROTO_LOCAL_)
+                    unlink(listener_path(fds[i]));
+
+                close(fds[i]);
+            }
+        }
+
+        fprintf(stdout, "[PID: %d] <SERVER> Taking over instance '%s' from process #%d\n", parent_pid, instance, st.pid);
+    }
     else
-        log_interval = 1;
+    {
+        // Creación de memoria compartida POSIX propia de la instancia
+        sv.sd = stats_create(instance);
+
+        fprintf(stdout, "[PID: %d] <SERVER> Instance '%s' stats available at %s/%s%s\n", parent_pid, instance, _SHM_DIR_, _SHM_PREFIX_, instance);
+    }
+
+    /*
+     * El intervalo de log forma parte de la configuración compartida: luego de un
+     * reinicio en caliente se conserva el de la instancia saliente, salvo que se
+     * especifique uno nuevo.
+     */
+    if (log_interval > 0)
+    {
+        sv.sd->cfg.log_interval = log_interval;
+
+        stats_cfg_commit(sv.sd);
+    }
+
+    // Igual que el intervalo, el modo de los handlers se conserva salvo que se especifique uno nuevo
+    if ((handler_mode != -1) || (thread_stack > 0))
+    {
+        if (handler_mode != -1)
+            sv.sd->cfg.handler_mode = handler_mode;
+
+        if (thread_stack > 0)
+            sv.sd->cfg.thread_stack = thread_stack;
+
+        stats_cfg_commit(sv.sd);
+    }
+
+    if (sv.sd->cfg.handler_mode == _HANDLER_THREAD_)
+    {
+        // Los listeners heredan el límite: cada conexión ocupa descriptores del listener que la atiende
+        fprintf(stdout, "[PID: %d] <SERVER> Clients will be handled by threads with %dKB stacks (open files limit: %ld)\n", parent_pid, thread_stack_kb(&sv.sd->cfg), raise_nofile());
+    }
+
+    // Segmento de eventos: se crea antes que los listeners para que todos los procesos lo hereden
+    if (!trace_open(instance))
+        show_err(parent_pid, _SERVER_SRC_, _NORM_ERR_, "Failed creating trace shared memory segment, tracing will not be available");
+    else if (trace)
+    {
+        sv.sd->cfg.trace = 1;
+
+        stats_cfg_commit(sv.sd);
+
+        fprintf(stdout, "[PID: %d] <SERVER> Tracing enabled, dump it with './bin/trc %s'\n", parent_pid, instance);
+    }
+
+    /*
+     * Cola del registro de eventos: desde aquí, los errores no fatales de todos
+     * los procesos se encolan y los escribe el proceso escritor (luego de un
+     * reinicio en caliente, también los de los handlers de la instancia saliente).
+     */
+    struct_evlog *evq = evlog_open(instance, sv.sd, takeover);
+
+    if (!evq)
+        show_err(parent_pid, _SERVER_SRC_, _NORM_ERR_, "Failed creating event log shared memory segment, events will be written synchronously");
+
+    for (int i = 0; i < n_primary; i++)
+        if ((sv.ls[i].fd == -1) && ((sv.ls[i].fd = mk_listener(sv.ls[i].proto, target[i])) == -1))
+            show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed creating listening sockets");
+
+    for (int i = 0; i < sv.n_ls; i++)
+        spawn_listener(&sv, i);
+
+    if (evq)
+        sv.evlog_pid = spawn_evlog(&sv, event_log);
+
+    // Los listeners ya están aceptando: la instancia saliente puede dejar de hacerlo
+    if (takeover)
+        handoff_ack(ack_fd);
+
+    if ((sv.hfd = handoff_open(instance)) == -1)
+        show_err(parent_pid, _SERVER_SRC_, _NORM_ERR_, "Failed creating hot restart socket, hot restart will not be available");
+
+    if ((sv.cfd = control_open(instance)) == -1)
+        show_err(parent_pid, _SERVER_SRC_, _NORM_ERR_, "Failed creating control socket, runtime control will not be available");
+
+    // Exportador de métricas OpenMetrics (opcional)
+    if (metrics)
+    {
+        int mfd = metrics_open(metrics);
+
+        if (mfd == -1)
+            show_err(parent_pid, _SERVER_SRC_, _NORM_ERR_, "Failed creating metrics socket, metrics will not be available");
+        else
+        {
+            fprintf(stdout, "[PID: %d] <SERVER> Metrics available at %s%s/metrics\n", parent_pid, (atoi(metrics) > 0) ? "http://127.0.0.1:" : "unix:", metrics);
+
+            sv.metrics_pid = spawn_metrics(&sv, mfd);
+        }
+    }
+
+    /* --------------------- LOG --------------------- */
+
+    // Al recibir SIGINT o SIGTERM se terminan los procesos hijos y se libera la memoria compartida
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sv_handler;
+
+    if ((sigaction(SIGINT, &sa, NULL) == -1) || (sigaction(SIGTERM, &sa, NULL) == -1))
+        show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed trying to assign handler to signals SIGINT and SIGTERM");
+
+    /*
+     * Recién ahora se fija la afinidad del logger, para que los procesos hijos
+     * no la hereden. Los listeners creados luego (por el socket de control) sí
+     * la heredan, pero cada uno aplica la suya, o restaura la del arranque.
+     */
+    if (pin_to_cpus(&aff, &aff.logger_cpus) == -1)
+        show_err(parent_pid, _SERVER_SRC_, _NORM_ERR_, "Failed trying to pin logger to CPU set");
 
     // Creación del archivo de log
     FILE *log = fopen("src/resources/log/log.txt", "w");
@@ -113,34 +405,493 @@ int main(int argc, char *argv[])
     if (fclose(log) != 0)
         show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to close log file");
 
+    struct_data *sd = sv.sd;
+
+    /*
+     * Los contadores de la memoria compartida son acumulativos: en cada
+     * intervalo se calcula la diferencia con la lectura anterior. Luego de
+     * un reinicio en caliente, la primera lectura parte del estado heredado.
+     */
+    struct_proto_stats prev[_PROTOS_];
+    struct_proto_stats curr[_PROTOS_];
+
+    long int speed[_PROTOS_];
+
+    stats_snapshot(sd, prev);
+
+    // Lo mismo con los contadores de cada extremo de escucha
+    struct_endpoint ep_prev[_MAX_ENDPOINTS_];
+
+    memcpy(ep_prev, sd->endpoints, sizeof(ep_prev));
+
+    // Frecuencia de la CPU, para expresar el tiempo de CPU de los handlers en ciclos
+    double cycles_per_ns = cpu_cycles_per_ns();
+
+    long int last_tick = now_ns();
+
+    int handed_over = 0;
+
+    char label[_TRACE_LABEL_LEN_];
+
+    snprintf(label, sizeof(label), "master %s", instance);
+
     /*
-     * El archivo de log sólo se abre luego de que pase el tiempo establecido entre lecturas,
-     * se le escribe la información sobre la velocidad de cada tipo de conexión, y antes de
-     * volver a dormir se lo cierra.
+     * Entre escrituras del log, el proceso principal atiende pedidos de reinicio en
+     * caliente y de control. El archivo de log sólo se abre luego de que pase el tiempo
+     * establecido entre lecturas, se le escribe la información sobre la velocidad de
+     * cada tipo de conexión, y antes de volver a esperar se lo cierra. El intervalo se
+     * lee en cada vuelta, ya que puede modificarse mediante el socket de control.
      */
-    while (1)
+    while (!sv_exit)
     {
-        sleep(log_interval);
+        long int next_tick = last_tick + ((long int)sd->cfg.log_interval * 1000000000L);
 
-        log = fopen("src/resources/log/log.txt", "w");
+        long int wait_ms = (next_tick - now_ns()) / 1000000;
+
+        struct pollfd pfd[2] = {
+            {.fd = sv.hfd, .events = POLLIN, .revents = 0},
+            {.fd = sv.cfd, .events = POLLIN, .revents = 0}};
+
+        // poll ignora las entradas con descriptor negativo
+        int ready = poll(pfd, 2, (wait_ms > 0) ? (int)wait_ms : 0);
+
+        // Si una señal interrumpe la espera, se vuelve a evaluar la condición del bucle
+        if (ready == -1)
+            continue;
+
+        if ((ready > 0) && (pfd[0].revents & POLLIN))
+        {
+            if (hand_over(&sv) == 0)
+            {
+                handed_over = 1;
+
+                break;
+            }
+
+            continue;
+        }
+
+        if ((ready > 0) && (pfd[1].revents & POLLIN))
+        {
+            control_handle(&sv);
+
+            continue;
+        }
+
+        long int now_tick = now_ns();
+
+        if (now_tick < next_tick)
+            continue;
+
+        struct_trace_ring *tr = sd->cfg.trace ? trace_ring(_TRACE_MASTER_, -1, label) : NULL;
+
+        // Se liberan las entradas de conexiones cuyos handlers terminaron de forma abrupta
+        int reaped;
 
-        stats_sum(sd);
+        stats_conn_sweep(sd, &reaped);
+
+        if (reaped > 0)
+            TRACE(tr, _TRACE_REAP_, reaped);
+
+        double elapsed = (double)(now_tick - last_tick) / 1e9;
+
+        last_tick = now_tick;
+
+        long int total = 0;
+        long int total_bytes = 0;
+
+        stats_snapshot(sd, curr);
+
+        for (int i = 0; i < _PROTOS_; i++)
+        {
+            speed[i] = (long int)((double)(((curr[i].bytes - prev[i].bytes) * 8) / 1000000) / elapsed);
+            total += speed[i];
+            total_bytes += curr[i].bytes - prev[i].bytes;
+        }
+
+        TRACE(tr, _TRACE_TICK_, (double)total_bytes / elapsed);
+
+        log = fopen("src/resources/log/log.txt", "w");
 
         if (!log)
             show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed trying to open log file");
 
         if (fprintf(log, "Local TCP speed: %ld[MB/s]\nTCP/IPv4 speed: %ld[MB/s]\nTCP/IPv6 speed: %ld[MB/s]\n\nTotal speed: %ld[MB/s]",
-                    (((sd->local * 8) / 1000000) / log_interval),
-                    (((sd->ipv4 * 8) / 1000000) / log_interval),
-                    (((sd->ipv6 * 8) / 1000000) / log_interval),
-                    (((sd->total * 8) / 1000000)) / log_interval) < 0)
+                    speed[_PROTO_LOCAL_],
+                    speed[_PROTO_IPV4_],
+                    speed[_PROTO_IPV6_],
+                    total) < 0)
+            show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed trying to write in log file");
+
+        // Eficiencia de los handlers de cada protocolo en el intervalo
+        if (fprintf(log, "\n\n") < 0)
+            show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed trying to write in log file");
+
+        for (int i = 0; i < _PROTOS_; i++)
+            if ((write_efficiency(log, proto_tag(i), &prev[i], &curr[i], elapsed, cycles_per_ns) < 0) ||
+                (write_admission(log, proto_tag(i), &prev[i], &curr[i], stats_read(&sd->admitted[i])) < 0) ||
+                (write_tcp(log, proto_tag(i), &prev[i], &curr[i], elapsed) < 0) ||
+                (write_handlers(log, proto_tag(i), &prev[i], &curr[i], sd->cfg.handler_mode) < 0))
+                show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed trying to write in log file");
+
+        // Velocidad de cada extremo de escucha, y su parte en la de su protocolo
+        if ((fprintf(log, "\n") < 0) || (write_endpoints(log, sd, ep_prev, prev, curr, elapsed) < 0))
             show_err(parent_pid, _SERVER_SRC_, _FATAL_ERR_, "Failed trying to write in log file");
 
+        memcpy(prev, curr, sizeof(prev));
+
         if (fclose(log) != 0)
             show_err(getpid(), _SERVER_SRC_, _FATAL_ERR_, "Failed trying to close log file");
+    }
+
+    if (handed_over)
+    {
+        /*
+         * La nueva instancia ya acepta clientes y es dueña del segmento de
+         * estadísticas y del archivo de socket. Sólo resta esperar a que los
+         * handlers de esta instancia terminen de atender a sus clientes.
+         */
+        fprintf(stdout, "[PID: %d] <SERVER> Instance '%s' handed over, draining connections\n", parent_pid, instance);
+
+        while ((wait(NULL) != -1) || (errno == EINTR))
+        {
+            if (sv_exit == 1)
+            {
+                signal(SIGTERM, SIG_IGN);
+
+                kill(0, SIGTERM);
+
+                sv_exit = 2;
+            }
+        }
+
+        fprintf(stdout, "[PID: %d] <SERVER> [[ EXITING ]] : All connections drained\n", parent_pid);
+
+        return 0;
+    }
+
+    /* ------------------- LIMPIEZA ------------------- */
+
+    // Se terminan todos los procesos del grupo del servidor (excepto éste)
+    signal(SIGTERM, SIG_IGN);
+
+    kill(0, SIGTERM);
+
+    for (int i = 0; i < sv.n_ls; i++)
+        if (sv.ls[i].proto == _PROTO_LOCAL_)
+            unlink(listener_path(sv.ls[i].fd));
+
+    if (metrics && (atoi(metrics) <= 0))
+        unlink(metrics);
+
+    stats_destroy(instance);
+
+    trace_destroy(instance);
+
+    evlog_destroy(instance);
+
+    fprintf(stdout, "[PID: %d] <SERVER> [[ EXITING ]] : Instance '%s' cleaned up\n", parent_pid, instance);
+
+    return 0;
+}
+
+/**
+ * @brief Esta función entrega los sockets de escucha y el segmento
+ *        de estadísticas a una nueva instancia (reinicio en caliente).
+ *
+ * @details Si la nueva instancia confirma el traspaso, se terminan los
+ *          listeners de esta instancia: desde ese momento sólo la nueva
+ *          acepta clientes, mientras que los handlers existentes siguen
+ *          atendiendo a los suyos. Se entregan todos los listeners,
+ *          incluidos los agregados en tiempo de ejecución.
+ *
+ * @param sv Estado del proceso principal del servidor.
+ *
+ * @return 0 Si el traspaso fue exitoso.
+ *        -1 Si el traspaso falló (la instancia sigue operando normalmente).
+ */
+int hand_over(struct_server *sv)
+{
+    struct_handoff st;
+
+    int fds[_HANDOFF_MAX_FDS_];
+
+    int n = sv->n_ls;
+
+    memset(&st, 0, sizeof(st));
+
+    st.magic = _HANDOFF_MAGIC_;
+    st.pid = getpid();
+    st.n_listeners = n;
+    st.log_interval = sv->sd->cfg.log_interval;
+
+    snprintf(st.instance, sizeof(st.instance), "%s", sv->instance);
+
+    for (int i = 0; i < n; i++)
+    {
+        st.protos[i] = sv->ls[i].proto;
+        st.primary[i] = sv->ls[i].primary;
+        fds[i] = sv->ls[i].fd;
+    }
+
+    if ((fds[n] = stats_fd(sv->instance)) == -1)
+    {
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Failed opening stats segment for hot restart");
+
+        return -1;
+    }
+
+    int result = handoff_give(sv->hfd, &st, fds);
+
+    close(fds[n]);
+
+    if (result == -1)
+    {
+        show_err(getpid(), _SERVER_SRC_, _NORM_ERR_, "Hot restart failed, this instance keeps running");
+
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        kill(sv->ls[i].pid, SIGTERM);
 
-        stats_reset(sd);
+        close(sv->ls[i].fd);
     }
 
+    // El exportador libera su puerto para el de la nueva instancia
+    if (sv->metrics_pid != -1)
+        kill(sv->metrics_pid, SIGTERM);
+
+    // El escritor vacía la cola y se la deja al de la nueva instancia
+    if (sv->evlog_pid != -1)
+        kill(sv->evlog_pid, SIGTERM);
+
+    close(sv->hfd);
+
+    if (sv->cfd != -1)
+        close(sv->cfd);
+
     return 0;
+}
+
+/**
+ * @brief Esta función escribe en el log la eficiencia de los handlers
+ *        de un protocolo durante el último intervalo.
+ *
+ * @details Se informan los ciclos de CPU (usuario y kernel) por byte
+ *          recibido, las llamadas a read por MB, el uso de CPU, los
+ *          cambios de contexto por segundo, el porcentaje del tiempo
+ *          que los handlers esperaron una CPU libre y el tiempo que
+ *          esperaron por límites de velocidad (sumado entre conexiones).
+ *          Si se recibieron datos comprimidos, se agregan los bytes
+ *          recibidos y descomprimidos, la velocidad útil (goodput) y los
+ *          ciclos de CPU por byte útil.
+ *
+ * @param log Archivo de log.
+ * @param tag Etiqueta del protocolo.
+ * @param prev Contadores del protocolo al inicio del intervalo.
+ * @param curr Contadores del protocolo al final del intervalo.
+ * @param elapsed Duración del intervalo, en segundos.
+ * @param cycles_per_ns Frecuencia de la CPU, en ciclos por nanosegundo.
+ *
+ * @return El resultado de fprintf (negativo si falló la escritura).
+ */
+int write_efficiency(FILE *log, char *tag, struct_proto_stats *prev, struct_proto_stats *curr, double elapsed, double cycles_per_ns)
+{
+    double bytes = (double)(curr->bytes - prev->bytes);
+    double cpu_ns = (double)((curr->utime_ns - prev->utime_ns) + (curr->stime_ns - prev->stime_ns));
+    double busy_ns = elapsed * 1e9;
+
+    if (bytes <= 0)
+        return fprintf(log, "%s efficiency: idle\n", tag);
+
+    int written = fprintf(log, "%s efficiency: %.3f[cycles/B] %.1f[syscalls/MB] CPU %.1f%%usr %.1f%%sys, %.0f/%.0f[csw/s vol/invol], %.1f%% runqueue wait, %.2f[s] throttled\n",
+                   tag,
+                   (cpu_ns * cycles_per_ns) / bytes,
+                   (double)(curr->reads - prev->reads) / (bytes / 1e6),
+                   (100.0 * (double)(curr->utime_ns - prev->utime_ns)) / busy_ns,
+                   (100.0 * (double)(curr->stime_ns - prev->stime_ns)) / busy_ns,
+                   (double)(curr->nvcsw - prev->nvcsw) / elapsed,
+                   (double)(curr->nivcsw - prev->nivcsw) / elapsed,
+                   (100.0 * (double)(curr->wait_ns - prev->wait_ns)) / busy_ns,
+                   (double)(curr->throttled_ns - prev->throttled_ns) / 1e9);
+
+    double comp = (double)(curr->comp_bytes - prev->comp_bytes);
+    double raw = (double)(curr->raw_bytes - prev->raw_bytes);
+
+    if ((written < 0) || (comp <= 0))
+        return written;
+
+    double goodput = bytes - comp + raw;
+
+    return fprintf(log, "%s compression: %.2f[MB] wire -> %.2f[MB] decompressed (%.2fx), goodput %.1f[MB/s], %.3f[cycles/B] of goodput\n",
+                   tag, comp / 1e6, raw / 1e6, raw / comp, (goodput / 1e6) / elapsed, (cpu_ns * cycles_per_ns) / goodput);
+}
+
+/**
+ * @brief Esta función escribe en el log las conexiones de un protocolo
+ *        que el control de admisión descartó o hizo esperar durante el
+ *        último intervalo (sólo si hubo alguna).
+ *
+ * @param log Archivo de log.
+ * @param tag Etiqueta del protocolo.
+ * @param prev Contadores del protocolo al inicio del intervalo.
+ * @param curr Contadores del protocolo al final del intervalo.
+ * @param admitted Conexiones admitidas en curso del protocolo.
+ *
+ * @return El resultado de fprintf (negativo si falló la escritura).
+ */
+int write_admission(FILE *log, char *tag, struct_proto_stats *prev, struct_proto_stats *curr, long int admitted)
+{
+    long int shed = curr->shed - prev->shed;
+    long int deferred = curr->deferred - prev->deferred;
+
+    if ((shed == 0) && (deferred == 0))
+        return 0;
+
+    return fprintf(log, "%s admission: %ld shed, %ld deferred, %ld connections admitted\n", tag, shed, deferred, admitted);
+}
+
+/**
+ * @brief Esta función escribe en el log el estado de las conexiones
+ *        TCP de un protocolo durante el último intervalo, según las
+ *        muestras de TCP_INFO de sus handlers (sólo si hubo alguna).
+ *
+ * @details Un porcentaje alto de muestras con la cola de recepción
+ *          acumulando datos indica que los handlers no leen tan rápido
+ *          como llegan los datos (un límite de CPU del receptor); un
+ *          RTT alto o paquetes fuera de orden, un límite de la red.
+ *
+ * @param log Archivo de log.
+ * @param tag Etiqueta del protocolo.
+ * @param prev Contadores del protocolo al inicio del intervalo.
+ * @param curr Contadores del protocolo al final del intervalo.
+ * @param elapsed Duración del intervalo, en segundos.
+ *
+ * @return El resultado de fprintf (negativo si falló la escritura).
+ */
+int write_tcp(FILE *log, char *tag, struct_proto_stats *prev, struct_proto_stats *curr, double elapsed)
+{
+    double samples = (double)(curr->tcp_samples - prev->tcp_samples);
+
+    if (samples <= 0)
+        return 0;
+
+    return fprintf(log, "%s tcp: rcv rtt %.3f[ms], rcv window %.0f[KB], %.0f%% of samples backlogged (handler-limited), %.1f[out-of-order pkts/s]\n",
+                   tag,
+                   ((double)(curr->rcv_rtt_us - prev->rcv_rtt_us) / samples) / 1e3,
+                   ((double)(curr->rcv_space - prev->rcv_space) / samples) / 1024,
+                   (100.0 * (double)(curr->backlogged - prev->backlogged)) / samples,
+                   (double)(curr->ooo_pkts - prev->ooo_pkts) / elapsed);
+}
+
+/**
+ * @brief Esta función escribe en el log el costo de los handlers de las
+ *        conexiones de un protocolo que comenzaron durante el último
+ *        intervalo (sólo si hubo alguna).
+ *
+ * @details Se informa cuántas conexiones atendieron hilos y cuántas
+ *          procesos, la latencia promedio de establecimiento (desde
+ *          accept hasta que el handler está listo para leer) y la
+ *          memoria residente promedio de cada handler, para comparar
+ *          ambos modos.
+ *
+ * @param log Archivo de log.
+ * @param tag Etiqueta del protocolo.
+ * @param prev Contadores del protocolo al inicio del intervalo.
+ * @param curr Contadores del protocolo al final del intervalo.
+ * @param mode Modo vigente de los handlers.
+ *
+ * @return El resultado de fprintf (negativo si falló la escritura).
+ */
+int write_handlers(FILE *log, char *tag, struct_proto_stats *prev, struct_proto_stats *curr, int mode)
+{
+    long int accepts = curr->accepts - prev->accepts;
+    long int threads = curr->threads - prev->threads;
+    long int samples = curr->rss_samples - prev->rss_samples;
+
+    if (accepts <= 0)
+        return 0;
+
+    return fprintf(log, "%s handlers (%s mode): %ld threads, %ld processes, setup %.1f[us] avg, %.1f[KB] RSS per connection\n",
+                   tag,
+                   handler_mode_name(mode),
+                   threads,
+                   accepts - threads,
+                   ((double)(curr->setup_ns - prev->setup_ns) / (double)accepts) / 1e3,
+                   (samples > 0) ? (((double)(curr->rss_bytes - prev->rss_bytes) / (double)samples) / 1024) : 0.0);
+}
+
+/**
+ * @brief Esta función escribe en el log la velocidad de cada extremo
+ *        de escucha durante el último intervalo.
+ *
+ * @details Se informan los extremos activos y los ya quitados que
+ *          recibieron bytes en el intervalo (sus handlers siguen
+ *          atendiendo clientes), junto con la parte de la velocidad de
+ *          su protocolo que le corresponde a cada uno, las conexiones en
+ *          curso y las aceptadas y descartadas en el intervalo.
+ *
+ * @param log Archivo de log.
+ * @param sd Puntero a la estructura de estadísticas.
+ * @param ep_prev Contadores de los extremos al inicio del intervalo; se actualizan.
+ * @param prev Contadores de los protocolos al inicio del intervalo.
+ * @param curr Contadores de los protocolos al final del intervalo.
+ * @param elapsed Duración del intervalo, en segundos.
+ *
+ * @return El resultado del último fprintf (negativo si falló la escritura).
+ */
+int write_endpoints(FILE *log, struct_data *sd, struct_endpoint *ep_prev, struct_proto_stats *prev, struct_proto_stats *curr, double elapsed)
+{
+    int written = 0;
+
+    for (int i = 0; (i < _MAX_ENDPOINTS_) && (written >= 0); i++)
+    {
+        struct_endpoint *ep = &sd->endpoints[i];
+
+        if (ep->name[0] == '\0')
+            continue;
+
+        long int bytes = stats_read(&ep->bytes);
+        long int accepts = stats_read(&ep->accepts);
+        long int shed = stats_read(&ep->shed);
+
+        long int delta = bytes - ep_prev[i].bytes;
+        long int proto_delta = curr[ep->proto].bytes - prev[ep->proto].bytes;
+
+        if (__atomic_load_n(&ep->active, __ATOMIC_ACQUIRE) || (delta > 0))
+            written = fprintf(log, "%s endpoint %s: %ld[MB/s] (%.1f%% of %s), %d connections, %ld accepted, %ld shed\n",
+                              proto_tag(ep->proto),
+                              ep->name,
+                              (long int)((double)((delta * 8) / 1000000) / elapsed),
+                              (proto_delta > 0) ? ((100.0 * (double)delta) / (double)proto_delta) : 0.0,
+                              proto_tag(ep->proto),
+                              stats_endpoint_conns(sd, i),
+                              accepts - ep_prev[i].accepts,
+                              shed - ep_prev[i].shed);
+
+        ep_prev[i].bytes = bytes;
+        ep_prev[i].accepts = accepts;
+        ep_prev[i].shed = shed;
+    }
+
+    return written;
+}
+
+/**
+ * @brief Handler para señales SIGINT y SIGTERM del servidor.
+ *
+ * @details Sólo se levanta una bandera: la limpieza (terminar los
+ *          procesos hijos, eliminar la memoria compartida y el
+ *          archivo de socket) la hace el bucle principal, ya que
+ *          esas operaciones no son seguras dentro de un handler.
+ *
+ * @param signal Señal recibida.
+ */
+void sv_handler(int signal)
+{
+    (void)signal;
+
+    sv_exit = 1;
 }
\ No newline at end of file
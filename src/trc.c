@@ -0,0 +1,211 @@
+/**
+ * @file trc.c
+ * @author Bonino, Francisco Ignacio (franbonino82@gmail.com)
+ * @brief Exportador de los eventos registrados por las instancias del
+ *        servidor al formato Chrome trace (chrome://tracing, Perfetto)
+ *        para el TP #1 de Sistemas Operativos II.
+ * @version 0.1
+ * @since 2022-04-21
+ */
+
+#include "include/headers/trace.h"
+
+#include <getopt.h>
+
+/* ---------- Prototipado de funciones ---------- */
+
+void usage(void);
+int dump_ring(FILE *, struct_trace *, struct_trace_ring *);
+void dump_event(FILE *, struct_trace *, struct_trace_ring *, struct_trace_event *, int);
+
+// Copia de los eventos de un registro, tomada sin detener a su dueño
+static struct_trace_event events[_TRACE_EVENTS_];
+
+// Nombre de cada rol, usado como nombre de proceso en el trace
+static char *role_names[] = {"master", "listeners", "handlers"};
+
+/**
+ * @brief Función principal del exportador de eventos.
+ *
+ * @details Los procesos del servidor se agrupan por rol: cada rol es un
+ *          proceso del trace y cada proceso del servidor, un hilo con la
+ *          descripción de su registro.
+ *
+ * @param argc Cantidad de argumentos recibidos.
+ * @param argv Vector con los argumentos recibidos.
+ *
+ * @return 0 Si se exportaron los eventos.
+ */
+int main(int argc, char *argv[])
+{
+    if ((argc == 2) && ((strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0)))
+    {
+        usage();
+
+        exit(EXIT_SUCCESS);
+    }
+
+    char *path = NULL;
+
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:")) != -1)
+    {
+        if (opt != 'o')
+            show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Invalid option received. Run this program with '-h' for help");
+
+        path = optarg;
+    }
+
+    if ((argc - optind) != 1)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Invalid arguments amount. Run this program with '-h' for help");
+
+    char *instance = argv[optind];
+
+    if (!stats_valid_instance(instance))
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Invalid instance name. Run this program with '-h' for help");
+
+    struct_trace *tr = trace_attach(instance);
+
+    if (!tr)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed opening the instance trace segment (is the instance running?)");
+
+    FILE *out = path ? fopen(path, "w") : stdout;
+
+    if (!out)
+        show_err(getpid(), _GENERAL_SRC_, _FATAL_ERR_, "Failed opening output file");
+
+    fprintf(out, "{\"traceEvents\":[\n");
+
+    // Los metadatos de los roles van primero, así cada evento siguiente se escribe precedido de una coma
+    for (int i = _TRACE_MASTER_; i <= _TRACE_HANDLER_; i++)
+        fprintf(out, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+                (i == _TRACE_MASTER_) ? "" : ",\n", i + 1, role_names[i]);
+
+    long int total = 0;
+
+    for (int i = 0; i < _TRACE_RINGS_; i++)
+        total += dump_ring(out, tr, &tr->rings[i]);
+
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+    if (path)
+    {
+        fclose(out);
+
+        fprintf(stdout, "%ld events written to %s\n", total, path);
+    }
+
+    munmap(tr, sizeof(struct_trace));
+
+    return 0;
+}
+
+/**
+ * @brief Esta función exporta los eventos de un registro.
+ *
+ * @details Los eventos se copian entre dos lecturas de 'head': los que
+ *          el dueño pudo haber sobrescrito mientras se copiaban se
+ *          descartan.
+ *
+ * @param out Archivo de salida.
+ * @param tr Segmento de eventos.
+ * @param r Registro a exportar.
+ *
+ * @return La cantidad de eventos exportados.
+ */
+int dump_ring(FILE *out, struct_trace *tr, struct_trace_ring *r)
+{
+    unsigned long int head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    int role = r->role;
+
+    if ((head == 0) || (role < _TRACE_MASTER_) || (role > _TRACE_HANDLER_))
+        return 0;
+
+    int pid = r->pid;
+
+    char label[_TRACE_LABEL_LEN_];
+
+    memcpy(label, r->label, sizeof(label));
+    label[_TRACE_LABEL_LEN_ - 1] = '\0';
+
+    unsigned long int from = (head > _TRACE_EVENTS_) ? (head - _TRACE_EVENTS_) : 0;
+
+    for (unsigned long int i = from; i < head; i++)
+        events[i & (_TRACE_EVENTS_ - 1)] = r->ev[i & (_TRACE_EVENTS_ - 1)];
+
+    unsigned long int after = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    // El registro fue reasignado a otro proceso durante la copia
+    if (after < head)
+        return 0;
+
+    /*
+     * Los eventos anteriores a los últimos _TRACE_EVENTS_ pudieron sobrescribirse
+     * durante la copia, y también el que ocupa la posición del evento 'after', que
+     * el dueño del registro puede estar escribiendo.
+     */
+    if ((after >= _TRACE_EVENTS_) && ((after + 1 - _TRACE_EVENTS_) > from))
+        from = after + 1 - _TRACE_EVENTS_;
+
+    fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", role + 1, pid, label);
+
+    int count = 0;
+
+    for (unsigned long int i = from; i < head; i++, count++)
+        dump_event(out, tr, r, &events[i & (_TRACE_EVENTS_ - 1)], role + 1);
+
+    return count;
+}
+
+/**
+ * @brief Esta función exporta un evento.
+ *
+ * @param out Archivo de salida.
+ * @param tr Segmento de eventos.
+ * @param r Registro del evento.
+ * @param ev Evento a exportar.
+ * @param pid Proceso del trace (rol del dueño del registro).
+ */
+void dump_event(FILE *out, struct_trace *tr, struct_trace_ring *r, struct_trace_event *ev, int pid)
+{
+    double ts = trace_ns(tr, ev->ts) / 1000.0;
+
+    char *name = trace_type_name(ev->type);
+
+    switch (ev->type)
+    {
+    case _TRACE_START_:
+        fprintf(out, ",\n{\"name\":\"connection\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"setup_ns\":%ld}}",
+                ts, pid, r->pid, ev->arg);
+        break;
+    case _TRACE_EOT_:
+        fprintf(out, ",\n{\"name\":\"connection\",\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"bytes\":%ld}}",
+                ts, pid, r->pid, ev->arg);
+        break;
+    case _TRACE_THROTTLE_:
+        fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                name, ts - ((double)ev->arg / 1000.0), (double)ev->arg / 1000.0, pid, r->pid);
+        break;
+    case _TRACE_TICK_:
+        fprintf(out, ",\n{\"name\":\"throughput\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%d,\"args\":{\"bytes_per_sec\":%ld}}",
+                ts, pid, ev->arg);
+        break;
+    default:
+        fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"value\":%ld}}",
+                name, ts, pid, r->pid, ev->arg);
+    }
+}
+
+/**
+ * @brief Esta función muestra el uso del exportador de eventos.
+ */
+void usage(void)
+{
+    fprintf(stdout, "Usage: trc [-o FILE] INSTANCE\n\n"
+                    "Export the events recorded by a running server instance (started with '--trace',\n"
+                    "or after './bin/ctl INSTANCE trace on') as a Chrome trace, to be opened with\n"
+                    "chrome://tracing or https://ui.perfetto.dev.\n\n"
+                    "  -o FILE  Write the trace to FILE instead of the standard output\n");
+}